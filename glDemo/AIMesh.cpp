@@ -1,125 +1,368 @@
 
 #include "AIMesh.h"
-#include "TextureLoader.h"
+#include "TextureManager.h"
+#include "SceneCache.h"
+#include "GLStateCache.h"
 
 using namespace std;
 using namespace glm;
 
 
 // Private functions
-void AIMesh::setupGLStuff(aiMesh* mesh) {
+void AIMesh::setupGLStuff(const MeshStreams& mesh) {
 
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	hasTexCoords = (mesh.texCoords != nullptr);
+
+	// The indices are already stored as a contiguous triangle list with any lower levels of detail stored after LOD 0
+	if (mesh.numLODs > 0) {
+
+		lods.assign(mesh.lods, mesh.lods + mesh.numLODs);
+	}
+	else {
+
+		MeshLOD lod0 = { 0, (mesh.numIndices / 3) * 3, 0.0f, 0 };
+		lods.push_back(lod0);
+	}
+
+	numFaces = lods[0].numIndices / 3;
+	currentLOD = 0;
+
+	if (arena && vertexFormat == VertexFormat::Packed) {
+
+		setupArenaStorage(mesh);
+	}
+	else {
+
+		arena = nullptr;
+
+		glGenVertexArrays(1, &vao);
+		GLStateCache::bindVertexArray(vao);
+
+		if (vertexFormat == VertexFormat::Packed)
+			setupPackedVertexBuffer(mesh);
+		else
+			setupSeparateVertexBuffers(mesh);
+
+		// Setup VBO for mesh index buffer (face index array)
+		glGenBuffers(1, &meshFaceIndexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshFaceIndexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.numIndices * sizeof(GLuint), mesh.indices, GL_STATIC_DRAW);
+
+		GLStateCache::bindVertexArray(0);
+	}
+
+	// Bounding box, and a bounding sphere around the centre of the box
+	if (mesh.numVertices > 0) {
+
+		vec3 minP = vec3(mesh.positions[0].x, mesh.positions[0].y, mesh.positions[0].z);
+		vec3 maxP = minP;
+
+		for (GLuint i = 1; i < mesh.numVertices; ++i) {
+
+			vec3 p = vec3(mesh.positions[i].x, mesh.positions[i].y, mesh.positions[i].z);
+			minP = glm::min(minP, p);
+			maxP = glm::max(maxP, p);
+		}
+
+		boundingBoxMin = minP;
+		boundingBoxMax = maxP;
+
+		boundingSphereCentre = (minP + maxP) * 0.5f;
+		boundingSphereRadius = 0.0f;
+
+		for (GLuint i = 0; i < mesh.numVertices; ++i) {
+
+			vec3 p = vec3(mesh.positions[i].x, mesh.positions[i].y, mesh.positions[i].z);
+			boundingSphereRadius = glm::max(boundingSphereRadius, length(p - boundingSphereCentre));
+		}
+	}
+}
+
+
+void AIMesh::setupSeparateVertexBuffers(const MeshStreams& mesh) {
 
 	// Setup VBO for vertex position data
 	glGenBuffers(1, &meshVertexPosBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, meshVertexPosBuffer);
-	glBufferData(GL_ARRAY_BUFFER, mesh->mNumVertices * sizeof(aiVector3D), mesh->mVertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, mesh.numVertices * sizeof(aiVector3D), mesh.positions, GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
 	glEnableVertexAttribArray(0);
 
 	// Setup VBO for vertex normal data
 	glGenBuffers(1, &meshNormalBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, meshNormalBuffer);
-	glBufferData(GL_ARRAY_BUFFER, mesh->mNumVertices * sizeof(aiVector3D), mesh->mNormals, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, mesh.numVertices * sizeof(aiVector3D), mesh.normals, GL_STATIC_DRAW);
 	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
 	glEnableVertexAttribArray(3);
 
-	// *** normal mapping *** Setup VBO for tangent and bi-tangent data
+	// *** normal mapping *** Setup VBO for tangent data.  Like the packed format the tangent's w holds the handedness of the (normal, tangent, bitangent) basis and the vertex shader reconstructs the bitangent from it, so there is no bitangent stream
+	vector<vec4> tangents(mesh.numVertices);
+
+	for (GLuint i = 0; i < mesh.numVertices; ++i) {
+
+		vec3 n = vec3(mesh.normals[i].x, mesh.normals[i].y, mesh.normals[i].z);
+		vec3 t = vec3(mesh.tangents[i].x, mesh.tangents[i].y, mesh.tangents[i].z);
+		vec3 b = vec3(mesh.bitangents[i].x, mesh.bitangents[i].y, mesh.bitangents[i].z);
+
+		tangents[i] = vec4(t, (dot(cross(n, t), b) < 0.0f) ? -1.0f : 1.0f);
+	}
+
 	glGenBuffers(1, &meshTangentBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, meshTangentBuffer);
-	glBufferData(GL_ARRAY_BUFFER, mesh->mNumVertices * sizeof(aiVector3D), mesh->mTangents, GL_STATIC_DRAW);
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
+	glBufferData(GL_ARRAY_BUFFER, tangents.size() * sizeof(vec4), tangents.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
 	glEnableVertexAttribArray(4);
 
-	glGenBuffers(1, &meshBiTangentBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, meshBiTangentBuffer);
-	glBufferData(GL_ARRAY_BUFFER, mesh->mNumVertices * sizeof(aiVector3D), mesh->mBitangents, GL_STATIC_DRAW);
-	glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
-	glEnableVertexAttribArray(5);
-
-	if (mesh->mTextureCoords && mesh->mTextureCoords[0]) {
+	if (mesh.texCoords) {
 
-		// Setup VBO for texture coordinate data (for now use uvw channel 0 only when accessing mesh->mTextureCoords)
+		// Setup VBO for texture coordinate data (uvw channel 0 only)
 		glGenBuffers(1, &meshTexCoordBuffer);
 		glBindBuffer(GL_ARRAY_BUFFER, meshTexCoordBuffer);
-		glBufferData(GL_ARRAY_BUFFER, mesh->mNumVertices * sizeof(aiVector3D), mesh->mTextureCoords[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, mesh.numVertices * sizeof(aiVector3D), mesh.texCoords, GL_STATIC_DRAW);
 		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
 		glEnableVertexAttribArray(2);
 	}
+}
+
 
-	// Setup VBO for mesh index buffer (face index array)
+void AIMesh::setupPackedVertexBuffer(const MeshStreams& mesh) {
 
-	numFaces = mesh->mNumFaces;
+	vector<PackedVertex> vertices = packVertices(mesh);
 
-	// Setup contiguous array
-	const GLuint numBytes = numFaces * 3 * sizeof(GLuint);
-	GLuint* faceIndexArray = (GLuint*)malloc(numBytes);
+	glGenBuffers(1, &meshVertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, meshVertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(PackedVertex), vertices.data(), GL_STATIC_DRAW);
 
-	GLuint* dstPtr = faceIndexArray;
-	for (unsigned int f = 0; f < numFaces; ++f, dstPtr += 3) {
+	const GLsizei stride = sizeof(PackedVertex);
 
-		memcpy_s(dstPtr, 3 * sizeof(GLuint), mesh->mFaces[f].mIndices, 3 * sizeof(GLuint));
+	// Position
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(PackedVertex, position));
+	glEnableVertexAttribArray(0);
+
+	// Normal and tangent (w = bitangent sign) as normalised 10:10:10:2
+	glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const GLvoid*)offsetof(PackedVertex, normal));
+	glEnableVertexAttribArray(3);
+
+	glVertexAttribPointer(4, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const GLvoid*)offsetof(PackedVertex, tangent));
+	glEnableVertexAttribArray(4);
+
+	// Half-float uv
+	if (mesh.texCoords) {
+
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(PackedVertex, texCoord));
+		glEnableVertexAttribArray(2);
 	}
 
-	glGenBuffers(1, &meshFaceIndexBuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshFaceIndexBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numBytes, faceIndexArray, GL_STATIC_DRAW);
+	// No bitangent stream - the vertex shader reconstructs it from the normal and the tangent's w sign
+}
+
+
+void AIMesh::setupArenaStorage(const MeshStreams& mesh) {
 
-	glBindVertexArray(0);
+	vector<PackedVertex> vertices = packVertices(mesh);
+
+	arenaAllocation = arena->allocate(mesh.numVertices, mesh.numIndices);
+	arena->upload(arenaAllocation, vertices.data(), mesh.indices);
 }
 
 
 
 // Public functions
 
-AIMesh::AIMesh(std::string filename, GLuint meshIndex) {
+// Load a single sub-mesh from a model file.  The file is shared through the scene cache so it is only loaded once while other meshes are using it, and assimp is only used if the file's mesh cache is missing or out of date.  To load several sub-meshes of the same file use loadFile, which only acquires the file once
+AIMesh::AIMesh(std::string filename, GLuint meshIndex, VertexFormat format, GeometryArena* arena) {
+
+	vertexFormat = format;
+	this->arena = arena;
 
-	const struct aiScene* scene = aiImportFile(filename.c_str(),
-		aiProcess_GenSmoothNormals |
-		aiProcess_CalcTangentSpace |
-		aiProcess_Triangulate |
-		aiProcess_JoinIdenticalVertices |
-		aiProcess_SortByPType);
+	MeshCache* cache = SceneCache::acquire(filename);
 
-	if (scene != nullptr) {
+	if (cache) {
 
-		setupGLStuff(scene->mMeshes[meshIndex]);
+		if (meshIndex < cache->numMeshes())
+			setupGLStuff(cache->mesh(meshIndex));
 
-		// Once done, release all resources associated with this import
-		aiReleaseImport(scene);
+		// Once uploaded we no longer need the cached mesh data
+		SceneCache::release(cache);
 	}
 }
 
 
-AIMesh::AIMesh(const struct aiScene* scene, GLuint meshIndex) {
+vector<AIMesh*> AIMesh::loadFile(const std::string& filename, VertexFormat format, GeometryArena* arena) {
 
-	setupGLStuff(scene->mMeshes[meshIndex]);	
+	vector<AIMesh*> meshes;
+
+	MeshCache* cache = SceneCache::acquire(filename);
+
+	if (cache) {
+
+		for (GLuint i = 0; i < cache->numMeshes(); ++i)
+			meshes.push_back(new AIMesh(cache->mesh(i), format, arena));
+
+		// Once every sub-mesh is uploaded we no longer need the cached mesh data
+		SceneCache::release(cache);
+	}
+
+	return meshes;
+}
+
+
+AIMesh::AIMesh(const struct aiScene* scene, GLuint meshIndex, VertexFormat format, GeometryArena* arena) {
+
+	vertexFormat = format;
+	this->arena = arena;
+
+	MeshData data = extractMeshData(scene->mMeshes[meshIndex]);
+
+	setupGLStuff(data.streams());
+}
+
+
+AIMesh::AIMesh(const MeshStreams& mesh, VertexFormat format, GeometryArena* arena) {
+
+	vertexFormat = format;
+	this->arena = arena;
+
+	setupGLStuff(mesh);
+}
+
+
+AIMesh::~AIMesh() {
+
+	TextureManager::release(textureID);
+	TextureManager::release(normalMapID);
+
+	if (arena) {
+
+		arena->free(arenaAllocation);
+	}
+	else {
+
+		GLuint buffers[] = { meshVertexBuffer, meshVertexPosBuffer, meshTexCoordBuffer, meshNormalBuffer, meshTangentBuffer, meshFaceIndexBuffer };
+
+		// Zero names are silently ignored
+		glDeleteBuffers(6, buffers);
+		glDeleteVertexArrays(1, &vao);
+		GLStateCache::vertexArrayDeleted(vao);
+	}
 }
 
 
 // Texture setup methods
 
+// Textures are shared through the texture manager - the mesh holds a reference to each texture it uses
 void AIMesh::addTexture(GLuint textureID) {
 
+	TextureManager::addRef(textureID);
+	TextureManager::release(this->textureID);
+
 	this->textureID = textureID;
 }
 
 void AIMesh::addTexture(std::string filename, FREE_IMAGE_FORMAT format) {
 
-	textureID = loadTexture(filename, format);
+	TextureManager::release(textureID);
+
+	textureID = TextureManager::acquire(filename, format);
 }
 
 // ***normal mapping*** - helper functions at add normal map image to the object
 void AIMesh::addNormalMap(GLuint normalMapID) {
 
+	TextureManager::addRef(normalMapID);
+	TextureManager::release(this->normalMapID);
+
 	this->normalMapID = normalMapID;
 }
 
 void AIMesh::addNormalMap(std::string filename, FREE_IMAGE_FORMAT format) {
 
-	normalMapID = loadTexture(filename, format);
+	TextureManager::release(normalMapID);
+
+	normalMapID = TextureManager::acquire(filename, format, TexturePlaceholder_FlatNormal);
+}
+
+
+// Level of detail selection
+
+void AIMesh::selectLOD(const glm::mat4& modelViewMatrix, float projectionScale, float errorThreshold) {
+
+	currentLOD = 0;
+
+	if (lods.size() < 2)
+		return;
+
+	// Object to world scale (largest axis scale of the model transform)
+	float scale = glm::max(length(vec3(modelViewMatrix[0])), glm::max(length(vec3(modelViewMatrix[1])), length(vec3(modelViewMatrix[2]))));
+
+	// Distance from the camera to the nearest point on the bounding sphere
+	vec3 viewCentre = vec3(modelViewMatrix * vec4(boundingSphereCentre, 1.0f));
+	float distance = length(viewCentre) - boundingSphereRadius * scale;
+
+	if (distance <= 0.0f)
+		return;
+
+	// Pick the coarsest level whose object-space error projects to less than errorThreshold pixels
+	for (GLuint i = (GLuint)lods.size() - 1; i > 0; --i) {
+
+		float screenError = lods[i].error * scale / distance * projectionScale;
+
+		if (screenError <= errorThreshold) {
+
+			currentLOD = i;
+			break;
+		}
+	}
+}
+
+void AIMesh::setLOD(GLuint lod) {
+
+	currentLOD = lods.empty() ? 0 : glm::min(lod, (GLuint)lods.size() - 1);
+}
+
+GLuint AIMesh::numLODs() {
+
+	return (GLuint)lods.size();
+}
+
+GLuint AIMesh::getCurrentLOD() {
+
+	return currentLOD;
+}
+
+vec3 AIMesh::getBoundingSphereCentre() {
+
+	return boundingSphereCentre;
+}
+
+float AIMesh::getBoundingSphereRadius() {
+
+	return boundingSphereRadius;
+}
+
+vec3 AIMesh::getBoundingBoxMin() {
+
+	return boundingBoxMin;
+}
+
+vec3 AIMesh::getBoundingBoxMax() {
+
+	return boundingBoxMax;
+}
+
+GLuint AIMesh::getTextureID() {
+
+	return (hasTexCoords) ? textureID : 0;
+}
+
+GLuint AIMesh::getNormalMapID() {
+
+	return (hasTexCoords && textureID != 0) ? normalMapID : 0;
+}
+
+GLuint AIMesh::getVAO() {
+
+	return (arena) ? arena->getVAO() : vao;
 }
 
 
@@ -127,22 +370,15 @@ void AIMesh::addNormalMap(std::string filename, FREE_IMAGE_FORMAT format) {
 
 void AIMesh::setupTextures() {
 
-	if (meshTexCoordBuffer != 0) {
+	if (hasTexCoords) {
 
 		if (textureID != 0) {
 			
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, textureID);
+			GLStateCache::bindTexture(0, textureID);
 
 			//  *** normal mapping ***  check if normal map added - if so bind to texture unit 1 (as noted in  slides)
-			if (normalMapID != 0) {
-
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, normalMapID);
-
-				// Restore default
-				glActiveTexture(GL_TEXTURE0);
-			}
+			if (normalMapID != 0)
+				GLStateCache::bindTexture(1, normalMapID);
 		}
 	}
 }
@@ -150,7 +386,76 @@ void AIMesh::setupTextures() {
 
 void AIMesh::render() {
 
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, numFaces * 3, GL_UNSIGNED_INT, (const GLvoid*)0);
+	if (lods.empty())
+		return;
+
+	const MeshLOD& lod = lods[currentLOD];
+
+	if (arena) {
+
+		// The arena's VAO is already bound - draw the mesh's range of the shared buffers
+		arena->draw(arenaAllocation, lod.firstIndex, lod.numIndices);
+		return;
+	}
+
+	GLStateCache::bindVertexArray(vao);
+	glDrawElements(GL_TRIANGLES, lod.numIndices, GL_UNSIGNED_INT, (const GLvoid*)(lod.firstIndex * sizeof(GLuint)));
 }
 
+
+void AIMesh::renderInstanced(GLuint numInstances, GLuint baseInstance) {
+
+	if (lods.empty() || numInstances == 0)
+		return;
+
+	const MeshLOD& lod = lods[currentLOD];
+
+	if (arena) {
+
+		arena->drawInstanced(arenaAllocation, lod.firstIndex, lod.numIndices, numInstances, baseInstance);
+		return;
+	}
+
+	GLStateCache::bindVertexArray(vao);
+	glDrawElementsInstancedBaseInstance(GL_TRIANGLES, lod.numIndices, GL_UNSIGNED_INT, (const GLvoid*)(lod.firstIndex * sizeof(GLuint)), numInstances, baseInstance);
+}
+
+
+void AIMesh::getDrawRange(GLuint& firstIndex, GLuint& numIndices, GLint& baseVertex) {
+
+	firstIndex = 0;
+	numIndices = 0;
+	baseVertex = 0;
+
+	if (lods.empty())
+		return;
+
+	const MeshLOD& lod = lods[currentLOD];
+
+	firstIndex = lod.firstIndex;
+	numIndices = lod.numIndices;
+
+	// Arena meshes are ranges of the shared buffers
+	if (arena) {
+
+		firstIndex += arenaAllocation.firstIndex;
+		baseVertex = arenaAllocation.baseVertex;
+	}
+}
+
+
+bool AIMesh::getIndirectCommand(GLuint numInstances, GLuint baseInstance, DrawElementsIndirectCommand& command) {
+
+	if (!arena || lods.empty())
+		return false;
+
+	const MeshLOD& lod = lods[currentLOD];
+
+	command.count = lod.numIndices;
+	command.instanceCount = numInstances;
+	command.firstIndex = arenaAllocation.firstIndex + lod.firstIndex;
+	command.baseVertex = arenaAllocation.baseVertex;
+	command.baseInstance = baseInstance;
+
+	return true;
+}
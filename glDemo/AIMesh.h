@@ -1,19 +1,44 @@
 #pragma once
 
 #include "core.h"
+#include "MeshData.h"
+#include "GeometryArena.h"
+#include "IndirectDrawBuffer.h"
 
 class AIMesh {
 
 	GLuint				numFaces = 0;
 
+	// Levels of detail - ranges of the index buffer.  lods[0] is the full resolution mesh
+	std::vector<MeshLOD> lods;
+	GLuint				currentLOD = 0;
+
+	// Object-space bounding sphere used for LOD selection
+	glm::vec3			boundingSphereCentre = glm::vec3(0.0f);
+	float				boundingSphereRadius = 0.0f;
+
+	// Object-space bounding box used for frustum culling
+	glm::vec3			boundingBoxMin = glm::vec3(0.0f);
+	glm::vec3			boundingBoxMax = glm::vec3(0.0f);
+
+	// Packed meshes can be sub-allocated from a shared arena instead of owning their own VAO and buffers
+	GeometryArena*		arena = nullptr;
+	GeometryAllocation	arenaAllocation;
+
 	GLuint				vao = 0;
 
+	VertexFormat		vertexFormat = VertexFormat::Separate;
+	bool				hasTexCoords = false;
+
+	// VertexFormat::Packed - single interleaved vertex buffer
+	GLuint				meshVertexBuffer = 0;
+
+	// VertexFormat::Separate - one buffer per vertex attribute
 	GLuint				meshVertexPosBuffer = 0;
 	GLuint				meshTexCoordBuffer = 0;
 	
 	GLuint				meshNormalBuffer = 0; // surface basis z
-	GLuint				meshTangentBuffer = 0; // surface basis x (u aligned)
-	GLuint				meshBiTangentBuffer = 0; // surface basis y (v aligned)
+	GLuint				meshTangentBuffer = 0; // surface basis x (u aligned), w = handedness of the basis (the bitangent is reconstructed in the vertex shader)
 
 	GLuint				meshFaceIndexBuffer = 0;
 
@@ -21,12 +46,26 @@ class AIMesh {
 	GLuint				normalMapID = 0;
 
 	// Private functions
-	void setupGLStuff(aiMesh* mesh);
+	void setupGLStuff(const MeshStreams& mesh);
+	void setupSeparateVertexBuffers(const MeshStreams& mesh);
+	void setupPackedVertexBuffer(const MeshStreams& mesh);
+	void setupArenaStorage(const MeshStreams& mesh);
 
 public:
 
-	AIMesh(std::string filename, GLuint meshIndex = 0);
-	AIMesh(const struct aiScene* scene, GLuint meshIndex = 0);
+	// If arena is not null (and format is VertexFormat::Packed) the mesh is stored in the arena and the arena must be bound before calling render
+	AIMesh(std::string filename, GLuint meshIndex = 0, VertexFormat format = VertexFormat::Packed, GeometryArena* arena = nullptr);
+	AIMesh(const struct aiScene* scene, GLuint meshIndex = 0, VertexFormat format = VertexFormat::Packed, GeometryArena* arena = nullptr);
+	AIMesh(const MeshStreams& mesh, VertexFormat format = VertexFormat::Packed, GeometryArena* arena = nullptr);
+
+	// Load every sub-mesh of a model file.  The file is acquired from the scene cache once and released after the last sub-mesh has been uploaded - prefer this to constructing each sub-mesh from the filename
+	static std::vector<AIMesh*> loadFile(const std::string& filename, VertexFormat format = VertexFormat::Packed, GeometryArena* arena = nullptr);
+
+	~AIMesh();
+
+	// The destructor frees the mesh's buffers (or arena allocation) and texture references, so meshes can't be copied
+	AIMesh(const AIMesh&) = delete;
+	AIMesh& operator=(const AIMesh&) = delete;
 
 	void addTexture(GLuint textureID);
 	void addTexture(std::string filename, FREE_IMAGE_FORMAT format);
@@ -34,6 +73,37 @@ public:
 	void addNormalMap(GLuint normalMapID);
 	void addNormalMap(std::string filename, FREE_IMAGE_FORMAT format);
 
+	// Select the coarsest level of detail whose projected error is below errorThreshold pixels.  projectionScale is the viewport height / (2 * tan(fovY / 2))
+	void selectLOD(const glm::mat4& modelViewMatrix, float projectionScale, float errorThreshold);
+
+	// Use a level of detail selected earlier (clamped to the levels available)
+	void setLOD(GLuint lod);
+
+	GLuint numLODs();
+	GLuint getCurrentLOD();
+
+	glm::vec3 getBoundingSphereCentre();
+	float getBoundingSphereRadius();
+
+	glm::vec3 getBoundingBoxMin();
+	glm::vec3 getBoundingBoxMax();
+
+	// The textures setupTextures binds to units 0 and 1 (0 = not bound)
+	GLuint getTextureID();
+	GLuint getNormalMapID();
+
+	// VAO bound when the mesh is drawn (the arena's VAO for arena meshes)
+	GLuint getVAO();
+
 	void setupTextures();
 	void render();
+
+	// Draw numInstances instances of the current LOD with instanced attributes starting at baseInstance (see InstanceBuffer)
+	void renderInstanced(GLuint numInstances, GLuint baseInstance);
+
+	// The index range (and base vertex) of the current LOD in the buffers of the mesh's VAO.  Draws queued for later keep this range so they aren't affected by selecting another LOD for a different placement of the mesh
+	void getDrawRange(GLuint& firstIndex, GLuint& numIndices, GLint& baseVertex);
+
+	// Fill in a multi-draw indirect command that draws the current LOD like renderInstanced.  Returns false if the mesh is not stored in a geometry arena (so can't be drawn with other meshes' commands)
+	bool getIndirectCommand(GLuint numInstances, GLuint baseInstance, DrawElementsIndirectCommand& command);
 };
\ No newline at end of file
@@ -8,7 +8,7 @@ using namespace glm;
 // Private API
 //
 
-// update position, orientation and view matrices when camera rotation and radius is modified
+// update position, orientation, view and projection matrices and the frustum planes when camera rotation and radius is modified
 void ArcballCamera::calculateDerivedValues() {
 
 	const float theta_ = glm::radians<float>(theta);
@@ -23,6 +23,9 @@ void ArcballCamera::calculateDerivedValues() {
 	// calculate view and projection transform matrices
 	viewMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -radius)) * glm::eulerAngleX(-theta_) * glm::eulerAngleY(-phi_);
 	projectionMatrix = glm::perspective(glm::radians<float>(fovY), aspect, nearPlane, farPlane);
+
+	// frustum planes only change with the matrices so are cached with them
+	frustum = Frustum(projectionMatrix * viewMatrix);
 }
 
 
@@ -44,11 +47,8 @@ ArcballCamera::ArcballCamera() {
 	nearPlane = 0.1f;
 	farPlane = 500.0f;
 
-	//F = ViewFrustum(55.0f, 1.0f, 0.1f, 500.0f);
-
-	// calculate derived values
+	// calculate derived values (including the frustum planes)
 	calculateDerivedValues();
-	//F.calculateWorldCoordPlanes(C, R);
 }
 
 
@@ -64,11 +64,8 @@ ArcballCamera::ArcballCamera(float theta, float phi, float radius, float fovY, f
 	this->nearPlane = nearPlane;
 	this->farPlane = farPlane;
 
-	//F = ViewFrustum(init_fovy, init_aspect, init_nearPlane, init_farPlane);
-
-	// calculate derived values
+	// calculate derived values (including the frustum planes)
 	calculateDerivedValues();
-	//F.calculateWorldCoordPlanes(C, R);
 }
 
 
@@ -184,4 +181,10 @@ glm::mat4 ArcballCamera::projectionTransform() {
 	return projectionMatrix;
 }
 
+// return a const reference to the world coordinate space frustum planes for the camera
+const Frustum& ArcballCamera::viewFrustum() {
+
+	return frustum;
+}
+
 #pragma endregion
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core.h"
+#include "Frustum.h"
 
 // Model an arcball / pivot camera looking at the origin (0, 0, 0).  The camera by default looks down the negative z axis (using a right-handed coordinate system).  Therefore 'forwards' is along the -z axis.  The camera is actually right/left handed agnostic.  The encapsulated frustum however needs to know the differences for the projection matrix and frustum plane calculations
 
@@ -28,6 +29,9 @@ private:
 	// projection transform matrix
 	glm::mat4			projectionMatrix;
 
+	// planes of the view frustum in world coordinate space (extracted from projectionMatrix * viewMatrix)
+	Frustum				frustum;
+
 
 	//
 	// Private API
@@ -93,4 +97,6 @@ public:
 
 	glm::mat4 projectionTransform(); // return a const reference the projection transform for the camera.  This is a pass-through method and calls projectionMatrix on the encapsulated ViewFrustum
 
+	const Frustum& viewFrustum(); // return a const reference to the world coordinate space frustum planes for the camera's current view and projection
+
 };
@@ -0,0 +1,74 @@
+#version 410
+
+// Deferred directional lights - every directional light in the LightBlock uniform buffer
+// is applied to the G-buffer in one full screen pass
+
+#define MAX_DIRECTIONAL_LIGHTS 16
+#define MAX_POINT_LIGHTS 64
+
+// G-buffer (see DeferredRenderer.h)
+uniform sampler2D albedoTexture; // tex unit 0
+uniform sampler2D normalTexture; // tex unit 1
+uniform sampler2D depthTexture; // tex unit 2
+
+struct DirectionalLightData {
+
+	vec4 direction; // towards the light
+	vec4 colour;
+};
+
+struct PointLightData {
+
+	vec4 position;
+	vec4 colour;
+	vec4 attenuation; // x=constant, y=linear, z=quadratic
+};
+
+// Must match the layout in LightBuffer.h (the point lights here are unused)
+layout (std140) uniform LightBlock {
+
+	ivec4 numLights; // x = directional lights, y = point lights
+	DirectionalLightData directionalLights[MAX_DIRECTIONAL_LIGHTS];
+	PointLightData pointLights[MAX_POINT_LIGHTS];
+};
+
+
+layout (location=0) out vec4 fragColour;
+
+
+// Inverse of encodeNormal in nmap-gbuffer.frag
+vec3 decodeNormal(vec2 e) {
+
+	e = e * 2.0 - 1.0;
+
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+
+	return normalize(n);
+}
+
+
+void main(void) {
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	// Nothing was drawn here
+	if (texelFetch(depthTexture, pixel, 0).r >= 1.0)
+		discard;
+
+	vec3 surfaceColour = texelFetch(albedoTexture, pixel, 0).rgb;
+	vec3 N = decodeNormal(texelFetch(normalTexture, pixel, 0).rg);
+
+	vec3 lightSum = vec3(0.0);
+
+	for (int i = 0; i < numLights.x; ++i) {
+
+		float l = max(dot(N, directionalLights[i].direction.xyz), 0.0);
+		lightSum += directionalLights[i].colour.rgb * l;
+	}
+
+	fragColour = vec4(surfaceColour * lightSum, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 410
+
+// Full screen triangle generated from gl_VertexID - draw 3 vertices with no attributes
+
+void main(void) {
+
+	vec2 pos = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1)) - 1.0;
+
+	gl_Position = vec4(pos, 0.0, 1.0);
+}
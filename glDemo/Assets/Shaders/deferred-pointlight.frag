@@ -0,0 +1,78 @@
+#version 410
+
+// Deferred point light - shades the G-buffer pixels covered by the light's volume.  The
+// result is added to the directional light pass with additive blending.
+
+// G-buffer (see DeferredRenderer.h)
+uniform sampler2D albedoTexture; // tex unit 0
+uniform sampler2D normalTexture; // tex unit 1
+uniform sampler2D depthTexture; // tex unit 2
+
+// Per-frame camera matrices - must match the layout in CameraBuffer.h
+layout (std140) uniform CameraBlock {
+
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 viewProjMatrix;
+	mat4 invViewProjMatrix;
+	vec4 cameraPosition;
+};
+
+// World position reconstruction
+uniform vec2 screenSize;
+
+flat in vec4 lightPositionRange;
+flat in vec3 lightColour;
+flat in vec3 lightAttenuation; // x=constant, y=linear, z=quadratic
+
+
+layout (location=0) out vec4 fragColour;
+
+
+// Inverse of encodeNormal in nmap-gbuffer.frag
+vec3 decodeNormal(vec2 e) {
+
+	e = e * 2.0 - 1.0;
+
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+
+	return normalize(n);
+}
+
+
+void main(void) {
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(depthTexture, pixel, 0).r;
+
+	// Nothing was drawn here
+	if (depth >= 1.0)
+		discard;
+
+	// Surface position from the pixel and its depth
+	vec4 worldPos = invViewProjMatrix * vec4(vec3(gl_FragCoord.xy / screenSize, depth) * 2.0 - 1.0, 1.0);
+	vec3 surfaceToLightVec = lightPositionRange.xyz - worldPos.xyz / worldPos.w;
+
+	float d = length(surfaceToLightVec);
+
+	// The volume is a cube around the light's range sphere
+	if (d >= lightPositionRange.w)
+		discard;
+
+	vec3 N = decodeNormal(texelFetch(normalTexture, pixel, 0).rg);
+	float l = max(dot(N, surfaceToLightVec / d), 0.0);
+
+	vec3 k = lightAttenuation;
+	float a = 1.0 / (k.x + (k.y * d) + (k.z * d * d));
+
+	// Fade to zero at the light's range to match nmap-clustered.frag
+	float window = clamp(1.0 - pow(d / lightPositionRange.w, 4.0), 0.0, 1.0);
+
+	vec3 surfaceColour = texelFetch(albedoTexture, pixel, 0).rgb;
+
+	fragColour = vec4(surfaceColour * lightColour * l * a * window, 1.0);
+}
@@ -0,0 +1,46 @@
+#version 410
+
+// Deferred point light volume - an instanced cube (36 vertices, no attributes) sized to
+// the range of light gl_InstanceID.  The faces wind inwards so back face culling keeps the
+// far side of the cube.
+
+// Per-frame camera matrices - must match the layout in CameraBuffer.h
+layout (std140) uniform CameraBlock {
+
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 viewProjMatrix;
+	mat4 invViewProjMatrix;
+	vec4 cameraPosition;
+};
+
+uniform samplerBuffer pointLightTexture; // tex unit 3 - 3 texels per light: position + range, colour, attenuation
+
+const int cubeIndices[36] = int[36](
+	1, 7, 3,  1, 5, 7,		// +x
+	0, 6, 4,  0, 2, 6,		// -x
+	6, 3, 7,  6, 2, 3,		// +y
+	0, 5, 1,  0, 4, 5,		// -y
+	4, 7, 5,  4, 6, 7,		// +z
+	1, 2, 0,  1, 3, 2		// -z
+);
+
+flat out vec4 lightPositionRange;
+flat out vec3 lightColour;
+flat out vec3 lightAttenuation;
+
+
+void main(void) {
+
+	int light = gl_InstanceID * 3;
+
+	lightPositionRange = texelFetch(pointLightTexture, light);
+	lightColour = texelFetch(pointLightTexture, light + 1).rgb;
+	lightAttenuation = texelFetch(pointLightTexture, light + 2).xyz;
+
+	// Corner index bits are the x, y and z signs
+	int corner = cubeIndices[gl_VertexID];
+	vec3 cornerPos = vec3(float(corner & 1), float((corner >> 1) & 1), float((corner >> 2) & 1)) * 2.0 - 1.0;
+
+	gl_Position = viewProjMatrix * vec4(lightPositionRange.xyz + cornerPos * lightPositionRange.w, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 410
+
+// Writes depth only - the model matrix is a per-instance attribute read through the draw's base instance
+
+// Per-frame camera matrices - must match the layout in CameraBuffer.h
+layout (std140) uniform CameraBlock {
+
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 viewProjMatrix;
+	mat4 invViewProjMatrix;
+	vec4 cameraPosition;
+};
+
+layout (location=0) in vec3 vertexPos;
+
+// Per-instance model matrix (one column in each of slots 6-9)
+layout (location=6) in mat4 modelMatrix;
+
+invariant gl_Position;
+
+
+void main(void) {
+
+	vec4 worldCoord = modelMatrix * vec4(vertexPos, 1.0);
+
+	gl_Position = projMatrix * viewMatrix * worldCoord;
+}
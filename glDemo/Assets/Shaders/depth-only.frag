@@ -0,0 +1,8 @@
+#version 410
+
+// Depth pre-pass - colour writes are off so there is nothing to output.  Only depth is written
+
+
+void main(void) {
+
+}
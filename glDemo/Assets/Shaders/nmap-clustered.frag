@@ -0,0 +1,126 @@
+#version 410
+
+// Normal mapped clustered forward shader - directional lights come from the LightBlock
+// uniform buffer as in nmap-multilight.frag, but point lights are only evaluated if they
+// were binned into the fragment's cluster (see ClusteredLights.h).
+
+#define MAX_DIRECTIONAL_LIGHTS 16
+#define MAX_POINT_LIGHTS 64
+
+// Texture sampler (for diffuse surface colour)
+uniform sampler2D diffuseTexture; // tex unit 0
+
+// Texture sampler for normal map texture
+uniform sampler2D normalMapTexture; // tex unit 1
+
+// Cluster light lists
+uniform usamplerBuffer clusterTexture; // tex unit 2 - first light index and number of lights per cluster
+uniform usamplerBuffer lightIndexTexture; // tex unit 3
+uniform samplerBuffer pointLightTexture; // tex unit 4 - 3 texels per light: position + range, colour, attenuation
+
+// Per-frame camera matrices (the view matrix is used to find the fragment's depth slice) - must match the layout in CameraBuffer.h
+layout (std140) uniform CameraBlock {
+
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 viewProjMatrix;
+	mat4 invViewProjMatrix;
+	vec4 cameraPosition;
+};
+
+struct DirectionalLightData {
+
+	vec4 direction; // towards the light
+	vec4 colour;
+};
+
+struct PointLightData {
+
+	vec4 position;
+	vec4 colour;
+	vec4 attenuation; // x=constant, y=linear, z=quadratic
+};
+
+// Must match the layout in LightBuffer.h (the point lights here are unused)
+layout (std140) uniform LightBlock {
+
+	ivec4 numLights; // x = directional lights, y = point lights
+	DirectionalLightData directionalLights[MAX_DIRECTIONAL_LIGHTS];
+	PointLightData pointLights[MAX_POINT_LIGHTS];
+};
+
+// Must match the layout in ClusteredLights.h
+layout (std140) uniform ClusterBlock {
+
+	ivec4 clusterGrid; // xyz = clusters in x, y and depth
+	vec4 clusterParams; // xy = tile size in pixels, zw = depth slice scale and bias
+};
+
+
+in MultiLightPacket {
+
+	vec3 surfaceWorldPos;
+	vec3 worldTangent;
+	vec3 worldBitangent;
+	vec3 worldNormal;
+	vec2 texCoord;
+
+} inputFragment;
+
+
+layout (location=0) out vec4 fragColour;
+
+
+void main(void) {
+
+	// Get normal from normal map (RG - cooked BC5 normal maps only store x and y)
+	vec3 tsNormal;
+	tsNormal.xy = texture2D(normalMapTexture, inputFragment.texCoord).rg * 2.0 - 1.0;
+	tsNormal.z = sqrt(max(0.0, 1.0 - dot(tsNormal.xy, tsNormal.xy)));
+
+	// Take the normal into world coordinates so it can be lit by any light
+	mat3 tbn = mat3(inputFragment.worldTangent, inputFragment.worldBitangent, inputFragment.worldNormal);
+	vec3 N = normalize(tbn * tsNormal);
+
+	vec3 lightSum = vec3(0.0);
+
+	for (int i = 0; i < numLights.x; ++i) {
+
+		// Each light is clamped to match the multi-pass result (negative light isn't subtracted)
+		float l = max(dot(N, directionalLights[i].direction.xyz), 0.0);
+		lightSum += directionalLights[i].colour.rgb * l;
+	}
+
+	// Find the fragment's cluster
+	float viewDepth = -(viewMatrix * vec4(inputFragment.surfaceWorldPos, 1.0)).z;
+
+	int slice = clamp(int(floor(log(viewDepth) * clusterParams.z + clusterParams.w)), 0, clusterGrid.z - 1);
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterParams.xy), ivec2(0), clusterGrid.xy - ivec2(1));
+
+	uvec2 cluster = texelFetch(clusterTexture, (slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x).rg;
+
+	for (uint i = 0u; i < cluster.y; ++i) {
+
+		int light = int(texelFetch(lightIndexTexture, int(cluster.x + i)).r) * 3;
+
+		vec4 positionRange = texelFetch(pointLightTexture, light);
+		vec3 colour = texelFetch(pointLightTexture, light + 1).rgb;
+		vec3 k = texelFetch(pointLightTexture, light + 2).xyz;
+
+		vec3 surfaceToLightVec = positionRange.xyz - inputFragment.surfaceWorldPos;
+		float d = length(surfaceToLightVec);
+
+		float l = max(dot(N, surfaceToLightVec / d), 0.0);
+		float a = 1.0 / (k.x + (k.y * d) + (k.z * d * d));
+
+		// Fade to zero at the light's range so it doesn't cut off at cluster edges
+		float window = clamp(1.0 - pow(d / positionRange.w, 4.0), 0.0, 1.0);
+
+		lightSum += colour * l * a * window;
+	}
+
+	// Calculate diffuse brightness / colour for fragment
+	vec4 surfaceColour = texture2D(diffuseTexture, inputFragment.texCoord);
+
+	fragColour = vec4(surfaceColour.rgb * lightSum, 1.0);
+}
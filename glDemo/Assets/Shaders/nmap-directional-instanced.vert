@@ -0,0 +1,80 @@
+#version 410
+
+// Instanced version of nmap-directional.vert - the model matrix is a per-instance attribute instead of a uniform
+
+// Per-frame camera matrices - must match the layout in CameraBuffer.h
+layout (std140) uniform CameraBlock {
+
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 viewProjMatrix;
+	mat4 invViewProjMatrix;
+	vec4 cameraPosition;
+};
+
+// Directional light model (dont't need colour vector in vertex shader)
+// It's okay to split the relevant variables between the shaders that need them!
+uniform vec3 lightDirection;
+
+// Incomping vertex packet - now including the tangent in slot 4
+// With the packed vertex format the normal and tangent arrive as normalised 10:10:10:2
+// values.  With either format the tangent's w component holds the bitangent sign and there
+// is no bitangent stream, so the bitangent is reconstructed below.
+layout (location=0) in vec3 vertexPos;
+layout (location=2) in vec3 vertexTexCoord;
+layout (location=3) in vec3 vertexNormal;
+layout (location=4) in vec4 tangent;
+
+// Per-instance model matrix (one column in each of slots 6-9)
+layout (location=6) in mat4 modelMatrix;
+
+// Per-instance normal matrix calculated on the CPU (one column in each of slots 10-12)
+layout (location=10) in mat3 normalMatrix;
+
+// Output packet to pass onto the rasteriser / fragment shader.
+// We don't output the normal here (this gets accessed in the normal map)
+// in the fragment shader.  Instead we pass on the direction-to-light
+// vector.  This is calculated here, in the vertex shader, as it avoids
+// the  need to pass the entire (vertexNormal, tangent, bitangent) basis
+// vector set onto the fragment shader.
+out SimplePacket {
+
+    vec3 surfaceWorldPos;
+    vec3 tsLightDirection; // normals will come from the normal map - we interpolate light direction vec in surface tangent space
+    vec2 texCoord;
+
+} outputVertex;
+
+// Must match depth-only-instanced.vert exactly so the depth pre-pass (tested with GL_EQUAL) lines up
+invariant gl_Position;
+
+
+void main(void) {
+
+	outputVertex.texCoord = vertexTexCoord.st;
+
+    // Reconstruct the bitangent from the normal, tangent and handedness sign
+    vec3 vertexBitangent = cross(vertexNormal, tangent.xyz) * tangent.w;
+
+    // Transform the normal and tangent vectors to correct orientation
+    // to match the host object's orientation in world coordinates.
+    vec3 n = normalMatrix * vertexNormal;
+    vec3 t = normalMatrix * tangent.xyz;
+    vec3 b = normalMatrix * vertexBitangent;
+
+    // We know the direction to light vector from the 'lightDirection'
+    // uniform.  We map this into the tangent space defined by the basis
+    // vectors (vertexNormal, tangent, bitangent) 
+    vec3 tVec;
+	tVec.x = dot(lightDirection, t);
+	tVec.y = dot(lightDirection, b);
+	tVec.z = dot(lightDirection, n);
+	outputVertex.tsLightDirection = normalize(tVec);
+
+    // take vertexPos into world coords and pass onto fragment shader
+    vec4 worldCoord = modelMatrix * vec4(vertexPos, 1.0);
+    outputVertex.surfaceWorldPos = worldCoord.xyz; // don't need w element
+
+    // take worldCoord rest of the way into clip coords and set in gl_Position
+	gl_Position = projMatrix * viewMatrix * worldCoord;
+}
@@ -32,12 +32,13 @@ layout (location=0) out vec4 fragColour;
 
 void main(void) {
 
-	// Get normal from normal map (RGB)
-	vec3 N = texture2D(normalMapTexture, inputFragment.texCoord).xyz;
+	// Get normal from normal map (RG - cooked BC5 normal maps only store x and y)
+	vec3 N;
+	N.xy = texture2D(normalMapTexture, inputFragment.texCoord).rg;
 	
-	// Map the RGB values back to the [-1, +1] coordinate range
-	//N = vec3(2.0) * (N - vec3(0.5));
-	N = (N - 0.5) * 2.0;
+	// Map the RG values back to the [-1, +1] coordinate range and reconstruct z
+	N.xy = (N.xy - 0.5) * 2.0;
+	N.z = sqrt(max(0.0, 1.0 - dot(N.xy, N.xy)));
 
 	// Ensure the normal is unit length (has length of 1)
 	N = normalize(N);
@@ -1,19 +1,33 @@
 #version 410
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
+
+// Inverse transpose of the model matrix's upper 3x3 - calculated on the CPU (see NormalMatrices.h) and
+// used to transform the normal and tangent vectors correctly under non-uniform scaling
+uniform mat3 normalMatrix;
+
+// Per-frame camera matrices - must match the layout in CameraBuffer.h
+layout (std140) uniform CameraBlock {
+
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 viewProjMatrix;
+	mat4 invViewProjMatrix;
+	vec4 cameraPosition;
+};
 
 // Directional light model (dont't need colour vector in vertex shader)
 // It's okay to split the relevant variables between the shaders that need them!
 uniform vec3 lightDirection;
 
-// Incomping vertex packet - now including tangent and bitanget in slots 4 and 5
+// Incomping vertex packet - now including the tangent in slot 4
+// With the packed vertex format the normal and tangent arrive as normalised 10:10:10:2
+// values.  With either format the tangent's w component holds the bitangent sign and there
+// is no bitangent stream, so the bitangent is reconstructed below.
 layout (location=0) in vec3 vertexPos;
 layout (location=2) in vec3 vertexTexCoord;
 layout (location=3) in vec3 vertexNormal;
-layout (location=4) in vec3 tangent;
-layout (location=5) in vec3 bitangent;
+layout (location=4) in vec4 tangent;
 
 // Output packet to pass onto the rasteriser / fragment shader.
 // We don't output the normal here (this gets accessed in the normal map)
@@ -29,20 +43,22 @@ out SimplePacket {
 
 } outputVertex;
 
+// Must match depth-only-instanced.vert exactly so the depth pre-pass (tested with GL_EQUAL) lines up
+invariant gl_Position;
+
 
 void main(void) {
 
 	outputVertex.texCoord = vertexTexCoord.st;
 
-    // Calculte the inverse-transpose of the model matrix - this is
-    // used to transform the normal and tangent vectors correctly!
-    mat4 normalMatrix = transpose(inverse(modelMatrix));
+    // Reconstruct the bitangent from the normal, tangent and handedness sign
+    vec3 vertexBitangent = cross(vertexNormal, tangent.xyz) * tangent.w;
 
     // Transform the normal and tangent vectors to correct orientation
     // to match the host object's orientation in world coordinates.
-    vec3 n = (normalMatrix * vec4(vertexNormal, 0.0)).xyz;
-    vec3 t = (normalMatrix * vec4(tangent, 0.0)).xyz;
-    vec3 b = (normalMatrix * vec4(bitangent, 0.0)).xyz;
+    vec3 n = normalMatrix * vertexNormal;
+    vec3 t = normalMatrix * tangent.xyz;
+    vec3 b = normalMatrix * vertexBitangent;
 
     // We know the direction to light vector from the 'lightDirection'
     // uniform.  We map this into the tangent space defined by the basis
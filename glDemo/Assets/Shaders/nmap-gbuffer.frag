@@ -0,0 +1,54 @@
+#version 410
+
+// Normal mapped G-buffer shader - writes the surface's albedo and world normal for deferred
+// shading (see DeferredRenderer.h).  Uses the same vertex stage as nmap-multilight.frag.
+
+// Texture sampler (for diffuse surface colour)
+uniform sampler2D diffuseTexture; // tex unit 0
+
+// Texture sampler for normal map texture
+uniform sampler2D normalMapTexture; // tex unit 1
+
+
+in MultiLightPacket {
+
+	vec3 surfaceWorldPos;
+	vec3 worldTangent;
+	vec3 worldBitangent;
+	vec3 worldNormal;
+	vec2 texCoord;
+
+} inputFragment;
+
+
+layout (location=0) out vec4 albedo;
+layout (location=1) out vec2 encodedNormal;
+
+
+// Octahedral normal encoding - the unit sphere is projected onto an octahedron and the
+// lower half folded over the upper half, mapping the normal to 2 values in [0, 1]
+vec2 encodeNormal(vec3 n) {
+
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+
+	return n.xy * 0.5 + 0.5;
+}
+
+
+void main(void) {
+
+	// Get normal from normal map (RG - cooked BC5 normal maps only store x and y)
+	vec3 tsNormal;
+	tsNormal.xy = texture2D(normalMapTexture, inputFragment.texCoord).rg * 2.0 - 1.0;
+	tsNormal.z = sqrt(max(0.0, 1.0 - dot(tsNormal.xy, tsNormal.xy)));
+
+	mat3 tbn = mat3(inputFragment.worldTangent, inputFragment.worldBitangent, inputFragment.worldNormal);
+	vec3 N = normalize(tbn * tsNormal);
+
+	// Alpha marks pixels covered by the scene
+	albedo = vec4(texture2D(diffuseTexture, inputFragment.texCoord).rgb, 1.0);
+	encodedNormal = encodeNormal(N);
+}
@@ -0,0 +1,60 @@
+#version 410
+
+// Normal mapped multiple light shader - vertex stage.  Unlike nmap-directional.vert
+// the lights aren't known here (the fragment shader loops over all of them) so the
+// surface basis is passed on in world coordinates instead of a tangent space light vector.
+// Instanced version - the model matrix is a per-instance attribute instead of a uniform.
+
+// Per-frame camera matrices - must match the layout in CameraBuffer.h
+layout (std140) uniform CameraBlock {
+
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 viewProjMatrix;
+	mat4 invViewProjMatrix;
+	vec4 cameraPosition;
+};
+
+// Same vertex layout as nmap-directional.vert
+layout (location=0) in vec3 vertexPos;
+layout (location=2) in vec3 vertexTexCoord;
+layout (location=3) in vec3 vertexNormal;
+layout (location=4) in vec4 tangent;
+
+// Per-instance model matrix (one column in each of slots 6-9)
+layout (location=6) in mat4 modelMatrix;
+
+// Per-instance normal matrix calculated on the CPU (one column in each of slots 10-12)
+layout (location=10) in mat3 normalMatrix;
+
+out MultiLightPacket {
+
+    vec3 surfaceWorldPos;
+    vec3 worldTangent;
+    vec3 worldBitangent;
+    vec3 worldNormal;
+    vec2 texCoord;
+
+} outputVertex;
+
+// Must match depth-only-instanced.vert exactly so the depth pre-pass (tested with GL_EQUAL) lines up
+invariant gl_Position;
+
+
+void main(void) {
+
+	outputVertex.texCoord = vertexTexCoord.st;
+
+    // Reconstruct the bitangent from the normal, tangent and handedness sign
+    vec3 vertexBitangent = cross(vertexNormal, tangent.xyz) * tangent.w;
+
+    // Transform the surface basis into world coordinates
+    outputVertex.worldNormal = normalMatrix * vertexNormal;
+    outputVertex.worldTangent = normalMatrix * tangent.xyz;
+    outputVertex.worldBitangent = normalMatrix * vertexBitangent;
+
+    vec4 worldCoord = modelMatrix * vec4(vertexPos, 1.0);
+    outputVertex.surfaceWorldPos = worldCoord.xyz;
+
+	gl_Position = projMatrix * viewMatrix * worldCoord;
+}
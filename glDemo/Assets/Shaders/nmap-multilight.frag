@@ -0,0 +1,89 @@
+#version 410
+
+// Normal mapped multiple light shader - every directional and point light in the
+// LightBlock uniform buffer is shaded in a single pass (instead of drawing the scene
+// once per light with additive blending).
+
+#define MAX_DIRECTIONAL_LIGHTS 16
+#define MAX_POINT_LIGHTS 64
+
+// Texture sampler (for diffuse surface colour)
+uniform sampler2D diffuseTexture; // tex unit 0
+
+// Texture sampler for normal map texture
+uniform sampler2D normalMapTexture; // tex unit 1
+
+struct DirectionalLightData {
+
+	vec4 direction; // towards the light
+	vec4 colour;
+};
+
+struct PointLightData {
+
+	vec4 position;
+	vec4 colour;
+	vec4 attenuation; // x=constant, y=linear, z=quadratic
+};
+
+// Must match the layout in LightBuffer.h
+layout (std140) uniform LightBlock {
+
+	ivec4 numLights; // x = directional lights, y = point lights
+	DirectionalLightData directionalLights[MAX_DIRECTIONAL_LIGHTS];
+	PointLightData pointLights[MAX_POINT_LIGHTS];
+};
+
+
+in MultiLightPacket {
+
+	vec3 surfaceWorldPos;
+	vec3 worldTangent;
+	vec3 worldBitangent;
+	vec3 worldNormal;
+	vec2 texCoord;
+
+} inputFragment;
+
+
+layout (location=0) out vec4 fragColour;
+
+
+void main(void) {
+
+	// Get normal from normal map (RG - cooked BC5 normal maps only store x and y)
+	vec3 tsNormal;
+	tsNormal.xy = texture2D(normalMapTexture, inputFragment.texCoord).rg * 2.0 - 1.0;
+	tsNormal.z = sqrt(max(0.0, 1.0 - dot(tsNormal.xy, tsNormal.xy)));
+
+	// Take the normal into world coordinates so it can be lit by any light
+	mat3 tbn = mat3(inputFragment.worldTangent, inputFragment.worldBitangent, inputFragment.worldNormal);
+	vec3 N = normalize(tbn * tsNormal);
+
+	vec3 lightSum = vec3(0.0);
+
+	for (int i = 0; i < numLights.x; ++i) {
+
+		// Each light is clamped to match the multi-pass result (negative light isn't subtracted)
+		float l = max(dot(N, directionalLights[i].direction.xyz), 0.0);
+		lightSum += directionalLights[i].colour.rgb * l;
+	}
+
+	for (int i = 0; i < numLights.y; ++i) {
+
+		vec3 surfaceToLightVec = pointLights[i].position.xyz - inputFragment.surfaceWorldPos;
+		float d = length(surfaceToLightVec);
+
+		float l = max(dot(N, surfaceToLightVec / d), 0.0);
+
+		vec3 k = pointLights[i].attenuation.xyz;
+		float a = 1.0 / (k.x + (k.y * d) + (k.z * d * d));
+
+		lightSum += pointLights[i].colour.rgb * l * a;
+	}
+
+	// Calculate diffuse brightness / colour for fragment
+	vec4 surfaceColour = texture2D(diffuseTexture, inputFragment.texCoord);
+
+	fragColour = vec4(surfaceColour.rgb * lightSum, 1.0);
+}
@@ -1,6 +1,7 @@
 #version 410
 
 uniform mat4 modelMatrix;
+uniform mat3 normalMatrix; // inverse transpose of the model matrix's upper 3x3, calculated on the CPU (see NormalMatrices.h)
 uniform mat4 viewMatrix;
 uniform mat4 projMatrix;
 
@@ -21,8 +22,8 @@ void main(void) {
 
 	outputVertex.texCoord = vertexTexCoord.st;
 
-  // transform normal vector by inverse-transpose of the model matrix
-  outputVertex.surfaceNormal = (transpose(inverse(modelMatrix)) * vec4(vertexNormal, 0.0)).xyz;
+  // transform normal vector by the normal matrix (the inverse-transpose of the model matrix)
+  outputVertex.surfaceNormal = normalMatrix * vertexNormal;
 
   // take vertexPos into world coords and pass onto fragment shader
   vec4 worldCoord = modelMatrix * vec4(vertexPos, 1.0);
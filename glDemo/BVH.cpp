@@ -0,0 +1,302 @@
+#include "BVH.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace glm;
+
+
+// Half the surface area of a box (the SAH only compares areas)
+static float halfArea(const vec3& boxMin, const vec3& boxMax) {
+
+	vec3 size = glm::max(boxMax - boxMin, vec3(0.0f));
+
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+
+void BVH::loadBoxes(const BoxList& boxes) {
+
+	GLuint numBoxes = boxes.size();
+
+	primitiveMin.resize(numBoxes);
+	primitiveMax.resize(numBoxes);
+	primitiveCentroids.resize(numBoxes);
+
+	for (GLuint i = 0; i < numBoxes; ++i) {
+
+		vec3 centre = vec3(boxes.centreX[i], boxes.centreY[i], boxes.centreZ[i]);
+		vec3 extent = vec3(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+
+		primitiveMin[i] = centre - extent;
+		primitiveMax[i] = centre + extent;
+		primitiveCentroids[i] = centre;
+	}
+}
+
+
+void BVH::split(GLuint nodeIndex) {
+
+	GLuint first = nodes[nodeIndex].firstPrimitive;
+	GLuint count = nodes[nodeIndex].numPrimitives;
+
+	// Node bounds, and the bounds of the centroids the split planes are placed between
+	vec3 boxMin = vec3(FLT_MAX), boxMax = vec3(-FLT_MAX);
+	vec3 centroidMin = vec3(FLT_MAX), centroidMax = vec3(-FLT_MAX);
+
+	for (GLuint i = first; i < first + count; ++i) {
+
+		GLuint p = primitiveIndices[i];
+
+		boxMin = glm::min(boxMin, primitiveMin[p]);
+		boxMax = glm::max(boxMax, primitiveMax[p]);
+		centroidMin = glm::min(centroidMin, primitiveCentroids[p]);
+		centroidMax = glm::max(centroidMax, primitiveCentroids[p]);
+	}
+
+	nodes[nodeIndex].boxMin = boxMin;
+	nodes[nodeIndex].boxMax = boxMax;
+
+	if (count <= maxLeafSize)
+		return;
+
+	// Find the cheapest split over numBins buckets on each axis.  Cost is the child areas weighted by their number of boxes - a leaf costs its area times its number of boxes
+	float bestCost = halfArea(boxMin, boxMax) * (float)count;
+	int bestAxis = -1;
+	GLuint bestSplit = 0;
+
+	for (int axis = 0; axis < 3; ++axis) {
+
+		float axisMin = centroidMin[axis];
+		float axisSize = centroidMax[axis] - axisMin;
+
+		if (axisSize <= 0.0f)
+			continue;
+
+		float binScale = (float)numBins / axisSize;
+
+		GLuint binCounts[numBins] = {};
+		vec3 binMin[numBins], binMax[numBins];
+
+		for (GLuint b = 0; b < numBins; ++b) {
+
+			binMin[b] = vec3(FLT_MAX);
+			binMax[b] = vec3(-FLT_MAX);
+		}
+
+		for (GLuint i = first; i < first + count; ++i) {
+
+			GLuint p = primitiveIndices[i];
+			GLuint b = glm::min((GLuint)((primitiveCentroids[p][axis] - axisMin) * binScale), numBins - 1);
+
+			binCounts[b]++;
+			binMin[b] = glm::min(binMin[b], primitiveMin[p]);
+			binMax[b] = glm::max(binMax[b], primitiveMax[p]);
+		}
+
+		// Sweep from the right to get the cost of every right hand side, then from the left to evaluate each split
+		float rightArea[numBins];
+		GLuint rightCount[numBins];
+		vec3 sweepMin = vec3(FLT_MAX), sweepMax = vec3(-FLT_MAX);
+		GLuint sweepCount = 0;
+
+		for (GLuint b = numBins - 1; b > 0; --b) {
+
+			sweepMin = glm::min(sweepMin, binMin[b]);
+			sweepMax = glm::max(sweepMax, binMax[b]);
+			sweepCount += binCounts[b];
+
+			rightArea[b] = halfArea(sweepMin, sweepMax);
+			rightCount[b] = sweepCount;
+		}
+
+		sweepMin = vec3(FLT_MAX);
+		sweepMax = vec3(-FLT_MAX);
+		sweepCount = 0;
+
+		// Split s puts bins [0, s) on the left
+		for (GLuint s = 1; s < numBins; ++s) {
+
+			sweepMin = glm::min(sweepMin, binMin[s - 1]);
+			sweepMax = glm::max(sweepMax, binMax[s - 1]);
+			sweepCount += binCounts[s - 1];
+
+			if (sweepCount == 0 || rightCount[s] == 0)
+				continue;
+
+			float cost = halfArea(sweepMin, sweepMax) * (float)sweepCount + rightArea[s] * (float)rightCount[s];
+
+			if (cost < bestCost) {
+
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = s;
+			}
+		}
+	}
+
+	// No split is cheaper than testing every box
+	if (bestAxis < 0)
+		return;
+
+	float axisMin = centroidMin[bestAxis];
+	float binScale = (float)numBins / (centroidMax[bestAxis] - axisMin);
+
+	auto middle = partition(primitiveIndices.begin() + first, primitiveIndices.begin() + first + count, [&](GLuint p) {
+
+		return glm::min((GLuint)((primitiveCentroids[p][bestAxis] - axisMin) * binScale), numBins - 1) < bestSplit;
+	});
+
+	GLuint leftCount = (GLuint)(middle - (primitiveIndices.begin() + first));
+
+	// Children are added after their parent so refit can update the nodes in reverse order
+	GLuint leftChild = (GLuint)nodes.size();
+
+	nodes[nodeIndex].leftChild = leftChild;
+
+	Node left = { vec3(0.0f), vec3(0.0f), 0, first, leftCount };
+	Node right = { vec3(0.0f), vec3(0.0f), 0, first + leftCount, count - leftCount };
+
+	nodes.push_back(left);
+	nodes.push_back(right);
+
+	split(leftChild);
+	split(leftChild + 1);
+}
+
+
+void BVH::build(const BoxList& boxes) {
+
+	auto buildStart = chrono::high_resolution_clock::now();
+
+	GLuint numBoxes = boxes.size();
+
+	nodes.clear();
+	primitiveIndices.resize(numBoxes);
+
+	for (GLuint i = 0; i < numBoxes; ++i)
+		primitiveIndices[i] = i;
+
+	if (numBoxes > 0) {
+
+		loadBoxes(boxes);
+
+		// A binary tree with at least one box per leaf has fewer than twice as many nodes as boxes
+		nodes.reserve(numBoxes * 2);
+
+		Node root = { vec3(0.0f), vec3(0.0f), 0, 0, numBoxes };
+		nodes.push_back(root);
+
+		split(0);
+	}
+
+	buildTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - buildStart).count();
+}
+
+
+void BVH::refit(const BoxList& boxes) {
+
+	auto refitStart = chrono::high_resolution_clock::now();
+
+	assert(boxes.size() == primitiveIndices.size());
+
+	loadBoxes(boxes);
+
+	// Children always come after their parent
+	for (size_t i = nodes.size(); i-- > 0;) {
+
+		Node& node = nodes[i];
+
+		if (node.leftChild) {
+
+			const Node& left = nodes[node.leftChild];
+			const Node& right = nodes[node.leftChild + 1];
+
+			node.boxMin = glm::min(left.boxMin, right.boxMin);
+			node.boxMax = glm::max(left.boxMax, right.boxMax);
+		}
+		else {
+
+			node.boxMin = vec3(FLT_MAX);
+			node.boxMax = vec3(-FLT_MAX);
+
+			for (GLuint j = node.firstPrimitive; j < node.firstPrimitive + node.numPrimitives; ++j) {
+
+				node.boxMin = glm::min(node.boxMin, primitiveMin[primitiveIndices[j]]);
+				node.boxMax = glm::max(node.boxMax, primitiveMax[primitiveIndices[j]]);
+			}
+		}
+	}
+
+	refitTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - refitStart).count();
+}
+
+
+GLuint BVH::cull(const Frustum& frustum, uint8_t* visible) {
+
+	auto cullStart = chrono::high_resolution_clock::now();
+
+	GLuint numVisible = 0;
+	numNodesVisited = 0;
+
+	memset(visible, 0, primitiveIndices.size());
+
+	if (!nodes.empty())
+		stack.push_back(make_pair(0u, (unsigned)Frustum::allPlanes));
+
+	while (!stack.empty()) {
+
+		GLuint nodeIndex = stack.back().first;
+		unsigned planeMask = stack.back().second;
+		stack.pop_back();
+
+		const Node& node = nodes[nodeIndex];
+		numNodesVisited++;
+
+		Frustum::Containment containment = frustum.classifyBox((node.boxMin + node.boxMax) * 0.5f, (node.boxMax - node.boxMin) * 0.5f, planeMask);
+
+		if (containment == Frustum::Containment::Outside)
+			continue;
+
+		// Everything below a node inside the frustum is visible
+		if (containment == Frustum::Containment::Inside) {
+
+			for (GLuint i = node.firstPrimitive; i < node.firstPrimitive + node.numPrimitives; ++i)
+				visible[primitiveIndices[i]] = 1;
+
+			numVisible += node.numPrimitives;
+			continue;
+		}
+
+		// Boxes of a leaf that straddles the frustum are tested against the planes it crosses
+		if (!node.leftChild) {
+
+			for (GLuint i = node.firstPrimitive; i < node.firstPrimitive + node.numPrimitives; ++i) {
+
+				GLuint p = primitiveIndices[i];
+				unsigned primitivePlaneMask = planeMask;
+
+				if (frustum.classifyBox(primitiveCentroids[p], (primitiveMax[p] - primitiveMin[p]) * 0.5f, primitivePlaneMask) != Frustum::Containment::Outside) {
+
+					visible[p] = 1;
+					numVisible++;
+				}
+			}
+
+			continue;
+		}
+
+		stack.push_back(make_pair(node.leftChild + 1, planeMask));
+		stack.push_back(make_pair(node.leftChild, planeMask));
+	}
+
+	cullTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - cullStart).count();
+
+	return numVisible;
+}
+
+
+void BVH::reportStats() {
+
+	printf("BVH: %u boxes, %u nodes, built in %.3fms, last refit %.3fms, last cull %.3fms (%u nodes visited)\n", getNumPrimitives(), getNumNodes(), buildTime, refitTime, cullTime, numNodesVisited);
+}
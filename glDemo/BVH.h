@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core.h"
+#include "Frustum.h"
+
+// Bounding volume hierarchy over a list of boxes (such as the world space boxes of every mesh in the scene).  The tree is built top down, splitting each node where the surface area heuristic (SAH) estimates the cheapest traversal, using numBins buckets of primitive centroids on each axis.
+// When boxes move but the list is otherwise unchanged the tree can be refit - node bounds are recalculated bottom up in one pass over the nodes without changing the tree's structure.  Refitting is much faster than rebuilding but the tree gets less efficient the further the boxes move from where they were when it was built.
+// cull walks the tree against a frustum, so a node that is outside rejects all the boxes below it with one test, and a node entirely inside accepts them without testing.
+
+class BVH {
+
+public:
+
+	static const GLuint		maxLeafSize = 4;
+	static const GLuint		numBins = 12;
+
+private:
+
+	struct Node {
+
+		glm::vec3			boxMin;
+		glm::vec3			boxMax;
+		GLuint				leftChild; // right child is leftChild + 1.  0 = leaf (the root is never a child)
+		GLuint				firstPrimitive; // every node covers a contiguous range of primitiveIndices
+		GLuint				numPrimitives;
+	};
+
+	std::vector<Node>		nodes;
+	std::vector<GLuint>		primitiveIndices; // box indices ordered so each node's boxes are contiguous
+
+	// Build scratch space - bounds and centroid of each box
+	std::vector<glm::vec3>	primitiveMin;
+	std::vector<glm::vec3>	primitiveMax;
+	std::vector<glm::vec3>	primitiveCentroids;
+
+	// Traversal stack - (node, plane mask) pairs
+	std::vector<std::pair<GLuint, unsigned>> stack;
+
+	// Statistics
+	double					buildTime = 0.0; // ms
+	double					refitTime = 0.0; // ms of the last refit
+	double					cullTime = 0.0; // ms of the last cull
+	GLuint					numNodesVisited = 0; // by the last cull
+
+	void loadBoxes(const BoxList& boxes);
+	void split(GLuint nodeIndex);
+
+public:
+
+	// Build the tree over boxes.  Box indices are the primitives - cull reports the visibility of each index
+	void build(const BoxList& boxes);
+
+	// Update the node bounds for boxes that have moved.  boxes must have the same number of boxes as when the tree was built
+	void refit(const BoxList& boxes);
+
+	// Set visible[i] to 1 for each box i that is at least partly inside frustum and 0 for the others.  Returns the number of visible boxes
+	GLuint cull(const Frustum& frustum, uint8_t* visible);
+
+	GLuint getNumPrimitives() const { return (GLuint)primitiveIndices.size(); }
+	GLuint getNumNodes() const { return (GLuint)nodes.size(); }
+
+	double getBuildTime() const { return buildTime; }
+	double getRefitTime() const { return refitTime; }
+	double getCullTime() const { return cullTime; }
+	GLuint getNumNodesVisited() const { return numNodesVisited; }
+
+	void reportStats();
+};
@@ -0,0 +1,68 @@
+#include "CameraBuffer.h"
+
+using namespace std;
+using namespace glm;
+
+
+CameraBuffer::CameraBuffer(DynamicRingBuffer* ring) {
+
+	this->ring = ring;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+
+CameraBuffer::~CameraBuffer() {
+
+	glDeleteBuffers(1, &buffer);
+}
+
+
+void CameraBuffer::update(const mat4& viewMatrix, const mat4& projMatrix) {
+
+	CameraBlock block;
+
+	block.viewMatrix = viewMatrix;
+	block.projMatrix = projMatrix;
+	block.viewProjMatrix = projMatrix * viewMatrix;
+	block.invViewProjMatrix = inverse(block.viewProjMatrix);
+
+	// The camera sits at the view space origin
+	block.cameraPosition = inverse(viewMatrix) * vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	DynamicRingBuffer::Allocation allocation;
+
+	if (ring && ring->allocate(sizeof(CameraBlock), ring->getUniformAlignment(), allocation)) {
+
+		memcpy(allocation.data, &block, sizeof(CameraBlock));
+		ringOffset = allocation.offset;
+		return;
+	}
+
+	ringOffset = -1;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+
+void CameraBuffer::bind() {
+
+	if (ringOffset >= 0)
+		glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, ring->getBuffer(), ringOffset, sizeof(CameraBlock));
+	else
+		glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
+}
+
+
+void CameraBuffer::bindBlock(GLuint program) {
+
+	GLuint blockIndex = glGetUniformBlockIndex(program, "CameraBlock");
+
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, blockIndex, bindingPoint);
+}
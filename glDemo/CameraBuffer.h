@@ -0,0 +1,48 @@
+#pragma once
+
+#include "core.h"
+#include "DynamicRingBuffer.h"
+
+// Uniform buffer holding the camera matrices for the frame.  It is updated and bound once per frame, so programs don't need their own view and projection uniforms set after each glUseProgram.  Shaders declare the matching std140 block:
+//   layout (std140) uniform CameraBlock {
+//       mat4 viewMatrix;
+//       mat4 projMatrix;
+//       mat4 viewProjMatrix;
+//       mat4 invViewProjMatrix;
+//       vec4 cameraPosition; // world space, w = 1
+//   };
+// GLSL 4.10 has no binding qualifier so each program's block is bound to bindingPoint with bindBlock.  Given a dynamic ring, each update writes the block into the ring instead of updating the buffer in place.
+
+class CameraBuffer {
+
+	// std140 layout of CameraBlock
+	struct CameraBlock {
+
+		glm::mat4				viewMatrix;
+		glm::mat4				projMatrix;
+		glm::mat4				viewProjMatrix;
+		glm::mat4				invViewProjMatrix;
+		glm::vec4				cameraPosition;
+	};
+
+	GLuint						buffer = 0;
+
+	DynamicRingBuffer*			ring = nullptr;
+	GLintptr					ringOffset = -1; // of the last update's block in the ring (-1 = in buffer)
+
+public:
+
+	static const GLuint			bindingPoint = 2;
+
+	CameraBuffer(DynamicRingBuffer* ring = nullptr);
+	~CameraBuffer();
+
+	// Copy the camera matrices into the buffer - the derived matrices and camera position are calculated here
+	void update(const glm::mat4& viewMatrix, const glm::mat4& projMatrix);
+
+	// Bind the last update's block to bindingPoint
+	void bind();
+
+	// Bind program's CameraBlock (if it has one) to bindingPoint
+	static void bindBlock(GLuint program);
+};
@@ -0,0 +1,286 @@
+#include "ClusteredLights.h"
+#include "GLStateCache.h"
+#include <chrono>
+
+using namespace std;
+using namespace glm;
+
+
+// Create a buffer texture of the given format that reads buffer.  It is bound through the state cache (to unit 0) so the cache's bindings stay in step with GL
+static GLuint createBufferTexture(GLuint buffer, GLenum format) {
+
+	GLuint texture = 0;
+
+	glGenTextures(1, &texture);
+	GLStateCache::bindTextureBuffer(0, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+
+	return texture;
+}
+
+
+// Replace the contents of buffer (orphaning the old storage so the GPU can keep reading it).  Buffer textures can't be empty so at least minSize bytes are allocated
+static void uploadBuffer(GLuint buffer, GLsizeiptr size, const void* data, GLsizeiptr minSize) {
+
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, glm::max(size, minSize), nullptr, GL_STREAM_DRAW);
+
+	if (size > 0)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
+
+
+// Fill the buffer texture bound to unit - from a copy in the ring if there is room, otherwise from its own buffer
+static void uploadTexture(DynamicRingBuffer* ring, GLuint unit, GLuint texture, GLenum format, GLuint buffer, GLsizeiptr size, const void* data, GLsizeiptr minSize) {
+
+	GLStateCache::bindTextureBuffer(unit, texture);
+
+	GLsizeiptr rangeSize = glm::max(size, minSize);
+	DynamicRingBuffer::Allocation allocation;
+
+	if (ring && ring->allocate(rangeSize, ring->getTextureBufferAlignment(), allocation)) {
+
+		if (size > 0)
+			memcpy(allocation.data, data, size);
+
+		glTexBufferRange(GL_TEXTURE_BUFFER, format, ring->getBuffer(), allocation.offset, rangeSize);
+		return;
+	}
+
+	uploadBuffer(buffer, size, data, minSize);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+
+ClusteredLights::ClusteredLights(DynamicRingBuffer* ring) {
+
+	this->ring = ring;
+
+	glGenBuffers(1, &clusterBlockBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, clusterBlockBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterBlock), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glGenBuffers(1, &clusterBuffer);
+	glGenBuffers(1, &lightIndexBuffer);
+	glGenBuffers(1, &pointLightBuffer);
+
+	// Storage must exist before the textures are created
+	uploadBuffer(clusterBuffer, 0, nullptr, numClusters * 2 * sizeof(GLuint));
+	uploadBuffer(lightIndexBuffer, 0, nullptr, sizeof(GLushort));
+	uploadBuffer(pointLightBuffer, 0, nullptr, sizeof(PointLightData));
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	clusterTexture = createBufferTexture(clusterBuffer, GL_RG32UI);
+	lightIndexTexture = createBufferTexture(lightIndexBuffer, GL_R16UI);
+	pointLightTexture = createBufferTexture(pointLightBuffer, GL_RGBA32F);
+
+	clusters.resize(numClusters * 2);
+	clusterCounts.resize(numClusters);
+}
+
+
+ClusteredLights::~ClusteredLights() {
+
+	GLuint textures[] = { clusterTexture, lightIndexTexture, pointLightTexture };
+
+	for (GLuint texture : textures)
+		GLStateCache::textureDeleted(texture);
+
+	glDeleteTextures(3, textures);
+
+	glDeleteBuffers(1, &clusterBlockBuffer);
+	glDeleteBuffers(1, &clusterBuffer);
+	glDeleteBuffers(1, &lightIndexBuffer);
+	glDeleteBuffers(1, &pointLightBuffer);
+}
+
+
+void ClusteredLights::update(const vector<PointLight>& lights, const mat4& viewMatrix, const mat4& projectionMatrix, float nearPlane, float farPlane, int viewportWidth, int viewportHeight) {
+
+	auto binStart = chrono::high_resolution_clock::now();
+
+	GLuint numLights = glm::min((GLuint)lights.size(), maxLights);
+
+	// Slice s covers view depths near.(far/near)^(s/gridZ) to near.(far/near)^((s+1)/gridZ)
+	float logDepthRange = logf(farPlane / nearPlane);
+	float sliceScale = (float)gridZ / logDepthRange;
+	float sliceBias = -(float)gridZ * logf(nearPlane) / logDepthRange;
+
+	auto sliceOf = [=](float depth) {
+
+		return (GLuint)glm::clamp((int)floorf(logf(depth) * sliceScale + sliceBias), 0, (int)gridZ - 1);
+	};
+
+	auto sliceDepth = [=](GLuint slice) {
+
+		return nearPlane * expf(logDepthRange * (float)slice / (float)gridZ);
+	};
+
+	// Map an NDC coordinate to a tile (coordinates off screen map to the edge tiles)
+	auto tileOf = [](float ndc, GLuint gridSize) {
+
+		ndc = glm::clamp(ndc, -1.0f, 1.0f);
+		return (GLuint)glm::min((GLuint)((ndc * 0.5f + 0.5f) * (float)gridSize), gridSize - 1);
+	};
+
+	float xScale = projectionMatrix[0][0];
+	float yScale = projectionMatrix[1][1];
+
+	pointLightData.resize(numLights);
+	assignments.clear();
+	fill(clusterCounts.begin(), clusterCounts.end(), 0);
+
+	numLightsBinned = 0;
+
+	for (GLuint i = 0; i < numLights; ++i) {
+
+		const PointLight& light = lights[i];
+		float range = light.range();
+
+		pointLightData[i].positionRadius = vec4(light.pos, range);
+		pointLightData[i].colour = vec4(light.colour, 1.0f);
+		pointLightData[i].attenuation = vec4(light.attenuation, 0.0f);
+
+		// View space centre - depth is along -z
+		vec3 centre = vec3(viewMatrix * vec4(light.pos, 1.0f));
+		float depth = -centre.z;
+
+		if (range <= 0.0f || depth + range < nearPlane || depth - range > farPlane)
+			continue;
+
+		float minDepth = glm::max(depth - range, nearPlane);
+		float maxDepth = glm::min(depth + range, farPlane);
+
+		GLuint firstSlice = sliceOf(minDepth);
+		GLuint lastSlice = sliceOf(maxDepth);
+
+		vec2 minXY = vec2(centre) - vec2(range);
+		vec2 maxXY = vec2(centre) + vec2(range);
+
+		bool binned = false;
+
+		for (GLuint slice = firstSlice; slice <= lastSlice; ++slice) {
+
+			// Depths of the light's bounding box within the slice
+			float nearDepth = glm::max(minDepth, sliceDepth(slice));
+			float farDepth = glm::min(maxDepth, sliceDepth(slice + 1));
+
+			if (nearDepth > farDepth)
+				continue;
+
+			// Conservative screen bounds of the box over the slice - an edge projects furthest from the centre at the nearest depth
+			float minX = xScale * minXY.x / ((minXY.x < 0.0f) ? nearDepth : farDepth);
+			float maxX = xScale * maxXY.x / ((maxXY.x > 0.0f) ? nearDepth : farDepth);
+			float minY = yScale * minXY.y / ((minXY.y < 0.0f) ? nearDepth : farDepth);
+			float maxY = yScale * maxXY.y / ((maxXY.y > 0.0f) ? nearDepth : farDepth);
+
+			if (minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f)
+				continue;
+
+			GLuint firstTileX = tileOf(minX, gridX), lastTileX = tileOf(maxX, gridX);
+			GLuint firstTileY = tileOf(minY, gridY), lastTileY = tileOf(maxY, gridY);
+
+			for (GLuint y = firstTileY; y <= lastTileY; ++y) {
+
+				for (GLuint x = firstTileX; x <= lastTileX; ++x) {
+
+					GLuint cluster = (slice * gridY + y) * gridX + x;
+
+					assignments.push_back((cluster << 16) | i);
+					clusterCounts[cluster]++;
+				}
+			}
+
+			binned = true;
+		}
+
+		if (binned)
+			numLightsBinned++;
+	}
+
+	// Each cluster's lights are stored contiguously - offsets from a prefix sum of the counts
+	GLuint offset = 0;
+	maxLightsPerCluster = 0;
+
+	for (GLuint cluster = 0; cluster < numClusters; ++cluster) {
+
+		clusters[cluster * 2] = offset;
+		clusters[cluster * 2 + 1] = 0;
+
+		offset += clusterCounts[cluster];
+		maxLightsPerCluster = glm::max(maxLightsPerCluster, clusterCounts[cluster]);
+	}
+
+	lightIndices.resize(assignments.size());
+
+	for (GLuint assignment : assignments) {
+
+		GLuint cluster = assignment >> 16;
+		GLuint& count = clusters[cluster * 2 + 1];
+
+		lightIndices[clusters[cluster * 2] + count] = (GLushort)(assignment & 0xffff);
+		count++;
+	}
+
+	// Upload
+	ClusterBlock block;
+
+	block.clusterGrid[0] = gridX;
+	block.clusterGrid[1] = gridY;
+	block.clusterGrid[2] = gridZ;
+	block.clusterGrid[3] = 0;
+	block.clusterParams = vec4((float)viewportWidth / (float)gridX, (float)viewportHeight / (float)gridY, sliceScale, sliceBias);
+
+	DynamicRingBuffer::Allocation allocation;
+
+	if (ring && ring->allocate(sizeof(ClusterBlock), ring->getUniformAlignment(), allocation)) {
+
+		memcpy(allocation.data, &block, sizeof(ClusterBlock));
+		clusterBlockOffset = allocation.offset;
+	}
+	else {
+
+		glBindBuffer(GL_UNIFORM_BUFFER, clusterBlockBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ClusterBlock), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		clusterBlockOffset = -1;
+	}
+
+	uploadTexture(ring, clusterTextureUnit, clusterTexture, GL_RG32UI, clusterBuffer, clusters.size() * sizeof(GLuint), clusters.data(), 0);
+	uploadTexture(ring, lightIndexTextureUnit, lightIndexTexture, GL_R16UI, lightIndexBuffer, lightIndices.size() * sizeof(GLushort), lightIndices.data(), sizeof(GLushort));
+	uploadTexture(ring, pointLightTextureUnit, pointLightTexture, GL_RGBA32F, pointLightBuffer, pointLightData.size() * sizeof(PointLightData), pointLightData.data(), sizeof(PointLightData));
+
+	binTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - binStart).count();
+}
+
+
+void ClusteredLights::bind() {
+
+	if (clusterBlockOffset >= 0)
+		glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, ring->getBuffer(), clusterBlockOffset, sizeof(ClusterBlock));
+	else
+		glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, clusterBlockBuffer);
+
+	GLStateCache::bindTextureBuffer(clusterTextureUnit, clusterTexture);
+	GLStateCache::bindTextureBuffer(lightIndexTextureUnit, lightIndexTexture);
+	GLStateCache::bindTextureBuffer(pointLightTextureUnit, pointLightTexture);
+}
+
+
+void ClusteredLights::setupProgram(GLuint program) {
+
+	GLuint blockIndex = glGetUniformBlockIndex(program, "ClusterBlock");
+
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, blockIndex, bindingPoint);
+
+	GLStateCache::useProgram(program);
+
+	glUniform1i(glGetUniformLocation(program, "clusterTexture"), clusterTextureUnit);
+	glUniform1i(glGetUniformLocation(program, "lightIndexTexture"), lightIndexTextureUnit);
+	glUniform1i(glGetUniformLocation(program, "pointLightTexture"), pointLightTextureUnit);
+}
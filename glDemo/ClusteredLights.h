@@ -0,0 +1,97 @@
+#pragma once
+
+#include "core.h"
+#include "Lights.h"
+#include "DynamicRingBuffer.h"
+
+// Clustered light assignment for forward shading with many point lights.  The view frustum is divided into a grid of clusters (froxels) - gridX x gridY screen tiles by gridZ depth slices spaced exponentially between the near and far planes.  Each frame the point lights are binned on the CPU into the clusters their range overlaps, so the fragment shader only evaluates the lights listed for the fragment's cluster.
+// The cluster table, light index lists and light data are stored in buffer textures (GLSL 4.10 has no storage buffers) bound to clusterTextureUnit, lightIndexTextureUnit and pointLightTextureUnit.  The grid parameters are in a small std140 uniform block:
+//   layout (std140) uniform ClusterBlock {
+//       ivec4 clusterGrid; // xyz = clusters in x, y and depth
+//       vec4 clusterParams; // xy = tile size in pixels, zw = depth slice scale and bias (slice = log(viewDepth) * z + w)
+//   };
+// Lights are binned by PointLight::range, so lights with no linear or quadratic falloff reach the far plane.
+// Given a dynamic ring, each frame's results are written into the ring and the textures point at those ranges, otherwise the textures' own buffers are refilled.
+
+class ClusteredLights {
+
+public:
+
+	static const GLuint			gridX = 16;
+	static const GLuint			gridY = 9;
+	static const GLuint			gridZ = 24;
+	static const GLuint			numClusters = gridX * gridY * gridZ;
+
+	static const GLuint			maxLights = 4096; // light indices are 16 bit
+
+	static const GLuint			bindingPoint = 1;
+
+	static const GLuint			clusterTextureUnit = 2;
+	static const GLuint			lightIndexTextureUnit = 3;
+	static const GLuint			pointLightTextureUnit = 4;
+
+private:
+
+	// std140 layout of ClusterBlock
+	struct ClusterBlock {
+
+		GLint					clusterGrid[4];
+		glm::vec4				clusterParams;
+	};
+
+	// Three RGBA32F texels per light
+	struct PointLightData {
+
+		glm::vec4				positionRadius; // view independent - xyz = world position, w = range
+		glm::vec4				colour;
+		glm::vec4				attenuation; // x=constant, y=linear, z=quadratic
+	};
+
+	DynamicRingBuffer*			ring = nullptr;
+
+	GLuint						clusterBlockBuffer = 0;
+	GLintptr					clusterBlockOffset = -1; // of the last update's block in the ring (-1 = in clusterBlockBuffer)
+
+	GLuint						clusterBuffer = 0;
+	GLuint						clusterTexture = 0; // RG32UI - first index and number of lights of each cluster
+
+	GLuint						lightIndexBuffer = 0;
+	GLuint						lightIndexTexture = 0; // R16UI
+
+	GLuint						pointLightBuffer = 0;
+	GLuint						pointLightTexture = 0; // RGBA32F
+
+	// CPU copies rebuilt each update
+	std::vector<PointLightData>	pointLightData;
+	std::vector<GLuint>			clusters; // (first index, count) per cluster
+	std::vector<GLushort>		lightIndices;
+	std::vector<GLuint>			clusterCounts;
+
+	// Clusters each light was binned into - cluster << 16 | light
+	std::vector<GLuint>			assignments;
+
+	// Statistics for the last update
+	GLuint						numLightsBinned = 0;
+	GLuint						maxLightsPerCluster = 0;
+	double						binTime = 0.0; // ms
+
+public:
+
+	ClusteredLights(DynamicRingBuffer* ring = nullptr);
+	~ClusteredLights();
+
+	// Bin lights into the clusters of the view frustum given by the camera matrices and near / far planes, and upload the results.  viewportWidth and viewportHeight are in pixels.  Lights beyond maxLights are ignored
+	void update(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float nearPlane, float farPlane, int viewportWidth, int viewportHeight);
+
+	// Bind ClusterBlock to bindingPoint and the light textures to their units
+	void bind();
+
+	// Bind program's ClusterBlock to bindingPoint and set its light texture samplers
+	static void setupProgram(GLuint program);
+
+	// Statistics for the last update
+	GLuint getNumLightsBinned() const { return numLightsBinned; }
+	GLuint getNumLightIndices() const { return (GLuint)lightIndices.size(); }
+	GLuint getMaxLightsPerCluster() const { return maxLightsPerCluster; }
+	double getBinTime() const { return binTime; }
+};
@@ -0,0 +1,242 @@
+#include "DeferredRenderer.h"
+#include "GLStateCache.h"
+#include "LightBuffer.h"
+#include "CameraBuffer.h"
+#include "shader_setup.h"
+
+using namespace std;
+using namespace glm;
+
+
+// Create a screen sized render target texture
+static GLuint createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height) {
+
+	GLuint texture = 0;
+
+	glGenTextures(1, &texture);
+	GLStateCache::bindTextureForUpdate(texture);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+
+	// Targets are read with texelFetch - one texel per pixel
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	return texture;
+}
+
+
+DeferredRenderer::DeferredRenderer(int width, int height, DynamicRingBuffer* ring) {
+
+	this->ring = ring;
+
+	directionalShader = setupShaders(string("Assets\\Shaders\\deferred-fullscreen.vert"), string("Assets\\Shaders\\deferred-directional.frag"));
+	pointLightShader = setupShaders(string("Assets\\Shaders\\deferred-pointlight.vert"), string("Assets\\Shaders\\deferred-pointlight.frag"));
+
+	pointLightShader_screenSize = glGetUniformLocation(pointLightShader, "screenSize");
+
+	// Sampler units don't change so only need setting once
+	GLStateCache::useProgram(directionalShader);
+	glUniform1i(glGetUniformLocation(directionalShader, "albedoTexture"), albedoTextureUnit);
+	glUniform1i(glGetUniformLocation(directionalShader, "normalTexture"), normalTextureUnit);
+	glUniform1i(glGetUniformLocation(directionalShader, "depthTexture"), depthTextureUnit);
+
+	GLStateCache::useProgram(pointLightShader);
+	glUniform1i(glGetUniformLocation(pointLightShader, "albedoTexture"), albedoTextureUnit);
+	glUniform1i(glGetUniformLocation(pointLightShader, "normalTexture"), normalTextureUnit);
+	glUniform1i(glGetUniformLocation(pointLightShader, "depthTexture"), depthTextureUnit);
+	glUniform1i(glGetUniformLocation(pointLightShader, "pointLightTexture"), pointLightTextureUnit);
+
+	// Directional lights come from the light buffer and the light volumes are placed with the camera buffer's matrices
+	LightBuffer::bindBlock(directionalShader);
+	CameraBuffer::bindBlock(pointLightShader);
+
+	glGenVertexArrays(1, &emptyVAO);
+
+	glGenBuffers(1, &pointLightBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, pointLightBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(PointLightData), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// Bound through the state cache so its buffer texture bindings stay in step with GL
+	glGenTextures(1, &pointLightTexture);
+	GLStateCache::bindTextureBuffer(pointLightTextureUnit, pointLightTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, pointLightBuffer);
+
+	resize(width, height);
+}
+
+
+DeferredRenderer::~DeferredRenderer() {
+
+	deleteTargets();
+
+	glDeleteProgram(directionalShader);
+	glDeleteProgram(pointLightShader);
+
+	GLStateCache::vertexArrayDeleted(emptyVAO);
+	glDeleteVertexArrays(1, &emptyVAO);
+
+	GLStateCache::textureDeleted(pointLightTexture);
+	glDeleteTextures(1, &pointLightTexture);
+	glDeleteBuffers(1, &pointLightBuffer);
+}
+
+
+void DeferredRenderer::createTargets() {
+
+	albedoTexture = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+	normalTexture = createTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+
+	// Same format as the usual default depth buffer so the depth can be blitted after shading
+	depthTexture = createTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+		printf("Deferred renderer: G-buffer incomplete (status 0x%x)\n", status);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+void DeferredRenderer::deleteTargets() {
+
+	if (framebuffer)
+		glDeleteFramebuffers(1, &framebuffer);
+
+	GLuint targets[] = { albedoTexture, normalTexture, depthTexture };
+
+	for (GLuint target : targets) {
+
+		if (target) {
+
+			GLStateCache::textureDeleted(target);
+			glDeleteTextures(1, &target);
+		}
+	}
+
+	framebuffer = albedoTexture = normalTexture = depthTexture = 0;
+}
+
+
+void DeferredRenderer::resize(int width, int height) {
+
+	// Minimised windows have no size
+	width = glm::max(width, 1);
+	height = glm::max(height, 1);
+
+	if (width == this->width && height == this->height)
+		return;
+
+	this->width = width;
+	this->height = height;
+
+	deleteTargets();
+	createTargets();
+}
+
+
+void DeferredRenderer::beginGeometryPass() {
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	// Albedo alpha is 0 where nothing was drawn
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+
+void DeferredRenderer::endGeometryPass() {
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+void DeferredRenderer::shade(const vector<PointLight>& pointLights) {
+
+	GLStateCache::bindTexture(albedoTextureUnit, albedoTexture);
+	GLStateCache::bindTexture(normalTextureUnit, normalTexture);
+	GLStateCache::bindTexture(depthTextureUnit, depthTexture);
+
+	// Light passes cover pixels, not surfaces - no depth testing or writing
+	GLStateCache::setDepthTest(false);
+	GLStateCache::depthMask(false);
+	GLStateCache::bindVertexArray(emptyVAO);
+
+	// Directional lights - one full screen triangle
+	GLStateCache::useProgram(directionalShader);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// Point lights - each light's cube volume is added to the directional result
+	if (!pointLights.empty()) {
+
+		pointLightData.clear();
+
+		for (const PointLight& light : pointLights) {
+
+			float range = light.range();
+
+			if (range <= 0.0f)
+				continue;
+
+			PointLightData data;
+
+			data.positionRange = vec4(light.pos, range);
+			data.colour = vec4(light.colour, 1.0f);
+			data.attenuation = vec4(light.attenuation, 0.0f);
+
+			pointLightData.push_back(data);
+		}
+
+		GLsizeiptr lightDataSize = glm::max(pointLightData.size(), (size_t)1) * sizeof(PointLightData);
+		DynamicRingBuffer::Allocation allocation;
+
+		GLStateCache::bindTextureBuffer(pointLightTextureUnit, pointLightTexture);
+
+		if (ring && ring->allocate(lightDataSize, ring->getTextureBufferAlignment(), allocation)) {
+
+			memcpy(allocation.data, pointLightData.data(), pointLightData.size() * sizeof(PointLightData));
+			glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, ring->getBuffer(), allocation.offset, lightDataSize);
+		}
+		else {
+
+			glBindBuffer(GL_TEXTURE_BUFFER, pointLightBuffer);
+			glBufferData(GL_TEXTURE_BUFFER, lightDataSize, nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, pointLightData.size() * sizeof(PointLightData), pointLightData.data());
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, pointLightBuffer);
+		}
+
+		GLStateCache::useProgram(pointLightShader);
+		glUniform2f(pointLightShader_screenSize, (float)width, (float)height);
+
+		GLStateCache::setBlend(true);
+		GLStateCache::blendFunc(GL_ONE, GL_ONE);
+
+		// The cube faces wind inwards so the faces kept by back face culling are the far side of the volume - it still covers the screen when the camera is inside it
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)pointLightData.size());
+
+		GLStateCache::setBlend(false);
+	}
+
+	GLStateCache::setDepthTest(true);
+	GLStateCache::depthMask(true);
+
+	// Later forward rendering (light markers, transparent surfaces) is depth tested against the scene
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
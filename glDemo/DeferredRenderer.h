@@ -0,0 +1,71 @@
+#pragma once
+
+#include "core.h"
+#include "Lights.h"
+#include "DynamicRingBuffer.h"
+
+// Deferred shading.  The scene is drawn once into a compact G-buffer - RGBA8 albedo, an RG16 octahedral-encoded world normal and 24 bit depth - then lights are applied in screen space: the directional lights in one full screen pass and each point light as a cube volume covering its range, so a light only shades the pixels it can reach.
+// The geometry pass shaders (nmap-gbuffer.frag) are drawn by the caller between beginGeometryPass and endGeometryPass.  The directional lights are read from the LightBlock uniform buffer (see LightBuffer.h), which must be bound when shade is called, along with the frame's CameraBlock (see CameraBuffer.h).
+
+class DeferredRenderer {
+
+public:
+
+	static const GLuint			albedoTextureUnit = 0;
+	static const GLuint			normalTextureUnit = 1;
+	static const GLuint			depthTextureUnit = 2;
+	static const GLuint			pointLightTextureUnit = 3;
+
+private:
+
+	// Three RGBA32F texels per light - the same layout as ClusteredLights
+	struct PointLightData {
+
+		glm::vec4				positionRange;
+		glm::vec4				colour;
+		glm::vec4				attenuation; // x=constant, y=linear, z=quadratic
+	};
+
+	int							width = 0;
+	int							height = 0;
+
+	GLuint						framebuffer = 0;
+	GLuint						albedoTexture = 0;
+	GLuint						normalTexture = 0;
+	GLuint						depthTexture = 0;
+
+	// Light passes
+	GLuint						directionalShader = 0;
+	GLuint						pointLightShader = 0;
+	GLint						pointLightShader_screenSize;
+
+	// Attribute-less draws still need a VAO bound
+	GLuint						emptyVAO = 0;
+
+	DynamicRingBuffer*			ring = nullptr;
+
+	GLuint						pointLightBuffer = 0;
+	GLuint						pointLightTexture = 0;
+	std::vector<PointLightData>	pointLightData;
+
+	void createTargets();
+	void deleteTargets();
+
+public:
+
+	// Point light data is written into ring if one is given
+	DeferredRenderer(int width, int height, DynamicRingBuffer* ring = nullptr);
+	~DeferredRenderer();
+
+	// Recreate the G-buffer for a new window size
+	void resize(int width, int height);
+
+	// Bind and clear the G-buffer
+	void beginGeometryPass();
+
+	// Restore the default framebuffer
+	void endGeometryPass();
+
+	// Light the G-buffer into the default framebuffer (pixels the scene doesn't cover are left as they are), then copy the G-buffer depth so later forward rendering is depth tested against the scene
+	void shade(const std::vector<PointLight>& pointLights);
+};
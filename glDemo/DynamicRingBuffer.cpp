@@ -0,0 +1,137 @@
+#include "DynamicRingBuffer.h"
+#include <chrono>
+
+using namespace std;
+
+
+bool DynamicRingBuffer::isSupported() {
+
+	return (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) && (GLEW_VERSION_4_3 || GLEW_ARB_texture_buffer_range);
+}
+
+
+DynamicRingBuffer::DynamicRingBuffer(GLsizeiptr regionSize) {
+
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &textureBufferAlignment);
+
+	// Keep every region start aligned for any use
+	GLsizeiptr alignment = (GLsizeiptr)glm::max(uniformAlignment, textureBufferAlignment);
+	this->regionSize = (regionSize + alignment - 1) / alignment * alignment;
+
+	for (int i = 0; i < numRegions; ++i)
+		fences[i] = 0;
+
+	// Coherent so writes are visible to the GPU without flushing
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, this->regionSize * numRegions, nullptr, flags);
+
+	mappedData = (GLubyte*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, this->regionSize * numRegions, flags);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (!mappedData)
+		printf("DynamicRingBuffer: could not map %lld bytes\n", (long long)(this->regionSize * numRegions));
+
+	// Start on the last region so the first frame uses region 0
+	region = numRegions - 1;
+	regionOffset = this->regionSize;
+}
+
+
+DynamicRingBuffer::~DynamicRingBuffer() {
+
+	for (int i = 0; i < numRegions; ++i) {
+
+		if (fences[i])
+			glDeleteSync(fences[i]);
+	}
+
+	if (mappedData) {
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	glDeleteBuffers(1, &buffer);
+}
+
+
+void DynamicRingBuffer::beginFrame() {
+
+	region = (region + 1) % numRegions;
+	regionOffset = 0;
+
+	lastFrameBytes = frameBytes;
+	frameBytes = 0;
+	numFrames++;
+
+	GLsync& fence = fences[region];
+
+	if (!fence)
+		return;
+
+	// Poll first so a wait is only counted when the GPU really is behind
+	GLenum result = glClientWaitSync(fence, 0, 0);
+
+	if (result == GL_TIMEOUT_EXPIRED) {
+
+		auto stallStart = chrono::high_resolution_clock::now();
+
+		do {
+
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // 1s
+
+		} while (result == GL_TIMEOUT_EXPIRED);
+
+		numStalls++;
+		stallTime += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - stallStart).count();
+	}
+
+	glDeleteSync(fence);
+	fence = 0;
+}
+
+
+void DynamicRingBuffer::endFrame() {
+
+	GLsync& fence = fences[region];
+
+	if (fence)
+		glDeleteSync(fence);
+
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+bool DynamicRingBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment, Allocation& allocation) {
+
+	GLsizeiptr offset = (regionOffset + alignment - 1) / alignment * alignment;
+
+	if (!mappedData || offset + size > regionSize) {
+
+		numFailedAllocations++;
+		return false;
+	}
+
+	allocation.offset = region * regionSize + offset;
+	allocation.data = mappedData + allocation.offset;
+	allocation.size = size;
+
+	regionOffset = offset + size;
+
+	frameBytes += size;
+	numAllocations++;
+
+	return true;
+}
+
+
+void DynamicRingBuffer::reportStats() {
+
+	printf("DynamicRingBuffer: %u frame(s), %u allocation(s) (%u failed), %lld bytes last frame, %u stall(s) waiting %.2f ms for the GPU\n", numFrames, numAllocations, numFailedAllocations, (long long)lastFrameBytes, numStalls, stallTime);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "core.h"
+
+// Persistently mapped ring for data written by the CPU every frame (camera and light buffers, cluster light lists).  The buffer is split into numRegions regions, one per frame in flight.  Each frame sub-allocates aligned chunks from its region and writes straight into the mapped memory - there is no glBufferData reallocation or glBufferSubData copy, so uploads never synchronise with the GPU.  A fence is placed after each frame's commands and a region is only reused once its fence has signalled.
+// If the CPU gets more than numRegions - 1 frames ahead, beginFrame waits for the GPU - these stalls are counted so they show up in the statistics.  Allocations that don't fit in the rest of the region fail and the caller must fall back to its own buffer.
+// Requires GL 4.4 / ARB_buffer_storage - check isSupported before creating a ring.  Binding ranges of the ring to texture buffers also needs GL 4.3 / ARB_texture_buffer_range.
+
+class DynamicRingBuffer {
+
+public:
+
+	static const int			numRegions = 3;
+
+	struct Allocation {
+
+		void*					data; // mapped memory to write to
+		GLintptr				offset; // from the start of the buffer - used to bind the range
+		GLsizeiptr				size;
+	};
+
+private:
+
+	GLuint						buffer = 0;
+	GLubyte*					mappedData = nullptr;
+
+	GLsizeiptr					regionSize = 0;
+	int							region = 0;
+	GLsizeiptr					regionOffset = 0; // next free byte in the current region
+	GLsync						fences[numRegions];
+
+	// Binding offsets must be multiples of these
+	GLint						uniformAlignment = 256;
+	GLint						textureBufferAlignment = 256;
+
+	// Statistics - the current frame and totals
+	GLsizeiptr					frameBytes = 0;
+	GLsizeiptr					lastFrameBytes = 0;
+	unsigned int				numFrames = 0;
+	unsigned int				numAllocations = 0;
+	unsigned int				numFailedAllocations = 0;
+	unsigned int				numStalls = 0;
+	double						stallTime = 0.0; // ms
+
+public:
+
+	static bool isSupported();
+
+	// regionSize is the most that can be allocated in one frame
+	DynamicRingBuffer(GLsizeiptr regionSize);
+	~DynamicRingBuffer();
+
+	// Move to the next region, waiting for the GPU to finish with it if necessary.  Call before anything is allocated for the frame
+	void beginFrame();
+
+	// Fence the current region.  Call after the frame's last command that reads the ring
+	void endFrame();
+
+	// Sub-allocate size bytes from the current region with the given offset alignment.  Returns false if the region is full
+	bool allocate(GLsizeiptr size, GLsizeiptr alignment, Allocation& allocation);
+
+	GLuint getBuffer() const { return buffer; }
+
+	GLint getUniformAlignment() const { return uniformAlignment; }
+	GLint getTextureBufferAlignment() const { return textureBufferAlignment; }
+
+	// Bytes allocated in the last complete frame
+	GLsizeiptr getLastFrameBytes() const { return lastFrameBytes; }
+
+	// Times beginFrame had to wait for the GPU
+	unsigned int getNumStalls() const { return numStalls; }
+	double getStallTime() const { return stallTime; }
+
+	void reportStats();
+};
@@ -0,0 +1,192 @@
+#include "Frustum.h"
+#include <glm\gtc\matrix_access.hpp>
+#include <emmintrin.h>
+
+using namespace std;
+using namespace glm;
+
+
+void BoxList::clear() {
+
+	centreX.clear();
+	centreY.clear();
+	centreZ.clear();
+
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+
+GLuint BoxList::add(const vec3& centre, const vec3& extent) {
+
+	centreX.push_back(centre.x);
+	centreY.push_back(centre.y);
+	centreZ.push_back(centre.z);
+
+	extentX.push_back(extent.x);
+	extentY.push_back(extent.y);
+	extentZ.push_back(extent.z);
+
+	return size() - 1;
+}
+
+
+GLuint BoxList::add(const mat4& modelTransform, const vec3& boxMin, const vec3& boxMax) {
+
+	vec3 centre = vec3(modelTransform * vec4((boxMin + boxMax) * 0.5f, 1.0f));
+	vec3 extent = (boxMax - boxMin) * 0.5f;
+
+	// Each world axis of the box reaches as far as the absolute values of the transformed object space extents add up to (Arvo)
+	mat3 basis = mat3(modelTransform);
+	vec3 worldExtent = abs(basis[0]) * extent.x + abs(basis[1]) * extent.y + abs(basis[2]) * extent.z;
+
+	return add(centre, worldExtent);
+}
+
+
+Frustum::Frustum() {
+
+	for (int i = 0; i < 6; ++i)
+		planes[i] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+
+Frustum::Frustum(const mat4& viewProjection) {
+
+	// Gribb / Hartmann - each clip plane is the sum or difference of the w row and the x, y or z row of the matrix
+	vec4 rowX = row(viewProjection, 0);
+	vec4 rowY = row(viewProjection, 1);
+	vec4 rowZ = row(viewProjection, 2);
+	vec4 rowW = row(viewProjection, 3);
+
+	planes[Left] = rowW + rowX;
+	planes[Right] = rowW - rowX;
+	planes[Bottom] = rowW + rowY;
+	planes[Top] = rowW - rowY;
+	planes[Near] = rowW + rowZ;
+	planes[Far] = rowW - rowZ;
+
+	// Unit normals so the plane equation gives distances (needed for the sphere and box tests)
+	for (int i = 0; i < 6; ++i)
+		planes[i] /= length(vec3(planes[i]));
+}
+
+
+bool Frustum::intersectsSphere(const vec3& centre, float radius) const {
+
+	for (int i = 0; i < 6; ++i) {
+
+		if (dot(vec3(planes[i]), centre) + planes[i].w < -radius)
+			return false;
+	}
+
+	return true;
+}
+
+
+bool Frustum::intersectsBox(const vec3& centre, const vec3& extent) const {
+
+	for (int i = 0; i < 6; ++i) {
+
+		vec3 normal = vec3(planes[i]);
+
+		// Distance the box reaches along the plane normal
+		float reach = dot(abs(normal), extent);
+
+		if (dot(normal, centre) + planes[i].w < -reach)
+			return false;
+	}
+
+	return true;
+}
+
+
+Frustum::Containment Frustum::classifyBox(const vec3& centre, const vec3& extent, unsigned& planeMask) const {
+
+	for (int i = 0; i < 6; ++i) {
+
+		if (!(planeMask & (1 << i)))
+			continue;
+
+		vec3 normal = vec3(planes[i]);
+
+		float distance = dot(normal, centre) + planes[i].w;
+		float reach = dot(abs(normal), extent);
+
+		if (distance < -reach)
+			return Containment::Outside;
+
+		if (distance >= reach)
+			planeMask &= ~(1 << i);
+	}
+
+	return (planeMask == 0) ? Containment::Inside : Containment::Intersecting;
+}
+
+
+GLuint Frustum::cullBoxes(const BoxList& boxes, uint8_t* visible) const {
+
+	GLuint numBoxes = boxes.size();
+	GLuint numVisible = 0;
+
+	// Plane components splatted across the lanes, with the absolute normal for the box reach
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	__m128 absX[6], absY[6], absZ[6];
+
+	for (int i = 0; i < 6; ++i) {
+
+		planeX[i] = _mm_set1_ps(planes[i].x);
+		planeY[i] = _mm_set1_ps(planes[i].y);
+		planeZ[i] = _mm_set1_ps(planes[i].z);
+		planeW[i] = _mm_set1_ps(planes[i].w);
+
+		absX[i] = _mm_set1_ps(fabsf(planes[i].x));
+		absY[i] = _mm_set1_ps(fabsf(planes[i].y));
+		absZ[i] = _mm_set1_ps(fabsf(planes[i].z));
+	}
+
+	GLuint i = 0;
+
+	for (; i + 4 <= numBoxes; i += 4) {
+
+		__m128 cx = _mm_loadu_ps(&boxes.centreX[i]);
+		__m128 cy = _mm_loadu_ps(&boxes.centreY[i]);
+		__m128 cz = _mm_loadu_ps(&boxes.centreZ[i]);
+
+		__m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+		__m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+		__m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+		// Lanes stay set while the box is in front of (or straddling) every plane so far
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (int p = 0; p < 6; ++p) {
+
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+
+		for (int lane = 0; lane < 4; ++lane) {
+
+			visible[i + lane] = (uint8_t)((mask >> lane) & 1);
+			numVisible += visible[i + lane];
+		}
+	}
+
+	// Remaining boxes one at a time
+	for (; i < numBoxes; ++i) {
+
+		vec3 centre = vec3(boxes.centreX[i], boxes.centreY[i], boxes.centreZ[i]);
+		vec3 extent = vec3(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+
+		visible[i] = intersectsBox(centre, extent) ? 1 : 0;
+		numVisible += visible[i];
+	}
+
+	return numVisible;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "core.h"
+
+// Axis aligned boxes (centre and half size) stored as separate arrays for each component so Frustum::cullBoxes can test four boxes at once
+struct BoxList {
+
+	std::vector<float>		centreX, centreY, centreZ;
+	std::vector<float>		extentX, extentY, extentZ;
+
+	void clear();
+
+	// Add a box and return its index
+	GLuint add(const glm::vec3& centre, const glm::vec3& extent);
+
+	// Add the world space box bounding the object space box [boxMin, boxMax] placed by modelTransform
+	GLuint add(const glm::mat4& modelTransform, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+	GLuint size() const { return (GLuint)centreX.size(); }
+};
+
+
+// The six planes of a view frustum.  Each plane is stored as (normal, distance) with the normal facing into the frustum, so a point p is inside when dot(normal, p) + distance >= 0 for every plane.
+// The tests are conservative - a sphere or box that is outside the frustum but near one of its edges or corners can still be reported as visible.
+
+class Frustum {
+
+	glm::vec4				planes[6];
+
+public:
+
+	enum Plane { Left = 0, Right, Bottom, Top, Near, Far };
+
+	enum class Containment { Outside, Intersecting, Inside };
+
+	// Bit per plane for classifyBox
+	static const unsigned	allPlanes = 0x3f;
+
+	Frustum();
+
+	// Extract the planes of the clip volume of viewProjection (in the space viewProjection transforms from)
+	Frustum(const glm::mat4& viewProjection);
+
+	const glm::vec4& getPlane(Plane plane) const { return planes[plane]; }
+
+	bool intersectsSphere(const glm::vec3& centre, float radius) const;
+	bool intersectsBox(const glm::vec3& centre, const glm::vec3& extent) const;
+
+	// Classify a box against the planes whose bits are set in planeMask.  Planes the box is entirely in front of are cleared from planeMask - a box inside a parent box (such as a bounding volume hierarchy node) only needs testing against the planes left set for the parent
+	Containment classifyBox(const glm::vec3& centre, const glm::vec3& extent, unsigned& planeMask) const;
+
+	// Test every box in boxes (four at a time with SSE).  visible[i] is set to 1 if box i is at least partly inside the frustum and 0 if not.  Returns the number of visible boxes
+	GLuint cullBoxes(const BoxList& boxes, uint8_t* visible) const;
+};
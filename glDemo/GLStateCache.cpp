@@ -0,0 +1,234 @@
+#include "GLStateCache.h"
+
+using namespace std;
+
+
+GLStateCache::CachedState	GLStateCache::program;
+GLStateCache::CachedState	GLStateCache::vertexArray;
+GLStateCache::CachedState	GLStateCache::activeTextureUnit;
+GLStateCache::CachedState	GLStateCache::textures[GLStateCache::maxTextureUnits];
+GLStateCache::CachedState	GLStateCache::bufferTextures[GLStateCache::maxTextureUnits];
+
+GLStateCache::CachedState	GLStateCache::blendEnabled;
+GLStateCache::CachedState	GLStateCache::blendFunction;
+GLStateCache::CachedState	GLStateCache::depthTestEnabled;
+GLStateCache::CachedState	GLStateCache::depthFunction;
+GLStateCache::CachedState	GLStateCache::depthWrite;
+GLStateCache::CachedState	GLStateCache::colourWrite;
+GLStateCache::CachedState	GLStateCache::cullFaceEnabled;
+GLStateCache::CachedState	GLStateCache::cullFaceMode;
+
+unsigned int				GLStateCache::numIssued = 0;
+unsigned int				GLStateCache::numElided = 0;
+unsigned int				GLStateCache::lastFrameIssued = 0;
+unsigned int				GLStateCache::lastFrameElided = 0;
+
+
+bool GLStateCache::update(CachedState& state, uint64_t value) {
+
+	if (state.valid && state.value == value) {
+
+		numElided++;
+		return false;
+	}
+
+	state.value = value;
+	state.valid = true;
+
+	numIssued++;
+
+	return true;
+}
+
+
+void GLStateCache::setCapability(CachedState& state, GLenum capability, bool enable) {
+
+	if (!update(state, enable ? 1 : 0))
+		return;
+
+	if (enable)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+
+void GLStateCache::useProgram(GLuint program) {
+
+	if (update(GLStateCache::program, program))
+		glUseProgram(program);
+}
+
+
+void GLStateCache::bindVertexArray(GLuint vertexArray) {
+
+	if (update(GLStateCache::vertexArray, vertexArray))
+		glBindVertexArray(vertexArray);
+}
+
+
+void GLStateCache::bindTexture(GLuint unit, GLuint texture) {
+
+	assert(unit < maxTextureUnits);
+
+	// Only change the active unit if the binding needs to change
+	if (textures[unit].valid && textures[unit].value == texture) {
+
+		numElided++;
+		return;
+	}
+
+	if (update(activeTextureUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+
+	update(textures[unit], texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+
+void GLStateCache::bindTextureBuffer(GLuint unit, GLuint texture) {
+
+	assert(unit < maxTextureUnits);
+
+	if (bufferTextures[unit].valid && bufferTextures[unit].value == texture) {
+
+		numElided++;
+		return;
+	}
+
+	if (update(activeTextureUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+
+	update(bufferTextures[unit], texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+}
+
+
+void GLStateCache::bindTextureForUpdate(GLuint texture) {
+
+	if (update(activeTextureUnit, 0))
+		glActiveTexture(GL_TEXTURE0);
+
+	if (update(textures[0], texture))
+		glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+
+void GLStateCache::setBlend(bool enable) {
+
+	setCapability(blendEnabled, GL_BLEND, enable);
+}
+
+
+void GLStateCache::blendFunc(GLenum sourceFactor, GLenum destFactor) {
+
+	if (update(blendFunction, ((uint64_t)sourceFactor << 32) | destFactor))
+		glBlendFunc(sourceFactor, destFactor);
+}
+
+
+void GLStateCache::setDepthTest(bool enable) {
+
+	setCapability(depthTestEnabled, GL_DEPTH_TEST, enable);
+}
+
+
+void GLStateCache::depthFunc(GLenum function) {
+
+	if (update(depthFunction, function))
+		glDepthFunc(function);
+}
+
+
+void GLStateCache::depthMask(bool enable) {
+
+	if (update(depthWrite, enable ? 1 : 0))
+		glDepthMask(enable ? GL_TRUE : GL_FALSE);
+}
+
+
+void GLStateCache::colorMask(bool enable) {
+
+	GLboolean mask = enable ? GL_TRUE : GL_FALSE;
+
+	if (update(colourWrite, enable ? 1 : 0))
+		glColorMask(mask, mask, mask, mask);
+}
+
+
+void GLStateCache::setCullFace(bool enable) {
+
+	setCapability(cullFaceEnabled, GL_CULL_FACE, enable);
+}
+
+
+void GLStateCache::cullFace(GLenum mode) {
+
+	if (update(cullFaceMode, mode))
+		glCullFace(mode);
+}
+
+
+void GLStateCache::textureDeleted(GLuint texture) {
+
+	for (GLuint i = 0; i < maxTextureUnits; ++i) {
+
+		if (textures[i].valid && textures[i].value == texture)
+			textures[i].value = 0;
+
+		if (bufferTextures[i].valid && bufferTextures[i].value == texture)
+			bufferTextures[i].value = 0;
+	}
+}
+
+
+void GLStateCache::vertexArrayDeleted(GLuint vertexArray) {
+
+	if (GLStateCache::vertexArray.valid && GLStateCache::vertexArray.value == vertexArray)
+		GLStateCache::vertexArray.value = 0;
+}
+
+
+void GLStateCache::invalidate() {
+
+	program.valid = false;
+	vertexArray.valid = false;
+	activeTextureUnit.valid = false;
+
+	for (GLuint i = 0; i < maxTextureUnits; ++i) {
+
+		textures[i].valid = false;
+		bufferTextures[i].valid = false;
+	}
+
+	blendEnabled.valid = false;
+	blendFunction.valid = false;
+	depthTestEnabled.valid = false;
+	depthFunction.valid = false;
+	depthWrite.valid = false;
+	colourWrite.valid = false;
+	cullFaceEnabled.valid = false;
+	cullFaceMode.valid = false;
+}
+
+
+void GLStateCache::beginFrame() {
+
+	lastFrameIssued = numIssued;
+	lastFrameElided = numElided;
+
+	numIssued = 0;
+	numElided = 0;
+}
+
+
+unsigned int GLStateCache::getNumIssued() {
+
+	return lastFrameIssued;
+}
+
+
+unsigned int GLStateCache::getNumElided() {
+
+	return lastFrameElided;
+}
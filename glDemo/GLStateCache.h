@@ -0,0 +1,85 @@
+#pragma once
+
+#include "core.h"
+
+// Shadow copy of the OpenGL state that changes between draws - the current program, VAO, active texture unit, 2D and buffer texture bindings, and blend, depth, colour write and cull state.  Each setter only calls OpenGL if the value differs from the last value set, so callers can set the state a draw needs without checking what is already bound.
+// All state changes of these kinds must go through the cache (on the main thread) or the shadow copy will be out of date - call invalidate after any code that changes them directly.  State starts unknown, so the first call to each setter is always issued.
+// Calls issued and elided are counted per frame.
+
+class GLStateCache {
+
+	struct CachedState {
+
+		uint64_t						value = 0;
+		bool							valid = false;
+	};
+
+	static const GLuint					maxTextureUnits = 32;
+
+	static CachedState					program;
+	static CachedState					vertexArray;
+	static CachedState					activeTextureUnit;
+	static CachedState					textures[maxTextureUnits]; // GL_TEXTURE_2D binding of each unit
+	static CachedState					bufferTextures[maxTextureUnits]; // GL_TEXTURE_BUFFER binding of each unit
+
+	static CachedState					blendEnabled;
+	static CachedState					blendFunction;
+	static CachedState					depthTestEnabled;
+	static CachedState					depthFunction;
+	static CachedState					depthWrite;
+	static CachedState					colourWrite;
+	static CachedState					cullFaceEnabled;
+	static CachedState					cullFaceMode;
+
+	// Statistics - the current frame and the last complete frame
+	static unsigned int					numIssued;
+	static unsigned int					numElided;
+	static unsigned int					lastFrameIssued;
+	static unsigned int					lastFrameElided;
+
+	// Record value in state.  Returns true if the OpenGL call needs to be made
+	static bool update(CachedState& state, uint64_t value);
+
+	static void setCapability(CachedState& state, GLenum capability, bool enable);
+
+public:
+
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vertexArray);
+
+	// Bind a 2D texture to texture unit unit (0 = GL_TEXTURE0) for drawing.  The active texture unit is only changed if the binding changes
+	static void bindTexture(GLuint unit, GLuint texture);
+
+	// Bind a buffer texture to texture unit unit for drawing
+	static void bindTextureBuffer(GLuint unit, GLuint texture);
+
+	// Bind a 2D texture to texture unit 0 and make unit 0 active so glTex* calls apply to texture
+	static void bindTextureForUpdate(GLuint texture);
+
+	static void setBlend(bool enable);
+	static void blendFunc(GLenum sourceFactor, GLenum destFactor);
+
+	static void setDepthTest(bool enable);
+	static void depthFunc(GLenum function);
+	static void depthMask(bool enable);
+
+	// Enable or disable writes to all four colour channels
+	static void colorMask(bool enable);
+
+	static void setCullFace(bool enable);
+	static void cullFace(GLenum mode);
+
+	// Deleting an object unbinds it - these must be called when a texture or VAO is deleted so a new object that reuses the name is not treated as bound
+	static void textureDeleted(GLuint texture);
+	static void vertexArrayDeleted(GLuint vertexArray);
+
+	// Forget all cached state
+	static void invalidate();
+
+	// Start counting calls for a new frame
+	static void beginFrame();
+
+	// Calls issued / elided in the last complete frame
+	static unsigned int getNumIssued();
+	static unsigned int getNumElided();
+};
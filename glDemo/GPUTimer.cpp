@@ -0,0 +1,81 @@
+#include "GPUTimer.h"
+
+using namespace std;
+
+
+GPUTimer::GPUTimer() {
+
+	glGenQueries(numQueries, beginQueries);
+	glGenQueries(numQueries, endQueries);
+
+	for (int i = 0; i < numQueries; ++i)
+		pending[i] = false;
+}
+
+
+GPUTimer::~GPUTimer() {
+
+	glDeleteQueries(numQueries, beginQueries);
+	glDeleteQueries(numQueries, endQueries);
+}
+
+
+void GPUTimer::collect(int query, bool wait) {
+
+	if (!pending[query])
+		return;
+
+	if (!wait) {
+
+		// The end timestamp is written after the begin timestamp
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(endQueries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (!available)
+			return;
+	}
+
+	GLuint64 beginTime = 0, endTime = 0;
+	glGetQueryObjectui64v(beginQueries[query], GL_QUERY_RESULT, &beginTime);
+	glGetQueryObjectui64v(endQueries[query], GL_QUERY_RESULT, &endTime);
+
+	pending[query] = false;
+
+	lastTime = (double)(endTime - beginTime) / 1000000.0;
+	totalTime += lastTime;
+	numSamples++;
+}
+
+
+void GPUTimer::begin() {
+
+	// Collect finished results in the order they were issued (the next query in the ring is the oldest)
+	for (int i = 0; i < numQueries; ++i)
+		collect((nextQuery + i) % numQueries, false);
+
+	// Only waits if every query in the ring is still in flight
+	collect(nextQuery, true);
+
+	glQueryCounter(beginQueries[nextQuery], GL_TIMESTAMP);
+}
+
+
+void GPUTimer::end() {
+
+	glQueryCounter(endQueries[nextQuery], GL_TIMESTAMP);
+
+	pending[nextQuery] = true;
+	nextQuery = (nextQuery + 1) % numQueries;
+}
+
+
+void GPUTimer::reset() {
+
+	// Results already in flight belong to the previous measurement
+	for (int i = 0; i < numQueries; ++i)
+		collect(i, true);
+
+	lastTime = 0.0;
+	totalTime = 0.0;
+	numSamples = 0;
+}
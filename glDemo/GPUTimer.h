@@ -0,0 +1,39 @@
+#pragma once
+
+#include "core.h"
+
+// Measures GPU time between begin and end with a pair of GL_TIMESTAMP queries.  Queries are kept in a small ring and their results are collected a few frames later, so reading the timer never waits for the GPU to catch up.  Timestamps (unlike GL_TIME_ELAPSED queries) can be nested, so a pass can be timed inside the timer for the whole frame.
+
+class GPUTimer {
+
+	static const int		numQueries = 4;
+
+	GLuint					beginQueries[numQueries];
+	GLuint					endQueries[numQueries];
+	bool					pending[numQueries];
+	int						nextQuery = 0;
+
+	double					lastTime = 0.0; // ms
+	double					totalTime = 0.0;
+	unsigned int			numSamples = 0;
+
+	void collect(int query, bool wait);
+
+public:
+
+	GPUTimer();
+	~GPUTimer();
+
+	void begin();
+	void end();
+
+	// Most recent result (ms)
+	double getLastTime() const { return lastTime; }
+
+	// Average of the results collected since the last reset (ms)
+	double getAverageTime() const { return (numSamples > 0) ? totalTime / (double)numSamples : 0.0; }
+	unsigned int getNumSamples() const { return numSamples; }
+
+	// Discard collected results.  Queries still in flight are not counted
+	void reset();
+};
@@ -0,0 +1,299 @@
+#include "GeometryArena.h"
+#include "GLStateCache.h"
+
+using namespace std;
+using namespace glm;
+
+
+// ArenaFreeList
+
+void ArenaFreeList::reset(GLuint capacity) {
+
+	freeRanges.clear();
+
+	this->capacity = capacity;
+	used = 0;
+
+	if (capacity > 0)
+		freeRanges[0] = capacity;
+}
+
+
+void ArenaFreeList::grow(GLuint newCapacity) {
+
+	if (newCapacity <= capacity)
+		return;
+
+	GLuint oldCapacity = capacity;
+	capacity = newCapacity;
+
+	// Release the new space through free so it merges with a free range at the old end
+	used += newCapacity - oldCapacity;
+	free(oldCapacity, newCapacity - oldCapacity);
+}
+
+
+bool ArenaFreeList::allocate(GLuint size, GLuint& offset) {
+
+	if (size == 0)
+		return false;
+
+	// First fit
+	for (auto i = freeRanges.begin(); i != freeRanges.end(); ++i) {
+
+		if (i->second >= size) {
+
+			offset = i->first;
+
+			GLuint remaining = i->second - size;
+
+			freeRanges.erase(i);
+
+			if (remaining > 0)
+				freeRanges[offset + size] = remaining;
+
+			used += size;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void ArenaFreeList::free(GLuint offset, GLuint size) {
+
+	if (size == 0)
+		return;
+
+	used -= size;
+
+	auto next = freeRanges.lower_bound(offset);
+
+	// Merge with the following free range
+	if (next != freeRanges.end() && offset + size == next->first) {
+
+		size += next->second;
+		next = freeRanges.erase(next);
+	}
+
+	// Merge with the preceding free range
+	if (next != freeRanges.begin()) {
+
+		auto prev = std::prev(next);
+
+		if (prev->first + prev->second == offset) {
+
+			prev->second += size;
+			return;
+		}
+	}
+
+	freeRanges[offset] = size;
+}
+
+
+GLuint ArenaFreeList::largestFreeRange() const {
+
+	GLuint largest = 0;
+
+	for (auto i = freeRanges.begin(); i != freeRanges.end(); ++i)
+		largest = glm::max(largest, i->second);
+
+	return largest;
+}
+
+
+// GeometryArena
+
+GeometryArena::GeometryArena(GLuint initialVertexCapacity, GLuint initialIndexCapacity) {
+
+	vertexSpace.reset(initialVertexCapacity);
+	indexSpace.reset(initialIndexCapacity);
+
+	glGenVertexArrays(1, &vao);
+	GLStateCache::bindVertexArray(vao);
+
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)initialVertexCapacity * sizeof(PackedVertex), nullptr, GL_STATIC_DRAW);
+
+	// The element buffer binding is part of the VAO state
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)initialIndexCapacity * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+
+	setupVertexAttributes();
+
+	GLStateCache::bindVertexArray(0);
+}
+
+
+GeometryArena::~GeometryArena() {
+
+	glDeleteVertexArrays(1, &vao);
+	GLStateCache::vertexArrayDeleted(vao);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+}
+
+
+// Same layout as AIMesh's packed vertex buffer - see AIMesh::setupPackedVertexBuffer
+void GeometryArena::setupVertexAttributes() {
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+	const GLsizei stride = sizeof(PackedVertex);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(PackedVertex, position));
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const GLvoid*)offsetof(PackedVertex, normal));
+	glEnableVertexAttribArray(3);
+
+	glVertexAttribPointer(4, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const GLvoid*)offsetof(PackedVertex, tangent));
+	glEnableVertexAttribArray(4);
+
+	// Meshes without texture coordinates have zero uvs in the packed vertex so the attribute can always be enabled
+	glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(PackedVertex, texCoord));
+	glEnableVertexAttribArray(2);
+
+	// No bitangent stream - the vertex shader reconstructs it from the normal and the tangent's w sign
+}
+
+
+GLuint GeometryArena::growBuffer(GLuint buffer, GLsizeiptr oldSize, GLsizeiptr newSize) {
+
+	GLuint newBuffer = 0;
+
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, &buffer);
+
+	return newBuffer;
+}
+
+
+void GeometryArena::growVertexBuffer(GLuint minVertices) {
+
+	GLuint oldCapacity = vertexSpace.getCapacity();
+	GLuint newCapacity = glm::max(oldCapacity * 2, oldCapacity + minVertices);
+
+	vertexBuffer = growBuffer(vertexBuffer, (GLsizeiptr)oldCapacity * sizeof(PackedVertex), (GLsizeiptr)newCapacity * sizeof(PackedVertex));
+	vertexSpace.grow(newCapacity);
+
+	// Point the VAO's attributes at the new buffer
+	GLStateCache::bindVertexArray(vao);
+	setupVertexAttributes();
+	GLStateCache::bindVertexArray(0);
+
+	cout << "Geometry arena: vertex buffer grown to " << newCapacity << " vertices\n";
+}
+
+
+void GeometryArena::growIndexBuffer(GLuint minIndices) {
+
+	GLuint oldCapacity = indexSpace.getCapacity();
+	GLuint newCapacity = glm::max(oldCapacity * 2, oldCapacity + minIndices);
+
+	indexBuffer = growBuffer(indexBuffer, (GLsizeiptr)oldCapacity * sizeof(GLuint), (GLsizeiptr)newCapacity * sizeof(GLuint));
+	indexSpace.grow(newCapacity);
+
+	GLStateCache::bindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	GLStateCache::bindVertexArray(0);
+
+	cout << "Geometry arena: index buffer grown to " << newCapacity << " indices\n";
+}
+
+
+GeometryAllocation GeometryArena::allocate(GLuint numVertices, GLuint numIndices) {
+
+	GeometryAllocation allocation;
+
+	if (numVertices == 0 || numIndices == 0)
+		return allocation;
+
+	GLuint vertexOffset = 0;
+	GLuint indexOffset = 0;
+
+	if (!vertexSpace.allocate(numVertices, vertexOffset)) {
+
+		growVertexBuffer(numVertices);
+		vertexSpace.allocate(numVertices, vertexOffset);
+	}
+
+	if (!indexSpace.allocate(numIndices, indexOffset)) {
+
+		growIndexBuffer(numIndices);
+		indexSpace.allocate(numIndices, indexOffset);
+	}
+
+	allocation.baseVertex = (GLint)vertexOffset;
+	allocation.numVertices = numVertices;
+	allocation.firstIndex = indexOffset;
+	allocation.numIndices = numIndices;
+
+	return allocation;
+}
+
+
+void GeometryArena::upload(const GeometryAllocation& allocation, const PackedVertex* vertices, const GLuint* indices) {
+
+	if (!allocation.valid())
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)allocation.baseVertex * sizeof(PackedVertex), (GLsizeiptr)allocation.numVertices * sizeof(PackedVertex), vertices);
+
+	// Use the copy target for the indices so the element buffer binding of whichever VAO is bound is not changed
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.firstIndex * sizeof(GLuint), (GLsizeiptr)allocation.numIndices * sizeof(GLuint), indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+void GeometryArena::free(GeometryAllocation& allocation) {
+
+	if (!allocation.valid())
+		return;
+
+	vertexSpace.free((GLuint)allocation.baseVertex, allocation.numVertices);
+	indexSpace.free(allocation.firstIndex, allocation.numIndices);
+
+	allocation = GeometryAllocation();
+}
+
+
+void GeometryArena::bind() {
+
+	GLStateCache::bindVertexArray(vao);
+}
+
+
+void GeometryArena::draw(const GeometryAllocation& allocation, GLuint firstIndex, GLuint numIndices) {
+
+	glDrawElementsBaseVertex(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, (GLvoid*)((GLintptr)(allocation.firstIndex + firstIndex) * sizeof(GLuint)), allocation.baseVertex);
+}
+
+
+void GeometryArena::drawInstanced(const GeometryAllocation& allocation, GLuint firstIndex, GLuint numIndices, GLuint numInstances, GLuint baseInstance) {
+
+	glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, (const GLvoid*)((GLintptr)(allocation.firstIndex + firstIndex) * sizeof(GLuint)), numInstances, allocation.baseVertex, baseInstance);
+}
+
+
+void GeometryArena::reportUsage() {
+
+	printf("Geometry arena: %u / %u vertices (%u free ranges, largest %u), %u / %u indices (%u free ranges, largest %u)\n",
+		vertexSpace.getUsed(), vertexSpace.getCapacity(), vertexSpace.numFreeRanges(), vertexSpace.largestFreeRange(),
+		indexSpace.getUsed(), indexSpace.getCapacity(), indexSpace.numFreeRanges(), indexSpace.largestFreeRange());
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "core.h"
+#include "MeshData.h"
+
+// Shared vertex / index storage for meshes in the packed vertex format.  All meshes allocated from an arena live in one vertex buffer and one index buffer described by a single VAO, so switching between meshes needs no buffer or VAO binds - each mesh is drawn as a (baseVertex, firstIndex, count) range with glDrawElementsBaseVertex.  Indices are stored relative to each mesh's first vertex.
+// Space is managed with a first-fit free-list per buffer.  Freed ranges are merged with their neighbours and the buffers grow (doubling, contents copied on the GPU) when an allocation does not fit.
+
+// First-fit free-list of the elements of one of the arena's buffers
+class ArenaFreeList {
+
+	// Free ranges keyed by offset (offset -> size)
+	std::map<GLuint, GLuint> freeRanges;
+
+	GLuint					capacity = 0;
+	GLuint					used = 0;
+
+public:
+
+	void reset(GLuint capacity);
+
+	// Add newCapacity - capacity elements of free space to the end of the range
+	void grow(GLuint newCapacity);
+
+	// Allocate size elements.  Returns false if no free range is large enough
+	bool allocate(GLuint size, GLuint& offset);
+
+	void free(GLuint offset, GLuint size);
+
+	GLuint getCapacity() const { return capacity; }
+	GLuint getUsed() const { return used; }
+	GLuint numFreeRanges() const { return (GLuint)freeRanges.size(); }
+	GLuint largestFreeRange() const;
+};
+
+
+// A mesh's sub-allocation in the arena - a contiguous range of elements in each of the arena's buffers
+struct GeometryAllocation {
+
+	GLint					baseVertex = 0;
+	GLuint					numVertices = 0;
+
+	GLuint					firstIndex = 0;
+	GLuint					numIndices = 0;
+
+	bool valid() const { return numVertices > 0; }
+};
+
+
+class GeometryArena {
+
+	GLuint					vao = 0;
+	GLuint					vertexBuffer = 0;
+	GLuint					indexBuffer = 0;
+
+	ArenaFreeList			vertexSpace; // in PackedVertex elements
+	ArenaFreeList			indexSpace; // in GLuint indices
+
+	// Setup the attribute bindings of the VAO for the current vertex buffer
+	void setupVertexAttributes();
+
+	// Reallocate a buffer with a larger capacity, copying the existing contents
+	static GLuint growBuffer(GLuint buffer, GLsizeiptr oldSize, GLsizeiptr newSize);
+
+	void growVertexBuffer(GLuint minVertices);
+	void growIndexBuffer(GLuint minIndices);
+
+public:
+
+	GeometryArena(GLuint initialVertexCapacity, GLuint initialIndexCapacity);
+	~GeometryArena();
+
+	// Allocate space for numVertices vertices and numIndices indices, growing the arena if needed
+	GeometryAllocation allocate(GLuint numVertices, GLuint numIndices);
+
+	// Copy vertex and index data into an allocation.  The indices are relative to the allocation's first vertex
+	void upload(const GeometryAllocation& allocation, const PackedVertex* vertices, const GLuint* indices);
+
+	void free(GeometryAllocation& allocation);
+
+	// Bind the arena's VAO.  This must be done before drawing any mesh allocated from the arena
+	void bind();
+
+	GLuint getVAO() const { return vao; }
+
+	// Draw numIndices indices starting firstIndex indices into an allocation
+	void draw(const GeometryAllocation& allocation, GLuint firstIndex, GLuint numIndices);
+
+	// Draw numInstances instances of a range of an allocation.  Instanced attributes start at baseInstance
+	void drawInstanced(const GeometryAllocation& allocation, GLuint firstIndex, GLuint numIndices, GLuint numInstances, GLuint baseInstance);
+
+	void reportUsage();
+};
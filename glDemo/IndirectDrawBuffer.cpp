@@ -0,0 +1,74 @@
+#include "IndirectDrawBuffer.h"
+
+using namespace std;
+
+
+bool IndirectDrawBuffer::isSupported() {
+
+	return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+}
+
+
+IndirectDrawBuffer::IndirectDrawBuffer() {
+
+	glGenBuffers(1, &buffer);
+}
+
+
+IndirectDrawBuffer::~IndirectDrawBuffer() {
+
+	glDeleteBuffers(1, &buffer);
+}
+
+
+GLuint IndirectDrawBuffer::addCommands(GLuint numCommands) {
+
+	GLuint firstCommand = (GLuint)commands.size();
+
+	commands.resize(commands.size() + numCommands);
+	dirty = true;
+
+	return firstCommand;
+}
+
+
+void IndirectDrawBuffer::setCommand(GLuint index, const DrawElementsIndirectCommand& command) {
+
+	DrawElementsIndirectCommand& current = commands[index];
+
+	if (memcmp(&current, &command, sizeof(DrawElementsIndirectCommand)) != 0) {
+
+		current = command;
+		dirty = true;
+	}
+}
+
+
+void IndirectDrawBuffer::upload() {
+
+	if (!dirty)
+		return;
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+
+	GLsizeiptr numCommands = (GLsizeiptr)commands.size();
+
+	if (numCommands > bufferCapacity) {
+
+		bufferCapacity = glm::max(numCommands, bufferCapacity * 2);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, bufferCapacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	if (numCommands > 0)
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, numCommands * sizeof(DrawElementsIndirectCommand), commands.data());
+
+	dirty = false;
+	numUploads++;
+}
+
+
+void IndirectDrawBuffer::draw(GLuint firstCommand, GLuint numCommands) {
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*)((GLintptr)firstCommand * sizeof(DrawElementsIndirectCommand)), numCommands, 0);
+}
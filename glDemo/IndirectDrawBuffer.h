@@ -0,0 +1,53 @@
+#pragma once
+
+#include "core.h"
+
+// Layout of one command in a GL_DRAW_INDIRECT_BUFFER for glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+
+	GLuint					count = 0;
+	GLuint					instanceCount = 0;
+	GLuint					firstIndex = 0;
+	GLint					baseVertex = 0;
+	GLuint					baseInstance = 0;
+};
+
+// Draw commands for multi-draw indirect submission.  Each multi-mesh model reserves a contiguous range of commands (enough for one per placement of each sub-mesh - consecutive placements at the same level of detail share a command) and all of its sub-meshes are drawn with a single glMultiDrawElementsIndirect call.  The meshes must share a VAO (ie. be allocated from a geometry arena).  Per-draw data (the model transforms) is fetched through each command's base instance from the instance buffer.
+// Commands are kept on the CPU and only re-uploaded when one changes (eg. a sub-mesh switches LOD).  Requires GL 4.3 / ARB_multi_draw_indirect - check isSupported before creating an indirect draw buffer.
+
+class IndirectDrawBuffer {
+
+	GLuint					buffer = 0;
+	GLsizeiptr				bufferCapacity = 0; // in commands
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	bool					dirty = false;
+
+	// Statistics
+	unsigned int			numUploads = 0;
+
+public:
+
+	static bool isSupported();
+
+	IndirectDrawBuffer();
+	~IndirectDrawBuffer();
+
+	// Reserve numCommands commands.  Returns the index of the first one
+	GLuint addCommands(GLuint numCommands);
+
+	// Set a command (only marks the buffer for upload if it has changed)
+	void setCommand(GLuint index, const DrawElementsIndirectCommand& command);
+
+	// Copy the commands to the GPU if any have changed since the last upload
+	void upload();
+
+	// Draw numCommands commands starting at firstCommand with the current program and VAO
+	void draw(GLuint firstCommand, GLuint numCommands);
+
+	// The GL buffer - commands can also be written on the GPU (eg. by a compute shader) once upload has allocated it.  Commands written this way are overwritten by the next upload that has CPU changes to copy
+	GLuint getBuffer() const { return buffer; }
+
+	GLuint getNumCommands() const { return (GLuint)commands.size(); }
+	unsigned int getNumUploads() const { return numUploads; }
+};
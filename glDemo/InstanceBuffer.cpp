@@ -0,0 +1,112 @@
+#include "InstanceBuffer.h"
+#include "GLStateCache.h"
+#include "NormalMatrices.h"
+
+using namespace std;
+using namespace glm;
+
+
+bool InstanceBuffer::isSupported() {
+
+	return GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
+}
+
+
+InstanceBuffer::InstanceBuffer() {
+
+	glGenBuffers(1, &buffer);
+	glGenBuffers(1, &normalBuffer);
+}
+
+
+InstanceBuffer::~InstanceBuffer() {
+
+	glDeleteBuffers(1, &buffer);
+	glDeleteBuffers(1, &normalBuffer);
+}
+
+
+void InstanceBuffer::clear() {
+
+	transforms.clear();
+	normalMatrices.clear();
+	dirty = true;
+}
+
+
+GLuint InstanceBuffer::add(const mat4* modelTransforms, GLuint numInstances) {
+
+	GLuint firstInstance = (GLuint)transforms.size();
+
+	transforms.insert(transforms.end(), modelTransforms, modelTransforms + numInstances);
+
+	normalMatrices.resize(transforms.size());
+	computeNormalMatrices(modelTransforms, &normalMatrices[firstInstance], numInstances);
+	dirty = true;
+
+	return firstInstance;
+}
+
+
+void InstanceBuffer::upload() {
+
+	if (!dirty)
+		return;
+
+	GLsizeiptr numTransforms = (GLsizeiptr)transforms.size();
+
+	// Reallocate if the transforms don't fit (the attached VAOs reference the buffer objects so don't need updating)
+	if (numTransforms > bufferCapacity) {
+
+		bufferCapacity = glm::max(numTransforms, bufferCapacity * 2);
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, bufferCapacity * sizeof(mat4), nullptr, GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+		glBufferData(GL_ARRAY_BUFFER, bufferCapacity * sizeof(mat3), nullptr, GL_STATIC_DRAW);
+	}
+
+	if (numTransforms > 0) {
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, numTransforms * sizeof(mat4), transforms.data());
+
+		glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, numTransforms * sizeof(mat3), normalMatrices.data());
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	dirty = false;
+}
+
+
+void InstanceBuffer::attach(GLuint vao) {
+
+	if (vao == 0 || !attachedVAOs.insert(vao).second)
+		return;
+
+	GLStateCache::bindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	// One column of the matrix per attribute, advancing once per instance
+	for (GLuint i = 0; i < 4; ++i) {
+
+		glVertexAttribPointer(attributeLocation + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (const GLvoid*)(sizeof(vec4) * i));
+		glVertexAttribDivisor(attributeLocation + i, 1);
+		glEnableVertexAttribArray(attributeLocation + i);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+
+	for (GLuint i = 0; i < 3; ++i) {
+
+		glVertexAttribPointer(normalAttributeLocation + i, 3, GL_FLOAT, GL_FALSE, sizeof(mat3), (const GLvoid*)(sizeof(vec3) * i));
+		glVertexAttribDivisor(normalAttributeLocation + i, 1);
+		glEnableVertexAttribArray(normalAttributeLocation + i);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLStateCache::bindVertexArray(0);
+}
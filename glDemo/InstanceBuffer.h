@@ -0,0 +1,47 @@
+#pragma once
+
+#include "core.h"
+
+// Per-instance model and normal matrices for instanced drawing.  Each model's transforms are added as a contiguous range and drawn with glDraw*Instanced*BaseInstance calls per sub-mesh - each draws a part of the range (placements at the same level of detail) with the part's first instance passed as the base instance.  The model matrix is read by the vertex shader from attributes 6-9 and the normal matrix (calculated when the transforms are added - see NormalMatrices.h) from attributes 10-12, one column each with an attribute divisor of 1, so the instance buffer must be attached to each VAO that is drawn instanced.
+// Requires GL 4.2 / ARB_base_instance - check isSupported before creating an instance buffer.
+
+class InstanceBuffer {
+
+	GLuint					buffer = 0;
+	GLuint					normalBuffer = 0;
+	GLsizeiptr				bufferCapacity = 0; // in instances
+
+	std::vector<glm::mat4>	transforms;
+	std::vector<glm::mat3>	normalMatrices;
+	bool					dirty = false;
+
+	// VAOs with the instance attributes set up
+	std::set<GLuint>		attachedVAOs;
+
+public:
+
+	// First attribute location of the instance matrix (uses 4 locations)
+	static const GLuint		attributeLocation = 6;
+
+	// First attribute location of the instance normal matrix (uses 3 locations)
+	static const GLuint		normalAttributeLocation = 10;
+
+	static bool isSupported();
+
+	InstanceBuffer();
+	~InstanceBuffer();
+
+	// Remove all instances
+	void clear();
+
+	// Add numInstances transforms and their normal matrices.  Returns the index of the first one (the base instance to draw the range with)
+	GLuint add(const glm::mat4* modelTransforms, GLuint numInstances);
+
+	// Copy the transforms to the GPU if they have changed since the last upload
+	void upload();
+
+	// Point the instance matrix attributes of vao at the buffers.  Only sets up each VAO once
+	void attach(GLuint vao);
+
+	GLuint getNumInstances() const { return (GLuint)transforms.size(); }
+};
@@ -0,0 +1,91 @@
+#include "LightBuffer.h"
+
+using namespace std;
+using namespace glm;
+
+
+LightBuffer::LightBuffer(DynamicRingBuffer* ring) {
+
+	this->ring = ring;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+
+LightBuffer::~LightBuffer() {
+
+	glDeleteBuffers(1, &buffer);
+}
+
+
+void LightBuffer::update(const vector<DirectionalLight>& directionalLights, const vector<PointLight>& pointLights) {
+
+	GLuint numDirectional = glm::min((GLuint)directionalLights.size(), maxDirectionalLights);
+	GLuint numPoint = glm::min((GLuint)pointLights.size(), maxPointLights);
+
+	// Write straight into the ring if there is room, otherwise build the block and copy it into the buffer
+	LightBlock localBlock;
+	LightBlock* blockPtr = &localBlock;
+	DynamicRingBuffer::Allocation allocation;
+
+	ringOffset = -1;
+
+	if (ring && ring->allocate(sizeof(LightBlock), ring->getUniformAlignment(), allocation)) {
+
+		blockPtr = (LightBlock*)allocation.data;
+		ringOffset = allocation.offset;
+	}
+
+	LightBlock& block = *blockPtr;
+
+	block.numLights[0] = (GLint)numDirectional;
+	block.numLights[1] = (GLint)numPoint;
+	block.numLights[2] = 0;
+	block.numLights[3] = 0;
+
+	for (GLuint i = 0; i < numDirectional; ++i) {
+
+		block.directionalLights[i].direction = vec4(normalize(directionalLights[i].direction), 0.0f);
+		block.directionalLights[i].colour = vec4(directionalLights[i].colour, 1.0f);
+	}
+
+	for (GLuint i = 0; i < numPoint; ++i) {
+
+		block.pointLights[i].position = vec4(pointLights[i].pos, 1.0f);
+		block.pointLights[i].colour = vec4(pointLights[i].colour, 1.0f);
+		block.pointLights[i].attenuation = vec4(pointLights[i].attenuation, 0.0f);
+	}
+
+	if (ringOffset >= 0)
+		return;
+
+	// Only upload the lights in use
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, offsetof(LightBlock, directionalLights) + numDirectional * sizeof(DirectionalLightData), &block);
+
+	if (numPoint > 0)
+		glBufferSubData(GL_UNIFORM_BUFFER, offsetof(LightBlock, pointLights), numPoint * sizeof(PointLightData), block.pointLights);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+
+void LightBuffer::bind() {
+
+	if (ringOffset >= 0)
+		glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, ring->getBuffer(), ringOffset, sizeof(LightBlock));
+	else
+		glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
+}
+
+
+void LightBuffer::bindBlock(GLuint program) {
+
+	GLuint blockIndex = glGetUniformBlockIndex(program, "LightBlock");
+
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, blockIndex, bindingPoint);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "core.h"
+#include "Lights.h"
+#include "DynamicRingBuffer.h"
+
+// Uniform buffer holding the scene's directional and point lights for shaders that shade every light in one pass.  Shaders declare the matching std140 block:
+//   layout (std140) uniform LightBlock {
+//       ivec4 numLights; // x = directional lights, y = point lights
+//       DirectionalLightData directionalLights[MAX_DIRECTIONAL_LIGHTS];
+//       PointLightData pointLights[MAX_POINT_LIGHTS];
+//   };
+// GLSL 4.10 has no binding qualifier so each program's block is bound to bindingPoint with bindBlock.
+// Given a dynamic ring, each update writes a new copy of the block into the ring instead of updating the buffer in place, so the buffer can be updated between draws (eg. once per light pass) without waiting for earlier draws to read it.
+
+class LightBuffer {
+
+	// std140 layouts - every member is a vec4
+	struct DirectionalLightData {
+
+		glm::vec4				direction; // towards the light
+		glm::vec4				colour;
+	};
+
+	struct PointLightData {
+
+		glm::vec4				position;
+		glm::vec4				colour;
+		glm::vec4				attenuation; // x=constant, y=linear, z=quadratic
+	};
+
+public:
+
+	static const GLuint			bindingPoint = 0;
+
+	static const GLuint			maxDirectionalLights = 16;
+	static const GLuint			maxPointLights = 64;
+
+private:
+
+	struct LightBlock {
+
+		GLint					numLights[4];
+		DirectionalLightData	directionalLights[maxDirectionalLights];
+		PointLightData			pointLights[maxPointLights];
+	};
+
+	GLuint						buffer = 0;
+
+	DynamicRingBuffer*			ring = nullptr;
+	GLintptr					ringOffset = -1; // of the last update's block in the ring (-1 = in buffer)
+
+public:
+
+	LightBuffer(DynamicRingBuffer* ring = nullptr);
+	~LightBuffer();
+
+	// Copy the lights into the buffer.  Lights beyond the maximums are ignored
+	void update(const std::vector<DirectionalLight>& directionalLights, const std::vector<PointLight>& pointLights);
+
+	// Bind the last update's block to bindingPoint
+	void bind();
+
+	// Bind program's LightBlock (if it has one) to bindingPoint
+	static void bindBlock(GLuint program);
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "core.h"
+#include <limits>
+
+// Light source descriptions shared by the forward and deferred lighting paths
+
+struct DirectionalLight {
+
+	glm::vec3 direction;
+	glm::vec3 colour;
+	
+	DirectionalLight() {
+
+		direction = glm::vec3(0.0f, 1.0f, 0.0f); // default to point upwards
+		colour = glm::vec3(1.0f, 1.0f, 1.0f);
+	}
+
+	DirectionalLight(glm::vec3 direction, glm::vec3 colour = glm::vec3(1.0f, 1.0f, 1.0f)) {
+
+		this->direction = direction;
+		this->colour = colour;
+	}
+};
+
+struct PointLight {
+
+	glm::vec3 pos;
+	glm::vec3 colour;
+	glm::vec3 attenuation; // x=constant, y=linear, z=quadratic
+
+	PointLight() {
+
+		pos = glm::vec3(0.0f, 0.0f, 0.0f);
+		colour = glm::vec3(1.0f, 1.0f, 1.0f);
+		attenuation = glm::vec3(1.0f, 1.0f, 1.0f);
+	}
+
+	PointLight(glm::vec3 pos, glm::vec3 colour = glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3 attenuation = glm::vec3(1.0f, 1.0f, 1.0f)) {
+
+		this->pos = pos;
+		this->colour = colour;
+		this->attenuation = attenuation;
+	}
+
+	// Distance at which the attenuated intensity falls to 1/256 of the light's colour - lights with no linear or quadratic falloff never fade out
+	float range() const {
+
+		// Solve colour / (kc + kl.d + kq.d^2) = colour / 256
+		float brightest = glm::max(colour.r, glm::max(colour.g, colour.b));
+		float c = attenuation.x - brightest * 256.0f;
+
+		if (c >= 0.0f)
+			return 0.0f; // never bright enough to be seen
+
+		float kl = attenuation.y;
+		float kq = attenuation.z;
+
+		if (kq > 0.0f)
+			return (-kl + sqrtf(kl * kl - 4.0f * kq * c)) / (2.0f * kq);
+
+		if (kl > 0.0f)
+			return -c / kl;
+
+		return std::numeric_limits<float>::max();
+	}
+};
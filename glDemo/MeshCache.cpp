@@ -0,0 +1,403 @@
+#include "MeshCache.h"
+
+using namespace std;
+
+
+#pragma region Cache file layout
+
+// Bump meshCacheVersion whenever the layout or the processing applied to cached meshes changes
+static const uint32_t meshCacheMagic = 0x4853434D; // 'MCSH'
+static const uint32_t meshCacheVersion = 4;
+
+// File header - followed by numMeshes MeshCacheEntry records
+struct MeshCacheHeader {
+
+	uint32_t		magic;
+	uint32_t		version;
+	uint32_t		importFlags;
+	uint32_t		numMeshes;
+	uint32_t		optimizeFlags;
+	uint32_t		reserved;
+
+	uint64_t		sourceSize;
+	int64_t			sourceModTime;
+	uint64_t		sourceHash;
+};
+
+// Per-mesh record.  dataOffset (from the start of the file) points to the mesh's streams stored back-to-back: positions, normals, tangents, bitangents, texCoords (if present), the index array (all levels of detail) then the MeshLOD table
+struct MeshCacheEntry {
+
+	uint32_t		numVertices;
+	uint32_t		numIndices;
+	uint32_t		hasTexCoords;
+	uint32_t		numLODs;
+
+	uint64_t		dataOffset;
+};
+
+static uint64_t meshDataSize(const MeshCacheEntry& entry) {
+
+	const uint64_t numStreams = entry.hasTexCoords ? 5 : 4;
+
+	return numStreams * entry.numVertices * sizeof(aiVector3D) + (uint64_t)entry.numIndices * sizeof(GLuint) + (uint64_t)entry.numLODs * sizeof(MeshLOD);
+}
+
+#pragma endregion
+
+
+#pragma region Source file identification
+
+struct SourceFileInfo {
+
+	uint64_t		size = 0;
+	int64_t			modTime = 0;
+};
+
+static bool getSourceFileInfo(const string& sourceFile, SourceFileInfo* info) {
+
+	struct stat fileStatus;
+
+	if (stat(sourceFile.c_str(), &fileStatus) != 0)
+		return false;
+
+	info->size = (uint64_t)fileStatus.st_size;
+	info->modTime = (int64_t)fileStatus.st_mtime;
+
+	return true;
+}
+
+// 64 bit FNV-1a hash of the source file contents.  This is only calculated when a cache is written or when the source timestamp has changed
+static uint64_t hashSourceFile(const string& sourceFile) {
+
+	uint64_t hash = 14695981039346656037ull;
+
+	ifstream file(sourceFile, ios::binary);
+
+	if (!file.is_open())
+		return 0;
+
+	char buffer[64 * 1024];
+
+	while (file) {
+
+		file.read(buffer, sizeof(buffer));
+		streamsize numBytes = file.gcount();
+
+		for (streamsize i = 0; i < numBytes; ++i) {
+
+			hash ^= (uint8_t)buffer[i];
+			hash *= 1099511628211ull;
+		}
+	}
+
+	return hash;
+}
+
+// Store the source file's new timestamp in a cache whose content hash still matches, so later launches don't hash the source again
+static void updateSourceModTime(const string& cacheFile, int64_t modTime) {
+
+	fstream file(cacheFile, ios::binary | ios::in | ios::out);
+
+	if (!file.is_open())
+		return;
+
+	file.seekp(offsetof(MeshCacheHeader, sourceModTime));
+	file.write((const char*)&modTime, sizeof(modTime));
+}
+
+#pragma endregion
+
+
+#pragma region MeshCache implementation
+
+string MeshCache::cachePathFor(const string& sourceFile) {
+
+	return sourceFile + ".mcache";
+}
+
+
+bool MeshCache::mapFile(const string& cacheFile) {
+
+	// Writes are shared so validate can update the header's source timestamp while the file is mapped
+	fileHandle = CreateFileA(cacheFile.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < (long long)sizeof(MeshCacheHeader))
+		return false;
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (!mappingHandle)
+		return false;
+
+	view = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	viewSize = (uint64_t)fileSize.QuadPart;
+
+	return view != nullptr;
+}
+
+
+bool MeshCache::validate(const string& sourceFile, unsigned int importFlags, unsigned int optimizeFlags) {
+
+	const MeshCacheHeader* header = (const MeshCacheHeader*)view;
+
+	if (header->magic != meshCacheMagic || header->version != meshCacheVersion || header->importFlags != importFlags || header->optimizeFlags != optimizeFlags)
+		return false;
+
+	// If the source asset is present make sure the cache was built from it.  Only fall back to hashing the source if the timestamp has changed (eg. the file was copied or checked out again)
+	SourceFileInfo sourceInfo;
+
+	if (getSourceFileInfo(sourceFile, &sourceInfo)) {
+
+		if (sourceInfo.size != header->sourceSize)
+			return false;
+
+		if (sourceInfo.modTime != header->sourceModTime) {
+
+			if (hashSourceFile(sourceFile) != header->sourceHash)
+				return false;
+
+			updateSourceModTime(cachePathFor(sourceFile), sourceInfo.modTime);
+		}
+	}
+
+	// Setup stream pointers into the mapped file, checking each mesh lies within the file
+	const uint64_t entriesEnd = sizeof(MeshCacheHeader) + (uint64_t)header->numMeshes * sizeof(MeshCacheEntry);
+
+	if (entriesEnd > viewSize)
+		return false;
+
+	const MeshCacheEntry* entries = (const MeshCacheEntry*)(view + sizeof(MeshCacheHeader));
+
+	meshes.resize(header->numMeshes);
+
+	for (uint32_t i = 0; i < header->numMeshes; ++i) {
+
+		const MeshCacheEntry& entry = entries[i];
+
+		if (entry.dataOffset < entriesEnd || entry.dataOffset + meshDataSize(entry) > viewSize)
+			return false;
+
+		const aiVector3D* streamPtr = (const aiVector3D*)(view + entry.dataOffset);
+
+		MeshStreams& s = meshes[i];
+
+		s.numVertices = entry.numVertices;
+		s.numIndices = entry.numIndices;
+
+		s.positions = streamPtr; streamPtr += entry.numVertices;
+		s.normals = streamPtr; streamPtr += entry.numVertices;
+		s.tangents = streamPtr; streamPtr += entry.numVertices;
+		s.bitangents = streamPtr; streamPtr += entry.numVertices;
+
+		if (entry.hasTexCoords) {
+
+			s.texCoords = streamPtr;
+			streamPtr += entry.numVertices;
+		}
+
+		s.indices = (const GLuint*)streamPtr;
+
+		s.numLODs = entry.numLODs;
+		s.lods = (entry.numLODs > 0) ? (const MeshLOD*)(s.indices + entry.numIndices) : nullptr;
+	}
+
+	return true;
+}
+
+
+MeshCache* MeshCache::open(const string& sourceFile, unsigned int importFlags, unsigned int optimizeFlags) {
+
+	MeshCache* cache = new MeshCache();
+
+	if (!cache->mapFile(cachePathFor(sourceFile)) || !cache->validate(sourceFile, importFlags, optimizeFlags)) {
+
+		delete cache;
+		return nullptr;
+	}
+
+	return cache;
+}
+
+
+bool MeshCache::write(const string& sourceFile, const vector<MeshData>& meshes, unsigned int importFlags, unsigned int optimizeFlags) {
+
+	MeshCacheHeader header = {};
+
+	header.magic = meshCacheMagic;
+	header.version = meshCacheVersion;
+	header.importFlags = importFlags;
+	header.numMeshes = (uint32_t)meshes.size();
+	header.optimizeFlags = optimizeFlags;
+
+	SourceFileInfo sourceInfo;
+
+	if (getSourceFileInfo(sourceFile, &sourceInfo)) {
+
+		header.sourceSize = sourceInfo.size;
+		header.sourceModTime = sourceInfo.modTime;
+		header.sourceHash = hashSourceFile(sourceFile);
+	}
+
+	// Layout mesh data after the entry table, keeping each mesh 16 byte aligned
+	vector<MeshCacheEntry> entries(meshes.size());
+
+	uint64_t offset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry);
+
+	for (size_t i = 0; i < meshes.size(); ++i) {
+
+		offset = (offset + 15) & ~15ull;
+
+		entries[i] = {};
+		entries[i].numVertices = (uint32_t)meshes[i].positions.size();
+		entries[i].numIndices = (uint32_t)meshes[i].indices.size();
+		entries[i].hasTexCoords = meshes[i].texCoords.empty() ? 0 : 1;
+		entries[i].numLODs = (uint32_t)meshes[i].lods.size();
+		entries[i].dataOffset = offset;
+
+		offset += meshDataSize(entries[i]);
+	}
+
+	ofstream file(cachePathFor(sourceFile), ios::binary | ios::trunc);
+
+	if (!file.is_open()) {
+
+		cout << "Mesh cache: could not create cache file for " << sourceFile << endl;
+		return false;
+	}
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)entries.data(), entries.size() * sizeof(MeshCacheEntry));
+
+	for (size_t i = 0; i < meshes.size(); ++i) {
+
+		const MeshData& m = meshes[i];
+
+		// Pad up to the mesh's data offset
+		static const char padding[16] = {};
+		file.write(padding, entries[i].dataOffset - (uint64_t)file.tellp());
+
+		const streamsize streamBytes = m.positions.size() * sizeof(aiVector3D);
+
+		file.write((const char*)m.positions.data(), streamBytes);
+		file.write((const char*)m.normals.data(), streamBytes);
+		file.write((const char*)m.tangents.data(), streamBytes);
+		file.write((const char*)m.bitangents.data(), streamBytes);
+
+		if (!m.texCoords.empty())
+			file.write((const char*)m.texCoords.data(), streamBytes);
+
+		file.write((const char*)m.indices.data(), m.indices.size() * sizeof(GLuint));
+		file.write((const char*)m.lods.data(), m.lods.size() * sizeof(MeshLOD));
+	}
+
+	bool ok = file.good();
+	file.close();
+
+	if (!ok) {
+
+		cout << "Mesh cache: error writing cache file for " << sourceFile << endl;
+		remove(cachePathFor(sourceFile).c_str());
+	}
+
+	return ok;
+}
+
+
+MeshCache* MeshCache::fromMeshData(vector<MeshData>&& meshes) {
+
+	MeshCache* cache = new MeshCache();
+
+	cache->ownedMeshes = std::move(meshes);
+
+	for (const MeshData& m : cache->ownedMeshes)
+		cache->meshes.push_back(m.streams());
+
+	return cache;
+}
+
+
+MeshCache::~MeshCache() {
+
+	if (view)
+		UnmapViewOfFile(view);
+
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+}
+
+
+GLuint MeshCache::numMeshes() const {
+
+	return (GLuint)meshes.size();
+}
+
+const MeshStreams& MeshCache::mesh(GLuint meshIndex) const {
+
+	return meshes[meshIndex];
+}
+
+#pragma endregion
+
+
+MeshCache* loadMeshCache(const string& sourceFile, unsigned int optimizeFlags) {
+
+	MeshCache* cache = MeshCache::open(sourceFile, meshImportFlags, optimizeFlags);
+
+	if (cache)
+		return cache;
+
+	// No valid cache - import with assimp and rebuild
+	cout << "Mesh cache: rebuilding cache for " << sourceFile << endl;
+
+	const struct aiScene* scene = aiImportFile(sourceFile.c_str(), meshImportFlags);
+
+	if (!scene) {
+
+		cout << "Model: could not import " << sourceFile << endl;
+		return nullptr;
+	}
+
+	vector<MeshData> meshes;
+
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+		meshes.push_back(extractMeshData(scene->mMeshes[i]));
+
+	// Once done, release all resources associated with this import
+	aiReleaseImport(scene);
+
+	if (optimizeFlags != MeshOptimize_None) {
+
+		for (size_t i = 0; i < meshes.size(); ++i) {
+
+			MeshData& m = meshes[i];
+
+			VertexCacheStats before = analyzeVertexCache(m.indices.data(), (GLuint)m.indices.size(), (GLuint)m.positions.size());
+			optimizeMesh(m, optimizeFlags);
+
+			// Statistics are for LOD 0 only
+			const GLuint lod0IndexCount = m.lods.empty() ? (GLuint)m.indices.size() : m.lods[0].numIndices;
+			VertexCacheStats after = analyzeVertexCache(m.indices.data(), lod0IndexCount, (GLuint)m.positions.size());
+
+			printf("Mesh optimizer: %s mesh %d: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", sourceFile.c_str(), (int)i, before.acmr, after.acmr, before.atvr, after.atvr);
+
+			for (size_t l = 1; l < m.lods.size(); ++l)
+				printf("    LOD %d: %d triangles, error %f\n", (int)l, (int)(m.lods[l].numIndices / 3), m.lods[l].error);
+		}
+	}
+
+	if (MeshCache::write(sourceFile, meshes, meshImportFlags, optimizeFlags))
+		cache = MeshCache::open(sourceFile, meshImportFlags, optimizeFlags);
+
+	if (!cache)
+		cache = MeshCache::fromMeshData(std::move(meshes));
+
+	return cache;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "core.h"
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+
+// Versioned binary cache of the post-processed meshes in a model file.  The cache is stored next to the source asset (<source>.mcache) and is memory-mapped when opened so the vertex streams and index buffers can be uploaded straight into OpenGL buffers without going through assimp.
+// A cache is only considered valid if it was built with the same version, import flags and optimisation flags and the source file's size / timestamp (or content hash if the timestamp changed) still match.
+
+class MeshCache {
+
+	HANDLE					fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE					mappingHandle = NULL;
+
+	const uint8_t*			view = nullptr;
+	uint64_t				viewSize = 0;
+
+	std::vector<MeshStreams> meshes;
+
+	// Meshes held in memory when a cache file could not be written
+	std::vector<MeshData>	ownedMeshes;
+
+	MeshCache() {}
+
+	// Map the cache file into memory.  Returns false if the file could not be opened
+	bool mapFile(const std::string& cacheFile);
+
+	// Validate the mapped header against the source file and setup the mesh stream pointers
+	bool validate(const std::string& sourceFile, unsigned int importFlags, unsigned int optimizeFlags);
+
+public:
+
+	// Return the cache file path for a given source asset
+	static std::string cachePathFor(const std::string& sourceFile);
+
+	// Open and validate an existing cache file.  Returns nullptr if there is no cache or it is out of date
+	static MeshCache* open(const std::string& sourceFile, unsigned int importFlags = meshImportFlags, unsigned int optimizeFlags = MeshOptimize_All);
+
+	// Write a new cache file for sourceFile containing the given meshes
+	static bool write(const std::string& sourceFile, const std::vector<MeshData>& meshes, unsigned int importFlags = meshImportFlags, unsigned int optimizeFlags = MeshOptimize_All);
+
+	// Wrap meshes that could not be cached so they can be used in the same way as a mapped cache
+	static MeshCache* fromMeshData(std::vector<MeshData>&& meshes);
+
+	~MeshCache();
+
+	GLuint numMeshes() const;
+	const MeshStreams& mesh(GLuint meshIndex) const;
+};
+
+
+// Load the meshes for a model.  If the model has a valid cache this is used directly, otherwise the model is imported with assimp, the optimisation passes in optimizeFlags are applied and a new cache is written before being opened.  Returns nullptr if the model could not be loaded.  The caller owns the returned cache
+MeshCache* loadMeshCache(const std::string& sourceFile, unsigned int optimizeFlags = MeshOptimize_All);
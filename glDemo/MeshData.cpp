@@ -0,0 +1,111 @@
+#include "MeshData.h"
+#include <glm\gtc\packing.hpp>
+
+using namespace std;
+using namespace glm;
+
+
+MeshStreams MeshData::streams() const {
+
+	MeshStreams s;
+
+	s.numVertices = (GLuint)positions.size();
+	s.numIndices = (GLuint)indices.size();
+
+	s.positions = positions.data();
+	s.normals = normals.data();
+	s.tangents = tangents.data();
+	s.bitangents = bitangents.data();
+	s.texCoords = texCoords.empty() ? nullptr : texCoords.data();
+
+	s.indices = indices.data();
+
+	s.numLODs = (GLuint)lods.size();
+	s.lods = lods.empty() ? nullptr : lods.data();
+
+	return s;
+}
+
+
+// Copy a single vertex stream - if the stream is not present in the aiMesh return a zero filled array
+static vector<aiVector3D> copyStream(const aiVector3D* src, unsigned int numVertices) {
+
+	if (src)
+		return vector<aiVector3D>(src, src + numVertices);
+	else
+		return vector<aiVector3D>(numVertices, aiVector3D(0.0f, 0.0f, 0.0f));
+}
+
+
+MeshData extractMeshData(const aiMesh* mesh) {
+
+	MeshData data;
+
+	const unsigned int numVertices = mesh->mNumVertices;
+
+	data.positions = copyStream(mesh->mVertices, numVertices);
+	data.normals = copyStream(mesh->mNormals, numVertices);
+	data.tangents = copyStream(mesh->mTangents, numVertices);
+	data.bitangents = copyStream(mesh->mBitangents, numVertices);
+
+	if (mesh->mTextureCoords[0]) {
+
+		// Use uvw channel 0 only
+		data.texCoords = copyStream(mesh->mTextureCoords[0], numVertices);
+	}
+
+	// Setup contiguous face index array.  aiProcess_SortByPType moves points and lines into separate meshes so only copy triangles
+	data.indices.reserve(mesh->mNumFaces * 3);
+
+	for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
+
+		const aiFace& face = mesh->mFaces[f];
+
+		if (face.mNumIndices == 3)
+			data.indices.insert(data.indices.end(), face.mIndices, face.mIndices + 3);
+	}
+
+	return data;
+}
+
+
+// Normalise v, returning a zero vector for degenerate input rather than NaNs
+static vec3 safeNormalize(const aiVector3D& v) {
+
+	vec3 u = vec3(v.x, v.y, v.z);
+	float l = length(u);
+
+	return (l > 0.0f) ? u / l : vec3(0.0f);
+}
+
+
+vector<PackedVertex> packVertices(const MeshStreams& mesh) {
+
+	vector<PackedVertex> vertices(mesh.numVertices);
+
+	for (GLuint i = 0; i < mesh.numVertices; ++i) {
+
+		PackedVertex& v = vertices[i];
+
+		v.position[0] = mesh.positions[i].x;
+		v.position[1] = mesh.positions[i].y;
+		v.position[2] = mesh.positions[i].z;
+
+		vec3 n = safeNormalize(mesh.normals[i]);
+		vec3 t = safeNormalize(mesh.tangents[i]);
+		vec3 b = vec3(mesh.bitangents[i].x, mesh.bitangents[i].y, mesh.bitangents[i].z);
+
+		// Store the handedness of the (normal, tangent, bitangent) basis so the bitangent can be recovered
+		float bitangentSign = (dot(cross(n, t), b) < 0.0f) ? -1.0f : 1.0f;
+
+		v.normal = packSnorm3x10_1x2(vec4(n, 0.0f));
+		v.tangent = packSnorm3x10_1x2(vec4(t, bitangentSign));
+
+		if (mesh.texCoords)
+			v.texCoord = packHalf2x16(vec2(mesh.texCoords[i].x, mesh.texCoords[i].y));
+		else
+			v.texCoord = 0;
+	}
+
+	return vertices;
+}
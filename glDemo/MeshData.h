@@ -0,0 +1,83 @@
+#pragma once
+
+#include "core.h"
+
+// Post-process flags used for every model imported through assimp.  These are stored in the mesh cache so a change here invalidates any existing cache files
+const unsigned int meshImportFlags =
+	aiProcess_GenSmoothNormals |
+	aiProcess_CalcTangentSpace |
+	aiProcess_Triangulate |
+	aiProcess_JoinIdenticalVertices |
+	aiProcess_SortByPType;
+
+
+// Vertex buffer layouts supported by AIMesh
+enum class VertexFormat : uint8_t {
+
+	Separate,	// One full float VBO per attribute - position, normal, tangent, bitangent and uvw (60 bytes per vertex)
+	Packed		// Single interleaved VBO of PackedVertex (24 bytes per vertex)
+};
+
+
+// Interleaved, quantized vertex.  Normal and tangent are stored as normalised 10:10:10:2 (GL_INT_2_10_10_10_REV) with the bitangent handedness in the tangent's w component, and the uv coordinates are stored as half floats.  The bitangent is reconstructed in the vertex shader as cross(normal, tangent.xyz) * tangent.w
+struct PackedVertex {
+
+	float					position[3];
+	uint32_t				normal;
+	uint32_t				tangent;
+	uint32_t				texCoord;
+};
+
+
+// A level of detail is a range of a mesh's index buffer.  All levels of a mesh share the same vertices
+struct MeshLOD {
+
+	GLuint					firstIndex;
+	GLuint					numIndices;
+	float					error; // approximate object-space geometric deviation from LOD 0
+	GLuint					reserved;
+};
+
+
+// Non-owning view of the vertex streams and index buffer of a single (triangulated) mesh.  The pointers can refer to an aiMesh copy (MeshData) or directly into a memory-mapped mesh cache file
+struct MeshStreams {
+
+	GLuint					numVertices = 0;
+	GLuint					numIndices = 0;
+
+	const aiVector3D*		positions = nullptr;
+	const aiVector3D*		normals = nullptr;
+	const aiVector3D*		tangents = nullptr;
+	const aiVector3D*		bitangents = nullptr;
+	const aiVector3D*		texCoords = nullptr; // nullptr if the mesh has no uv channel 0
+
+	const GLuint*			indices = nullptr; // all levels of detail - numIndices covers every level
+
+	GLuint					numLODs = 0; // 0 if no LOD chain was generated (the whole index buffer is LOD 0)
+	const MeshLOD*			lods = nullptr;
+};
+
+
+// CPU-side copy of a post-processed mesh
+struct MeshData {
+
+	std::vector<aiVector3D>	positions;
+	std::vector<aiVector3D>	normals;
+	std::vector<aiVector3D>	tangents;
+	std::vector<aiVector3D>	bitangents;
+	std::vector<aiVector3D>	texCoords;
+
+	std::vector<GLuint>		indices;
+
+	std::vector<MeshLOD>	lods;
+
+	MeshStreams streams() const;
+};
+
+
+// Pack the float vertex streams of a mesh into the interleaved PackedVertex format
+std::vector<PackedVertex> packVertices(const MeshStreams& mesh);
+
+
+// Copy the vertex streams and triangle list out of an imported aiMesh.  Missing normal / tangent streams are zero filled so every MeshData has a complete set of streams
+MeshData extractMeshData(const aiMesh* mesh);
@@ -0,0 +1,414 @@
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+
+#pragma region Vertex cache analysis
+
+VertexCacheStats analyzeVertexCache(const GLuint* indices, GLuint numIndices, GLuint numVertices, GLuint cacheSize) {
+
+	VertexCacheStats stats;
+
+	// FIFO cache modelled with timestamps - a vertex is in the cache if fewer than cacheSize misses have occurred since it was loaded
+	vector<GLuint> cacheTimestamp(numVertices, 0);
+	vector<bool> referenced(numVertices, false);
+	GLuint timestamp = cacheSize + 1;
+	GLuint numReferenced = 0;
+
+	for (GLuint i = 0; i < numIndices; ++i) {
+
+		const GLuint v = indices[i];
+
+		if (timestamp - cacheTimestamp[v] > cacheSize) {
+
+			cacheTimestamp[v] = timestamp++;
+			stats.numTransformed++;
+		}
+
+		if (!referenced[v]) {
+
+			referenced[v] = true;
+			numReferenced++;
+		}
+	}
+
+	const GLuint numTriangles = numIndices / 3;
+
+	stats.acmr = (numTriangles > 0) ? (float)stats.numTransformed / (float)numTriangles : 0.0f;
+	stats.atvr = (numReferenced > 0) ? (float)stats.numTransformed / (float)numReferenced : 0.0f;
+
+	return stats;
+}
+
+#pragma endregion
+
+
+#pragma region Vertex cache optimisation (Forsyth)
+
+// Cache size modelled by the optimiser - this is an LRU cache larger than most hardware caches which gives good results over a range of real cache sizes
+static const int forsythCacheSize = 32;
+
+static float forsythVertexScore(int cachePosition, GLuint remainingValence) {
+
+	// Vertices no longer used by any remaining triangle should never be picked
+	if (remainingValence == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+
+	if (cachePosition >= 0) {
+
+		if (cachePosition < 3) {
+
+			// The vertices of the last triangle drawn get a fixed score so we don't favour re-using them in strip order
+			score = 0.75f;
+		}
+		else {
+
+			const float scaler = 1.0f / (float)(forsythCacheSize - 3);
+			score = powf(1.0f - (float)(cachePosition - 3) * scaler, 1.5f);
+		}
+	}
+
+	// Boost vertices with few remaining triangles so they are finished off and don't leave isolated triangles behind
+	score += 2.0f * powf((float)remainingValence, -0.5f);
+
+	return score;
+}
+
+
+void optimizeVertexCache(vector<GLuint>& triangleIndices, GLuint numVertices) {
+
+	const GLuint numTriangles = (GLuint)triangleIndices.size() / 3;
+
+	if (numTriangles == 0)
+		return;
+
+	const vector<GLuint>& indices = triangleIndices;
+
+	// Build vertex -> triangle adjacency.  Each vertex's triangles are stored in adjacency[adjacencyOffset[v] ... adjacencyOffset[v] + remainingValence[v]]
+	vector<GLuint> remainingValence(numVertices, 0);
+
+	for (GLuint i = 0; i < numTriangles * 3; ++i)
+		remainingValence[indices[i]]++;
+
+	vector<GLuint> adjacencyOffset(numVertices, 0);
+	GLuint offset = 0;
+
+	for (GLuint v = 0; v < numVertices; ++v) {
+
+		adjacencyOffset[v] = offset;
+		offset += remainingValence[v];
+	}
+
+	vector<GLuint> adjacency(numTriangles * 3);
+	vector<GLuint> fillCount(numVertices, 0);
+
+	for (GLuint i = 0; i < numTriangles * 3; ++i) {
+
+		const GLuint v = indices[i];
+		adjacency[adjacencyOffset[v] + fillCount[v]++] = i / 3;
+	}
+
+	// Initial scores
+	vector<int> cachePosition(numVertices, -1);
+	vector<float> vertexScore(numVertices);
+	vector<float> triangleScore(numTriangles, 0.0f);
+	vector<bool> emitted(numTriangles, false);
+
+	for (GLuint v = 0; v < numVertices; ++v)
+		vertexScore[v] = forsythVertexScore(-1, remainingValence[v]);
+
+	for (GLuint i = 0; i < numTriangles * 3; ++i)
+		triangleScore[i / 3] += vertexScore[indices[i]];
+
+	// Start with the highest scoring triangle
+	int bestTriangle = (int)(max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+	vector<GLuint> cache, newCache;
+	cache.reserve(forsythCacheSize + 3);
+	newCache.reserve(forsythCacheSize + 3);
+
+	vector<GLuint> newIndices;
+	newIndices.reserve(numTriangles * 3);
+
+	while (bestTriangle >= 0) {
+
+		const GLuint* tri = &indices[bestTriangle * 3];
+
+		newIndices.insert(newIndices.end(), tri, tri + 3);
+		emitted[bestTriangle] = true;
+
+		// Remove the triangle from its vertices' adjacency lists
+		for (int k = 0; k < 3; ++k) {
+
+			const GLuint v = tri[k];
+			GLuint* adj = &adjacency[adjacencyOffset[v]];
+
+			for (GLuint j = 0; j < remainingValence[v]; ++j) {
+
+				if (adj[j] == (GLuint)bestTriangle) {
+
+					adj[j] = adj[remainingValence[v] - 1];
+					remainingValence[v]--;
+					break;
+				}
+			}
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache
+		newCache.clear();
+
+		for (int k = 0; k < 3; ++k) {
+
+			if (find(newCache.begin(), newCache.end(), tri[k]) == newCache.end())
+				newCache.push_back(tri[k]);
+		}
+
+		for (GLuint v : cache) {
+
+			if (find(newCache.begin(), newCache.end(), v) == newCache.end())
+				newCache.push_back(v);
+		}
+
+		// Update the scores of all vertices that were in (or have been pushed out of) the cache and their triangles
+		for (size_t i = 0; i < newCache.size(); ++i) {
+
+			const GLuint v = newCache[i];
+
+			cachePosition[v] = (i < forsythCacheSize) ? (int)i : -1;
+
+			const float score = forsythVertexScore(cachePosition[v], remainingValence[v]);
+			const float delta = score - vertexScore[v];
+
+			vertexScore[v] = score;
+
+			for (GLuint j = 0; j < remainingValence[v]; ++j)
+				triangleScore[adjacency[adjacencyOffset[v] + j]] += delta;
+		}
+
+		if (newCache.size() > forsythCacheSize)
+			newCache.resize(forsythCacheSize);
+
+		swap(cache, newCache);
+
+		// Pick the best triangle that uses a cached vertex
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+
+		for (GLuint v : cache) {
+
+			for (GLuint j = 0; j < remainingValence[v]; ++j) {
+
+				const GLuint t = adjacency[adjacencyOffset[v] + j];
+
+				if (triangleScore[t] > bestScore) {
+
+					bestScore = triangleScore[t];
+					bestTriangle = (int)t;
+				}
+			}
+		}
+
+		// Dead end - restart from the highest scoring triangle not yet emitted.  Scores of triangles outside the cache stay current since evicted vertices are rescored above
+		if (bestTriangle < 0) {
+
+			for (GLuint t = 0; t < numTriangles; ++t) {
+
+				if (!emitted[t] && triangleScore[t] > bestScore) {
+
+					bestScore = triangleScore[t];
+					bestTriangle = (int)t;
+				}
+			}
+		}
+	}
+
+	triangleIndices.swap(newIndices);
+}
+
+
+void optimizeVertexCache(MeshData& mesh) {
+
+	optimizeVertexCache(mesh.indices, (GLuint)mesh.positions.size());
+}
+
+#pragma endregion
+
+
+#pragma region Overdraw optimisation
+
+// Split the (cache optimised) triangle list into clusters at points where the vertex cache is effectively flushed, then sort the clusters so those facing away from the centre of the mesh are drawn first.  Outward facing clusters tend to occlude the rest of the mesh so more fragments are rejected by the depth test.  Since clusters only start on triangles that miss the cache on all three vertices the vertex cache efficiency is preserved
+void optimizeOverdraw(MeshData& mesh, GLuint cacheSize) {
+
+	const GLuint numVertices = (GLuint)mesh.positions.size();
+	const GLuint numTriangles = (GLuint)mesh.indices.size() / 3;
+
+	if (numTriangles == 0)
+		return;
+
+	const vector<GLuint>& indices = mesh.indices;
+
+	// Find cluster boundaries
+	vector<GLuint> clusterStart;
+
+	vector<GLuint> cacheTimestamp(numVertices, 0);
+	GLuint timestamp = cacheSize + 1;
+
+	for (GLuint t = 0; t < numTriangles; ++t) {
+
+		int misses = 0;
+
+		for (int k = 0; k < 3; ++k) {
+
+			const GLuint v = indices[t * 3 + k];
+
+			if (timestamp - cacheTimestamp[v] > cacheSize) {
+
+				cacheTimestamp[v] = timestamp++;
+				misses++;
+			}
+		}
+
+		if (t == 0 || misses == 3)
+			clusterStart.push_back(t);
+	}
+
+	const GLuint numClusters = (GLuint)clusterStart.size();
+
+	if (numClusters < 2)
+		return;
+
+	clusterStart.push_back(numTriangles);
+
+	// Area weighted centroid and normal for each cluster and the whole mesh
+	vector<vec3> clusterCentroid(numClusters, vec3(0.0f));
+	vector<vec3> clusterNormal(numClusters, vec3(0.0f));
+	vector<float> clusterArea(numClusters, 0.0f);
+
+	vec3 meshCentroid = vec3(0.0f);
+	float meshArea = 0.0f;
+
+	for (GLuint c = 0; c < numClusters; ++c) {
+
+		for (GLuint t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+
+			const aiVector3D& p0 = mesh.positions[indices[t * 3 + 0]];
+			const aiVector3D& p1 = mesh.positions[indices[t * 3 + 1]];
+			const aiVector3D& p2 = mesh.positions[indices[t * 3 + 2]];
+
+			vec3 a = vec3(p0.x, p0.y, p0.z);
+			vec3 b = vec3(p1.x, p1.y, p1.z);
+			vec3 d = vec3(p2.x, p2.y, p2.z);
+
+			vec3 n = cross(b - a, d - a); // length = 2 * triangle area
+			float area = length(n);
+			vec3 centroid = (a + b + d) / 3.0f;
+
+			clusterCentroid[c] += centroid * area;
+			clusterNormal[c] += n;
+			clusterArea[c] += area;
+		}
+
+		meshCentroid += clusterCentroid[c];
+		meshArea += clusterArea[c];
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	vector<float> sortKey(numClusters, 0.0f);
+
+	for (GLuint c = 0; c < numClusters; ++c) {
+
+		if (clusterArea[c] <= 0.0f)
+			continue;
+
+		vec3 centroid = clusterCentroid[c] / clusterArea[c];
+		float normalLength = length(clusterNormal[c]);
+
+		if (normalLength > 0.0f)
+			sortKey[c] = dot(centroid - meshCentroid, clusterNormal[c] / normalLength);
+	}
+
+	vector<GLuint> clusterOrder(numClusters);
+
+	for (GLuint c = 0; c < numClusters; ++c)
+		clusterOrder[c] = c;
+
+	stable_sort(clusterOrder.begin(), clusterOrder.end(), [&sortKey](GLuint a, GLuint b) { return sortKey[a] > sortKey[b]; });
+
+	vector<GLuint> newIndices;
+	newIndices.reserve(indices.size());
+
+	for (GLuint c : clusterOrder)
+		newIndices.insert(newIndices.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+
+	mesh.indices.swap(newIndices);
+}
+
+#pragma endregion
+
+
+#pragma region Vertex fetch optimisation
+
+template <typename T>
+static void remapStream(vector<T>& stream, const vector<GLuint>& remap, GLuint numNewVertices) {
+
+	if (stream.empty())
+		return;
+
+	vector<T> newStream(numNewVertices);
+
+	for (size_t v = 0; v < stream.size(); ++v) {
+
+		if (remap[v] != ~0u)
+			newStream[remap[v]] = stream[v];
+	}
+
+	stream.swap(newStream);
+}
+
+// Renumber vertices in the order they are first referenced by the index buffer so vertex fetches walk through memory linearly.  Unreferenced vertices are removed
+void optimizeVertexFetch(MeshData& mesh) {
+
+	const GLuint numVertices = (GLuint)mesh.positions.size();
+
+	vector<GLuint> remap(numVertices, ~0u);
+	GLuint numNewVertices = 0;
+
+	for (GLuint& index : mesh.indices) {
+
+		if (remap[index] == ~0u)
+			remap[index] = numNewVertices++;
+
+		index = remap[index];
+	}
+
+	remapStream(mesh.positions, remap, numNewVertices);
+	remapStream(mesh.normals, remap, numNewVertices);
+	remapStream(mesh.tangents, remap, numNewVertices);
+	remapStream(mesh.bitangents, remap, numNewVertices);
+	remapStream(mesh.texCoords, remap, numNewVertices);
+}
+
+#pragma endregion
+
+
+void optimizeMesh(MeshData& mesh, unsigned int flags) {
+
+	if (flags & MeshOptimize_VertexCache)
+		optimizeVertexCache(mesh);
+
+	if (flags & MeshOptimize_Overdraw)
+		optimizeOverdraw(mesh);
+
+	if (flags & MeshOptimize_LODChain)
+		generateLODChain(mesh);
+
+	if (flags & MeshOptimize_VertexFetch)
+		optimizeVertexFetch(mesh);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "core.h"
+#include "MeshData.h"
+
+// Optional optimisation passes run on imported meshes before they are cached and uploaded to the GPU.  Apart from the LOD chain (which appends simplified levels after LOD 0) the passes only reorder triangles and vertices - the rendered result is unchanged
+
+enum MeshOptimizeFlags : unsigned int {
+
+	MeshOptimize_None = 0,
+
+	MeshOptimize_VertexCache = 1 << 0,	// Forsyth-style triangle reordering for the post-transform vertex cache
+	MeshOptimize_Overdraw = 1 << 1,		// Reorder clusters of triangles so outward facing clusters are drawn first (better early-z rejection)
+	MeshOptimize_VertexFetch = 1 << 2,	// Reorder vertices into first-use order for the pre-transform vertex fetch
+	MeshOptimize_LODChain = 1 << 3,		// Generate simplified levels of detail (see MeshSimplifier.h)
+
+	MeshOptimize_All = MeshOptimize_VertexCache | MeshOptimize_Overdraw | MeshOptimize_VertexFetch | MeshOptimize_LODChain
+};
+
+
+// Post-transform vertex cache statistics for an index buffer
+struct VertexCacheStats {
+
+	GLuint			numTransformed = 0; // number of vertex shader invocations (cache misses)
+	float			acmr = 0.0f; // average cache miss ratio - transformed vertices per triangle (0.5 best, 3.0 worst)
+	float			atvr = 0.0f; // average transformed vertex ratio - transformed vertices per referenced vertex (1.0 best)
+};
+
+// Simulate a FIFO post-transform cache of cacheSize entries over a triangle list
+VertexCacheStats analyzeVertexCache(const GLuint* indices, GLuint numIndices, GLuint numVertices, GLuint cacheSize = 16);
+
+
+// Individual passes.  If combined they should be applied in this order (optimizeMesh does this).  The vertex cache and overdraw passes must be run before a LOD chain is generated
+void optimizeVertexCache(MeshData& mesh);
+void optimizeVertexCache(std::vector<GLuint>& indices, GLuint numVertices);
+void optimizeOverdraw(MeshData& mesh, GLuint cacheSize = 16);
+void optimizeVertexFetch(MeshData& mesh);
+
+// Apply the passes selected in flags (a combination of MeshOptimizeFlags)
+void optimizeMesh(MeshData& mesh, unsigned int flags);
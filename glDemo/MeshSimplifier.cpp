@@ -0,0 +1,482 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+
+using namespace std;
+using namespace glm;
+
+
+#pragma region Quadrics
+
+// Symmetric 4x4 error quadric stored as its upper triangle
+struct Quadric {
+
+	double			a2 = 0, ab = 0, ac = 0, ad = 0;
+	double			b2 = 0, bc = 0, bd = 0;
+	double			c2 = 0, cd = 0;
+	double			d2 = 0;
+
+	// Add the squared distance to plane (n.p + d = 0)
+	void addPlane(const dvec3& n, double d) {
+
+		a2 += n.x * n.x; ab += n.x * n.y; ac += n.x * n.z; ad += n.x * d;
+		b2 += n.y * n.y; bc += n.y * n.z; bd += n.y * d;
+		c2 += n.z * n.z; cd += n.z * d;
+		d2 += d * d;
+	}
+
+	void add(const Quadric& q) {
+
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+	}
+
+	double evaluate(const aiVector3D& p) const {
+
+		const double x = p.x, y = p.y, z = p.z;
+
+		double e = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+			+ b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+			+ c2 * z * z + 2.0 * cd * z
+			+ d2;
+
+		return std::max(e, 0.0);
+	}
+};
+
+#pragma endregion
+
+
+#pragma region Edge collapse
+
+struct Collapse {
+
+	double			cost;
+	GLuint			from, to;
+	GLuint			fromStamp, toStamp;
+
+	bool operator<(const Collapse& other) const {
+
+		return cost > other.cost; // min-heap on cost
+	}
+};
+
+static dvec3 toDVec3(const aiVector3D& v) {
+
+	return dvec3(v.x, v.y, v.z);
+}
+
+static dvec3 triangleNormal(const aiVector3D& a, const aiVector3D& b, const aiVector3D& c) {
+
+	return cross(toDVec3(b) - toDVec3(a), toDVec3(c) - toDVec3(a));
+}
+
+
+// Group vertices that share the same position.  Returns the number of position groups and fills posId for each vertex and the representative vertex for each group
+static GLuint weldPositions(const aiVector3D* positions, GLuint numVertices, vector<GLuint>& posId, vector<GLuint>& representative) {
+
+	struct PositionHash {
+
+		size_t operator()(const aiVector3D& p) const {
+
+			uint32_t h[3];
+			memcpy(h, &p, sizeof(h));
+
+			return (size_t)(h[0] * 73856093u ^ h[1] * 19349663u ^ h[2] * 83492791u);
+		}
+	};
+
+	unordered_map<aiVector3D, GLuint, PositionHash> positionMap;
+
+	posId.resize(numVertices);
+	representative.clear();
+
+	for (GLuint v = 0; v < numVertices; ++v) {
+
+		auto result = positionMap.insert(make_pair(positions[v], (GLuint)representative.size()));
+
+		if (result.second)
+			representative.push_back(v);
+
+		posId[v] = result.first->second;
+	}
+
+	return (GLuint)representative.size();
+}
+
+
+// Border planes are added this many times to a border vertex's quadric
+static const int borderPlaneWeight = 10;
+
+
+// Vertices are welded by position so the mesh topology can be simplified across uv / normal seams.  When a position 'from' collapses onto 'to', each vertex at 'from' is replaced by the vertex at 'to' that it shares a collapsing triangle with.  This keeps seams intact - a seam can only collapse along itself, never across
+float simplifyMesh(const aiVector3D* positions, GLuint numVertices, const vector<GLuint>& indices, GLuint targetIndexCount, vector<GLuint>& result) {
+
+	const GLuint numTriangles = (GLuint)indices.size() / 3;
+
+	vector<GLuint> tris(indices.begin(), indices.begin() + numTriangles * 3);
+	vector<bool> triangleAlive(numTriangles, true);
+	GLuint numAlive = numTriangles;
+
+	vector<GLuint> posId, representative;
+	const GLuint numPositions = weldPositions(positions, numVertices, posId, representative);
+
+	// Classify positions.  Positions on a non-manifold edge (used by more than 2 triangles) are locked, positions on a border edge (used by 1 triangle) may only move along the border
+	unordered_map<uint64_t, GLuint> edgeUse;
+
+	auto edgeKey = [](GLuint a, GLuint b) -> uint64_t {
+
+		return ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+	};
+
+	for (GLuint t = 0; t < numTriangles; ++t) {
+
+		for (int k = 0; k < 3; ++k)
+			edgeUse[edgeKey(posId[tris[t * 3 + k]], posId[tris[t * 3 + (k + 1) % 3]])]++;
+	}
+
+	vector<bool> locked(numPositions, false);
+	vector<bool> border(numPositions, false);
+
+	for (const auto& e : edgeUse) {
+
+		GLuint a = (GLuint)(e.first >> 32);
+		GLuint b = (GLuint)(e.first & 0xFFFFFFFF);
+
+		if (e.second > 2) {
+
+			locked[a] = true;
+			locked[b] = true;
+		}
+		else if (e.second == 1) {
+
+			border[a] = true;
+			border[b] = true;
+		}
+	}
+
+	// Position quadrics and position -> triangle adjacency.  The collapse cost includes the weighted border planes, surfaceQuadrics only holds the triangle planes and measures the geometric error that is reported
+	vector<Quadric> quadrics(numPositions);
+	vector<Quadric> surfaceQuadrics(numPositions);
+	vector<vector<GLuint>> positionTriangles(numPositions);
+
+	for (GLuint t = 0; t < numTriangles; ++t) {
+
+		const GLuint* tri = &tris[t * 3];
+
+		dvec3 n = triangleNormal(positions[tri[0]], positions[tri[1]], positions[tri[2]]);
+		double l = length(n);
+
+		if (l > 0.0) {
+
+			n /= l;
+			double d = -dot(n, toDVec3(positions[tri[0]]));
+
+			Quadric q;
+			q.addPlane(n, d);
+
+			for (int k = 0; k < 3; ++k) {
+
+				quadrics[posId[tri[k]]].add(q);
+				surfaceQuadrics[posId[tri[k]]].add(q);
+			}
+
+			// Border edges add a heavily weighted plane perpendicular to the triangle so the border's shape is preserved
+			for (int k = 0; k < 3; ++k) {
+
+				GLuint a = tri[k];
+				GLuint b = tri[(k + 1) % 3];
+
+				if (edgeUse[edgeKey(posId[a], posId[b])] != 1)
+					continue;
+
+				dvec3 edge = toDVec3(positions[b]) - toDVec3(positions[a]);
+				dvec3 borderNormal = cross(edge, n);
+				double borderLength = length(borderNormal);
+
+				if (borderLength > 0.0) {
+
+					borderNormal /= borderLength;
+
+					Quadric borderQuadric;
+
+					for (int w = 0; w < borderPlaneWeight; ++w)
+						borderQuadric.addPlane(borderNormal, -dot(borderNormal, toDVec3(positions[a])));
+
+					quadrics[posId[a]].add(borderQuadric);
+					quadrics[posId[b]].add(borderQuadric);
+				}
+			}
+		}
+
+		for (int k = 0; k < 3; ++k) {
+
+			vector<GLuint>& adj = positionTriangles[posId[tri[k]]];
+
+			if (adj.empty() || adj.back() != t)
+				adj.push_back(t);
+		}
+	}
+
+	// Collapse queue.  Entries are invalidated lazily using per-position stamps
+	vector<GLuint> stamp(numPositions, 0);
+	vector<bool> removed(numPositions, false);
+
+	priority_queue<Collapse> queue;
+
+	auto pushCollapse = [&](GLuint from, GLuint to) {
+
+		if (locked[from] || from == to)
+			return;
+
+		Quadric q = quadrics[from];
+		q.add(quadrics[to]);
+
+		Collapse c;
+		c.cost = q.evaluate(positions[representative[to]]);
+		c.from = from;
+		c.to = to;
+		c.fromStamp = stamp[from];
+		c.toStamp = stamp[to];
+
+		queue.push(c);
+	};
+
+	for (GLuint t = 0; t < numTriangles; ++t) {
+
+		for (int k = 0; k < 3; ++k) {
+
+			GLuint a = posId[tris[t * 3 + k]];
+			GLuint b = posId[tris[t * 3 + (k + 1) % 3]];
+
+			pushCollapse(a, b);
+			pushCollapse(b, a);
+		}
+	}
+
+	// Vertex remapping for the current collapse ('from' vertex -> 'to' vertex)
+	vector<pair<GLuint, GLuint>> remap;
+
+	auto findRemap = [&remap](GLuint v) -> GLuint {
+
+		for (const auto& r : remap) {
+
+			if (r.first == v)
+				return r.second;
+		}
+
+		return ~0u;
+	};
+
+	double maxError = 0.0;
+
+	while (numAlive * 3 > targetIndexCount && !queue.empty()) {
+
+		Collapse c = queue.top();
+		queue.pop();
+
+		if (removed[c.from] || removed[c.to] || stamp[c.from] != c.fromStamp || stamp[c.to] != c.toStamp)
+			continue;
+
+		// Build the vertex remapping from the triangles that will collapse (those containing both positions)
+		remap.clear();
+		bool valid = true;
+		GLuint numCollapsing = 0;
+
+		for (GLuint t : positionTriangles[c.from]) {
+
+			if (!triangleAlive[t])
+				continue;
+
+			const GLuint* tri = &tris[t * 3];
+
+			GLuint fromVertex = ~0u, toVertex = ~0u;
+
+			for (int k = 0; k < 3; ++k) {
+
+				if (posId[tri[k]] == c.from)
+					fromVertex = tri[k];
+				else if (posId[tri[k]] == c.to)
+					toVertex = tri[k];
+			}
+
+			if (fromVertex == ~0u || toVertex == ~0u)
+				continue;
+
+			numCollapsing++;
+
+			GLuint existing = findRemap(fromVertex);
+
+			if (existing == ~0u) {
+
+				// Two 'from' vertices mapping to the same 'to' vertex would merge attributes across a seam
+				for (const auto& r : remap)
+					valid = valid && (r.second != toVertex);
+
+				remap.push_back(make_pair(fromVertex, toVertex));
+			}
+			else if (existing != toVertex) {
+
+				valid = false;
+			}
+		}
+
+		// Border positions can only collapse along a border edge
+		if (border[c.from] && numCollapsing != 1)
+			valid = false;
+
+		if (remap.empty() || !valid)
+			continue;
+
+		// Make sure every remaining triangle around 'from' can be remapped and doesn't flip
+		for (GLuint t : positionTriangles[c.from]) {
+
+			if (!triangleAlive[t] || !valid)
+				continue;
+
+			const GLuint* tri = &tris[t * 3];
+
+			if (posId[tri[0]] == c.to || posId[tri[1]] == c.to || posId[tri[2]] == c.to)
+				continue;
+
+			aiVector3D p[3];
+
+			for (int k = 0; k < 3; ++k) {
+
+				if (posId[tri[k]] == c.from) {
+
+					if (findRemap(tri[k]) == ~0u)
+						valid = false;
+
+					p[k] = positions[representative[c.to]];
+				}
+				else {
+
+					p[k] = positions[tri[k]];
+				}
+			}
+
+			dvec3 before = triangleNormal(positions[tri[0]], positions[tri[1]], positions[tri[2]]);
+			dvec3 after = triangleNormal(p[0], p[1], p[2]);
+
+			if (dot(before, after) <= 0.0)
+				valid = false;
+		}
+
+		if (!valid)
+			continue;
+
+		// Collapse from -> to.  Triangles containing both positions become degenerate and are removed
+		for (GLuint t : positionTriangles[c.from]) {
+
+			if (!triangleAlive[t])
+				continue;
+
+			GLuint* tri = &tris[t * 3];
+
+			if (posId[tri[0]] == c.to || posId[tri[1]] == c.to || posId[tri[2]] == c.to) {
+
+				triangleAlive[t] = false;
+				numAlive--;
+			}
+			else {
+
+				for (int k = 0; k < 3; ++k) {
+
+					if (posId[tri[k]] == c.from)
+						tri[k] = findRemap(tri[k]);
+				}
+
+				positionTriangles[c.to].push_back(t);
+			}
+		}
+
+		quadrics[c.to].add(quadrics[c.from]);
+		surfaceQuadrics[c.to].add(surfaceQuadrics[c.from]);
+		removed[c.from] = true;
+		stamp[c.to]++;
+
+		// The merged surface quadric is the summed squared distance from 'to' to every original triangle plane collapsed into it, so its square root bounds the distance to each of them
+		maxError = std::max(maxError, surfaceQuadrics[c.to].evaluate(positions[representative[c.to]]));
+
+		// Re-evaluate collapses around the merged position
+		for (GLuint t : positionTriangles[c.to]) {
+
+			if (!triangleAlive[t])
+				continue;
+
+			for (int k = 0; k < 3; ++k) {
+
+				GLuint p = posId[tris[t * 3 + k]];
+
+				if (p != c.to) {
+
+					pushCollapse(c.to, p);
+					pushCollapse(p, c.to);
+				}
+			}
+		}
+	}
+
+	result.clear();
+	result.reserve(numAlive * 3);
+
+	for (GLuint t = 0; t < numTriangles; ++t) {
+
+		if (triangleAlive[t])
+			result.insert(result.end(), tris.begin() + t * 3, tris.begin() + t * 3 + 3);
+	}
+
+	return (float)sqrt(maxError);
+}
+
+#pragma endregion
+
+
+#pragma region LOD chain
+
+// Stop simplifying when a level has fewer triangles than this or the simplifier can't make enough progress (eg. mostly seam vertices)
+static const GLuint minLODTriangles = 32;
+static const float minLODReduction = 0.85f;
+
+void generateLODChain(MeshData& mesh, GLuint maxLevels) {
+
+	const GLuint numVertices = (GLuint)mesh.positions.size();
+
+	mesh.lods.clear();
+
+	MeshLOD lod0 = { 0, (GLuint)mesh.indices.size(), 0.0f, 0 };
+	mesh.lods.push_back(lod0);
+
+	vector<GLuint> source(mesh.indices);
+	vector<GLuint> simplified;
+	float error = 0.0f;
+
+	for (GLuint level = 1; level <= maxLevels; ++level) {
+
+		GLuint targetIndexCount = (GLuint)(source.size() / 6) * 3;
+
+		if (targetIndexCount < minLODTriangles * 3)
+			break;
+
+		// Each level is simplified from the previous one so the errors accumulate
+		error += simplifyMesh(mesh.positions.data(), numVertices, source, targetIndexCount, simplified);
+
+		if (simplified.empty() || (float)simplified.size() > (float)source.size() * minLODReduction)
+			break;
+
+		optimizeVertexCache(simplified, numVertices);
+
+		MeshLOD lod = { (GLuint)mesh.indices.size(), (GLuint)simplified.size(), error, 0 };
+		mesh.lods.push_back(lod);
+
+		mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+		source.swap(simplified);
+	}
+}
+
+#pragma endregion
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "core.h"
+#include "MeshData.h"
+
+// Quadric error metric edge-collapse simplification (Garland & Heckbert).  Vertices are collapsed onto one of their neighbours rather than a new optimal position so every level of detail can index the original vertex buffer.  Vertices are welded by position so uv / normal seams can be simplified along their length without opening cracks, vertices on an open border of the mesh may only slide along that border
+
+// Simplify a triangle list towards targetIndexCount indices.  The simplified triangle list is returned in result and the function returns the approximate geometric error introduced (in object-space units).  The error is measured against the triangle planes only - the extra weight that keeps borders in place affects which collapses are chosen but not the reported error
+float simplifyMesh(const aiVector3D* positions, GLuint numVertices, const std::vector<GLuint>& indices, GLuint targetIndexCount, std::vector<GLuint>& result);
+
+// Generate a chain of up to maxLevels simplified levels of detail for mesh, each with roughly half the triangles of the previous level.  The levels are appended to the mesh's index buffer and recorded in mesh.lods after level 0 (the original triangle list), so mesh.lods holds up to maxLevels + 1 entries
+void generateLODChain(MeshData& mesh, GLuint maxLevels = 4);
@@ -0,0 +1,65 @@
+#include "NormalMatrices.h"
+#include <glm\gtc\matrix_inverse.hpp>
+#include <emmintrin.h>
+
+using namespace std;
+using namespace glm;
+
+
+void computeNormalMatrices(const mat4* modelTransforms, mat3* normalMatrices, GLuint count) {
+
+	GLuint i = 0;
+
+	// With the upper 3x3 columns a, b and c the inverse transpose has columns (b x c, c x a, a x b) / det where det = a . (b x c).  Each element of four matrices is gathered into one register so four inverses are calculated in the time of one
+	for (; i + 4 <= count; i += 4) {
+
+		const mat4* m = modelTransforms + i;
+
+		__m128 ax = _mm_setr_ps(m[0][0][0], m[1][0][0], m[2][0][0], m[3][0][0]);
+		__m128 ay = _mm_setr_ps(m[0][0][1], m[1][0][1], m[2][0][1], m[3][0][1]);
+		__m128 az = _mm_setr_ps(m[0][0][2], m[1][0][2], m[2][0][2], m[3][0][2]);
+
+		__m128 bx = _mm_setr_ps(m[0][1][0], m[1][1][0], m[2][1][0], m[3][1][0]);
+		__m128 by = _mm_setr_ps(m[0][1][1], m[1][1][1], m[2][1][1], m[3][1][1]);
+		__m128 bz = _mm_setr_ps(m[0][1][2], m[1][1][2], m[2][1][2], m[3][1][2]);
+
+		__m128 cx = _mm_setr_ps(m[0][2][0], m[1][2][0], m[2][2][0], m[3][2][0]);
+		__m128 cy = _mm_setr_ps(m[0][2][1], m[1][2][1], m[2][2][1], m[3][2][1]);
+		__m128 cz = _mm_setr_ps(m[0][2][2], m[1][2][2], m[2][2][2], m[3][2][2]);
+
+		// Cofactor columns
+		__m128 column[3][3];
+
+		column[0][0] = _mm_sub_ps(_mm_mul_ps(by, cz), _mm_mul_ps(bz, cy));
+		column[0][1] = _mm_sub_ps(_mm_mul_ps(bz, cx), _mm_mul_ps(bx, cz));
+		column[0][2] = _mm_sub_ps(_mm_mul_ps(bx, cy), _mm_mul_ps(by, cx));
+
+		column[1][0] = _mm_sub_ps(_mm_mul_ps(cy, az), _mm_mul_ps(cz, ay));
+		column[1][1] = _mm_sub_ps(_mm_mul_ps(cz, ax), _mm_mul_ps(cx, az));
+		column[1][2] = _mm_sub_ps(_mm_mul_ps(cx, ay), _mm_mul_ps(cy, ax));
+
+		column[2][0] = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+		column[2][1] = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+		column[2][2] = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+
+		__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, column[0][0]), _mm_mul_ps(ay, column[0][1])), _mm_mul_ps(az, column[0][2]));
+		__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+		// Scale and scatter each element back to its matrix
+		for (int c = 0; c < 3; ++c) {
+
+			for (int r = 0; r < 3; ++r) {
+
+				float lanes[4];
+				_mm_storeu_ps(lanes, _mm_mul_ps(column[c][r], invDet));
+
+				for (int lane = 0; lane < 4; ++lane)
+					normalMatrices[i + lane][c][r] = lanes[lane];
+			}
+		}
+	}
+
+	// Remaining transforms one at a time
+	for (; i < count; ++i)
+		normalMatrices[i] = inverseTranspose(mat3(modelTransforms[i]));
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "core.h"
+
+// Calculate the normal matrix of each of count model transforms - the inverse transpose of the upper 3x3, which keeps normals and tangents perpendicular to the surface under non-uniform scaling.  Calculated once per object on the CPU so the vertex shaders don't invert the model matrix for every vertex.  Four transforms are done at a time with SSE (the rest with glm)
+void computeNormalMatrices(const glm::mat4* modelTransforms, glm::mat3* normalMatrices, GLuint count);
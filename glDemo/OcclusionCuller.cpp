@@ -0,0 +1,286 @@
+#include "OcclusionCuller.h"
+#include "GLStateCache.h"
+#include "CameraBuffer.h"
+#include "shader_setup.h"
+
+using namespace std;
+using namespace glm;
+
+
+bool OcclusionCuller::isSupported() {
+
+	return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_shader_image_load_store && GLEW_ARB_texture_storage && GLEW_ARB_multi_draw_indirect);
+}
+
+
+OcclusionCuller::OcclusionCuller(int width, int height) {
+
+	cullShader = setupComputeShader(string("Assets\\Shaders\\occlusion-cull.comp"));
+	downsampleShader = setupComputeShader(string("Assets\\Shaders\\hiz-downsample.comp"));
+
+	cullShader_phase = glGetUniformLocation(cullShader, "phase");
+	cullShader_numObjects = glGetUniformLocation(cullShader, "numObjects");
+	cullShader_depthSize = glGetUniformLocation(cullShader, "depthSize");
+	downsampleShader_sourceLevel = glGetUniformLocation(downsampleShader, "sourceLevel");
+
+	// Sampler and image units don't change so only need setting once
+	GLStateCache::useProgram(cullShader);
+	glUniform1i(glGetUniformLocation(cullShader, "hiZTexture"), 0);
+
+	GLStateCache::useProgram(downsampleShader);
+	glUniform1i(glGetUniformLocation(downsampleShader, "depthTexture"), 0);
+	glUniform1i(glGetUniformLocation(downsampleShader, "sourceImage"), 0);
+	glUniform1i(glGetUniformLocation(downsampleShader, "destImage"), 1);
+
+	// The boxes are projected with the frame's camera matrices
+	CameraBuffer::bindBlock(cullShader);
+
+	glGenBuffers(1, &objectBuffer);
+	glGenBuffers(1, &visibilityBuffer);
+
+	glGenBuffers(numCounterBuffers, counterBuffers);
+
+	for (int i = 0; i < numCounterBuffers; ++i) {
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffers[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Counters), nullptr, GL_DYNAMIC_READ);
+
+		counterPending[i] = false;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	earlyDraws = new IndirectDrawBuffer();
+	lateDraws = new IndirectDrawBuffer();
+
+	resize(width, height);
+}
+
+
+OcclusionCuller::~OcclusionCuller() {
+
+	deleteTargets();
+
+	glDeleteProgram(cullShader);
+	glDeleteProgram(downsampleShader);
+
+	glDeleteBuffers(1, &objectBuffer);
+	glDeleteBuffers(1, &visibilityBuffer);
+	glDeleteBuffers(numCounterBuffers, counterBuffers);
+
+	delete earlyDraws;
+	delete lateDraws;
+}
+
+
+void OcclusionCuller::createTargets() {
+
+	// Depth copy - read with texelFetch so no filtering or mipmaps
+	glGenTextures(1, &depthTexture);
+	GLStateCache::bindTextureForUpdate(depthTexture);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenFramebuffers(1, &depthFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+		printf("Occlusion culler: depth framebuffer incomplete (status 0x%x)\n", status);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// Hi-Z pyramid down to 1x1 - immutable storage so every level can be bound as an image
+	int hiZWidth = glm::max(width / 2, 1);
+	int hiZHeight = glm::max(height / 2, 1);
+
+	numHiZLevels = 1;
+
+	while ((hiZWidth >> numHiZLevels) > 0 || (hiZHeight >> numHiZLevels) > 0)
+		numHiZLevels++;
+
+	glGenTextures(1, &hiZTexture);
+	GLStateCache::bindTextureForUpdate(hiZTexture);
+
+	glTexStorage2D(GL_TEXTURE_2D, numHiZLevels, GL_R32F, hiZWidth, hiZHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+
+void OcclusionCuller::deleteTargets() {
+
+	if (depthFramebuffer)
+		glDeleteFramebuffers(1, &depthFramebuffer);
+
+	GLuint textures[] = { depthTexture, hiZTexture };
+
+	for (GLuint texture : textures) {
+
+		if (texture) {
+
+			GLStateCache::textureDeleted(texture);
+			glDeleteTextures(1, &texture);
+		}
+	}
+
+	depthFramebuffer = depthTexture = hiZTexture = 0;
+}
+
+
+void OcclusionCuller::resize(int width, int height) {
+
+	// Minimised windows have no size
+	width = glm::max(width, 1);
+	height = glm::max(height, 1);
+
+	if (width == this->width && height == this->height)
+		return;
+
+	this->width = width;
+	this->height = height;
+
+	deleteTargets();
+	createTargets();
+}
+
+
+GLuint OcclusionCuller::addObjects(GLuint numObjects) {
+
+	GLuint firstObject = (GLuint)objects.size();
+
+	objects.resize(objects.size() + numObjects);
+
+	earlyDraws->addCommands(numObjects);
+	lateDraws->addCommands(numObjects);
+
+	return firstObject;
+}
+
+
+void OcclusionCuller::setObject(GLuint index, const vec3& centre, const vec3& extent, bool inFrustum, const DrawElementsIndirectCommand& command) {
+
+	ObjectData& object = objects[index];
+
+	object.centre = vec4(centre, inFrustum ? 1.0f : 0.0f);
+	object.extent = vec4(extent, 0.0f);
+	object.command = command;
+}
+
+
+void OcclusionCuller::dispatchCull(int phase, IndirectDrawBuffer* draws) {
+
+	GLuint numObjects = (GLuint)objects.size();
+
+	GLStateCache::useProgram(cullShader);
+	glUniform1i(cullShader_phase, phase);
+	glUniform1ui(cullShader_numObjects, numObjects);
+	glUniform2i(cullShader_depthSize, width, height);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibilityBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, draws->getBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, counterBuffers[currentCounterBuffer]);
+
+	glDispatchCompute((numObjects + 63) / 64, 1, 1);
+
+	// The commands are read by the draws and the visibility by the next dispatch
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+
+void OcclusionCuller::cullEarly() {
+
+	lateCulled = false;
+
+	GLuint numObjects = (GLuint)objects.size();
+
+	if (numObjects == 0)
+		return;
+
+	// Allocates the command buffers the first time (the commands are only ever written by the compute shader after this)
+	earlyDraws->upload();
+	lateDraws->upload();
+
+	// Every object starts visible so the first frame draws everything in the early phase
+	if (visibilityCapacity != numObjects) {
+
+		vector<GLuint> visibility(numObjects, 1);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibilityBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, numObjects * sizeof(GLuint), visibility.data(), GL_DYNAMIC_COPY);
+
+		visibilityCapacity = numObjects;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, numObjects * sizeof(ObjectData), objects.data(), GL_STREAM_DRAW);
+
+	// Read the oldest frame's statistics, then reuse its counters for this frame
+	currentCounterBuffer = (currentCounterBuffer + 1) % numCounterBuffers;
+
+	Counters zero = {};
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffers[currentCounterBuffer]);
+
+	if (counterPending[currentCounterBuffer])
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Counters), &counters);
+
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Counters), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	counterPending[currentCounterBuffer] = true;
+
+	dispatchCull(0, earlyDraws);
+}
+
+
+void OcclusionCuller::cullLate() {
+
+	if (lateCulled || objects.empty())
+		return;
+
+	lateCulled = true;
+
+	// Copy the early phase depth from the framebuffer being drawn to
+	GLint drawFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, drawFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFramebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, drawFramebuffer);
+
+	// Reduce the depth into the Hi-Z pyramid one level at a time
+	GLStateCache::useProgram(downsampleShader);
+	GLStateCache::bindTexture(0, depthTexture);
+
+	int levelWidth = glm::max(width / 2, 1);
+	int levelHeight = glm::max(height / 2, 1);
+
+	for (int level = 0; level < numHiZLevels; ++level) {
+
+		// Level 0 reads the depth texture (the source image is bound but unused)
+		glUniform1i(downsampleShader_sourceLevel, level - 1);
+		glBindImageTexture(0, hiZTexture, glm::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		levelWidth = glm::max(levelWidth / 2, 1);
+		levelHeight = glm::max(levelHeight / 2, 1);
+	}
+
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	// Test the objects against the pyramid
+	GLStateCache::bindTexture(0, hiZTexture);
+	dispatchCull(1, lateDraws);
+}
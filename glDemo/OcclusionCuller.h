@@ -0,0 +1,101 @@
+#pragma once
+
+#include "core.h"
+#include "IndirectDrawBuffer.h"
+
+// Two phase GPU occlusion culling.  An object is one mesh at one placement, drawn with its own multi-draw indirect command (from the geometry arena, with its transform in the instance buffer at the command's base instance).  Each frame:
+//   cullEarly - a compute pass writes the early draws: the objects inside the frustum that were visible at the end of last frame.  These are drawn first
+//   cullLate - the depth of the early draws is reduced to a hierarchical depth (Hi-Z) pyramid holding the furthest depth under each texel, then every object in the frustum has its screen bounds tested against it.  The late draws are the visible objects the early phase didn't draw, and the visibility of every object is kept for the next frame
+// Objects hidden behind last frame's visible objects aren't drawn, and objects that come into view are drawn in the late phase of the same frame, so nothing pops in.  Hi-Z is built from the depth of the framebuffer bound when cullLate is called, which must be DEPTH24_STENCIL8 (like the default framebuffer usually is) and the size given to resize.
+// Requires GL 4.3 (compute shaders and storage buffers) - check isSupported before creating a culler.  Statistics come from GPU counters read back numCounterBuffers frames late so reading them doesn't wait for the GPU.
+
+class OcclusionCuller {
+
+	// std430 layout of ObjectData in occlusion-cull.comp
+	struct ObjectData {
+
+		glm::vec4				centre; // world space box centre, w = 1 if the box is inside the view frustum
+		glm::vec4				extent;
+		DrawElementsIndirectCommand command;
+		GLuint					padding[3];
+	};
+
+	// std430 layout of CounterBuffer in occlusion-cull.comp
+	struct Counters {
+
+		GLuint					numDrawnEarly;
+		GLuint					numDrawnLate;
+		GLuint					numOccluded;
+	};
+
+	static const int			numCounterBuffers = 3;
+
+	GLuint						cullShader = 0;
+	GLint						cullShader_phase;
+	GLint						cullShader_numObjects;
+	GLint						cullShader_depthSize;
+
+	GLuint						downsampleShader = 0;
+	GLint						downsampleShader_sourceLevel;
+
+	std::vector<ObjectData>		objects;
+	GLuint						objectBuffer = 0;
+
+	GLuint						visibilityBuffer = 0;
+	GLuint						visibilityCapacity = 0; // in objects
+
+	IndirectDrawBuffer*			earlyDraws = nullptr;
+	IndirectDrawBuffer*			lateDraws = nullptr;
+
+	// Copy of the early phase depth and the Hi-Z pyramid (level 0 is half the depth size)
+	int							width = 0;
+	int							height = 0;
+	GLuint						depthFramebuffer = 0;
+	GLuint						depthTexture = 0;
+	GLuint						hiZTexture = 0;
+	int							numHiZLevels = 0;
+
+	bool						lateCulled = false; // this frame
+
+	GLuint						counterBuffers[numCounterBuffers];
+	bool						counterPending[numCounterBuffers];
+	int							currentCounterBuffer = 0;
+	Counters					counters = {}; // read back from the oldest frame
+
+	void createTargets();
+	void deleteTargets();
+
+	void dispatchCull(int phase, IndirectDrawBuffer* draws);
+
+public:
+
+	static bool isSupported();
+
+	OcclusionCuller(int width, int height);
+	~OcclusionCuller();
+
+	// Recreate the depth copy and Hi-Z pyramid for a new framebuffer size
+	void resize(int width, int height);
+
+	// Add numObjects objects.  Returns the index of the first one - objects are drawn with the commands of the same index in the early and late draw buffers
+	GLuint addObjects(GLuint numObjects);
+
+	// Set an object's world space bounding box and draw command for this frame.  The command's instance count is ignored.  Objects outside the frustum aren't drawn or tested
+	void setObject(GLuint index, const glm::vec3& centre, const glm::vec3& extent, bool inFrustum, const DrawElementsIndirectCommand& command);
+
+	// Upload the frame's objects and write the early draws.  Call once per frame, after setting the objects and before drawing them
+	void cullEarly();
+
+	// Build the Hi-Z pyramid from the current framebuffer's depth and write the late draws.  Only the first call after cullEarly does anything, so the scene can be drawn more than once a frame (eg. by multi-pass lighting)
+	void cullLate();
+
+	IndirectDrawBuffer* getEarlyDraws() { return earlyDraws; }
+	IndirectDrawBuffer* getLateDraws() { return lateDraws; }
+
+	GLuint getNumObjects() const { return (GLuint)objects.size(); }
+
+	// Statistics from numCounterBuffers frames ago
+	GLuint getNumDrawnEarly() const { return counters.numDrawnEarly; }
+	GLuint getNumDrawnLate() const { return counters.numDrawnLate; }
+	GLuint getNumOccluded() const { return counters.numOccluded; }
+};
@@ -0,0 +1,536 @@
+#include "OcclusionRasterizer.h"
+#include <stdio.h>
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__AVX2__)
+#define OCCLUSION_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+
+// Polygons are clipped to the near plane and to a guard band this many times the size of the screen (in NDC) - beyond that the edge functions lose too much precision
+static const float guardBand = 32.0f;
+
+// Clip planes (dot(plane, clip) >= 0 inside) - near, then the guard band
+static const vec4 clipPlanes[] = {
+
+	vec4(0.0f, 0.0f, 1.0f, 1.0f),
+	vec4(1.0f, 0.0f, 0.0f, guardBand),
+	vec4(-1.0f, 0.0f, 0.0f, guardBand),
+	vec4(0.0f, 1.0f, 0.0f, guardBand),
+	vec4(0.0f, -1.0f, 0.0f, guardBand)
+};
+
+static const int numClipPlanes = sizeof(clipPlanes) / sizeof(clipPlanes[0]);
+
+// A triangle clipped by every plane has at most one extra vertex per plane
+static const int maxClippedVertices = 3 + numClipPlanes;
+
+
+OccluderMesh makeOccluderMesh(const float* positions, const uint32_t* indices, uint32_t numIndices) {
+
+	OccluderMesh occluder;
+
+	uint32_t numVertices = 0;
+
+	for (uint32_t i = 0; i < numIndices; ++i)
+		numVertices = std::max(numVertices, indices[i] + 1);
+
+	// Index of each source vertex in the occluder (UINT32_MAX = not used)
+	vector<uint32_t> remap(numVertices, UINT32_MAX);
+
+	occluder.indices.reserve(numIndices);
+
+	for (uint32_t i = 0; i < numIndices; ++i) {
+
+		uint32_t index = indices[i];
+
+		if (remap[index] == UINT32_MAX) {
+
+			remap[index] = (uint32_t)occluder.positions.size();
+			occluder.positions.push_back(vec3(positions[index * 3], positions[index * 3 + 1], positions[index * 3 + 2]));
+		}
+
+		occluder.indices.push_back(remap[index]);
+	}
+
+	return occluder;
+}
+
+
+// Coverage mask of the tileWidth x tileHeight pixels whose first pixel centre is (x, y).  Bit row * tileWidth + column is set for each pixel centre inside all three edges.  Centres exactly on an edge are only inside inclusive (top or left) edges, so triangles that share an edge don't both cover them
+static inline uint32_t tileCoverage(const float* edgeA, const float* edgeB, const float* edgeC, const bool* inclusive, float x, float y) {
+
+	static_assert(OcclusionRasterizer::tileWidth == 8 && OcclusionRasterizer::tileHeight == 4, "tileCoverage assumes 8x4 tiles");
+
+	uint32_t coverage = 0;
+
+#if defined(OCCLUSION_AVX2)
+
+	// One row of 8 pixels per step
+	__m256 columns = _mm256_add_ps(_mm256_set1_ps(x), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+	__m256 rowStart[3];
+
+	for (int e = 0; e < 3; ++e)
+		rowStart[e] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[e]), columns), _mm256_set1_ps(edgeC[e] + edgeB[e] * y));
+
+	for (int row = 0; row < 4; ++row) {
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (int e = 0; e < 3; ++e)
+			inside = _mm256_and_ps(inside, inclusive[e] ? _mm256_cmp_ps(rowStart[e], _mm256_setzero_ps(), _CMP_GE_OQ) : _mm256_cmp_ps(rowStart[e], _mm256_setzero_ps(), _CMP_GT_OQ));
+
+		coverage |= (uint32_t)_mm256_movemask_ps(inside) << (row * 8);
+
+		for (int e = 0; e < 3; ++e)
+			rowStart[e] = _mm256_add_ps(rowStart[e], _mm256_set1_ps(edgeB[e]));
+	}
+
+#elif defined(OCCLUSION_SSE2)
+
+	// Each row of 8 pixels in two halves
+	__m128 columns = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+	__m128 rowStart[3][2];
+
+	for (int e = 0; e < 3; ++e) {
+
+		__m128 a = _mm_set1_ps(edgeA[e]);
+		__m128 start = _mm_add_ps(_mm_mul_ps(a, columns), _mm_set1_ps(edgeC[e] + edgeB[e] * y));
+
+		rowStart[e][0] = start;
+		rowStart[e][1] = _mm_add_ps(start, _mm_mul_ps(a, _mm_set1_ps(4.0f)));
+	}
+
+	for (int row = 0; row < 4; ++row) {
+
+		for (int half = 0; half < 2; ++half) {
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+			for (int e = 0; e < 3; ++e)
+				inside = _mm_and_ps(inside, inclusive[e] ? _mm_cmpge_ps(rowStart[e][half], _mm_setzero_ps()) : _mm_cmpgt_ps(rowStart[e][half], _mm_setzero_ps()));
+
+			coverage |= (uint32_t)_mm_movemask_ps(inside) << (row * 8 + half * 4);
+		}
+
+		for (int e = 0; e < 3; ++e) {
+
+			__m128 b = _mm_set1_ps(edgeB[e]);
+
+			rowStart[e][0] = _mm_add_ps(rowStart[e][0], b);
+			rowStart[e][1] = _mm_add_ps(rowStart[e][1], b);
+		}
+	}
+
+#else
+
+	for (int row = 0; row < 4; ++row) {
+
+		for (int column = 0; column < 8; ++column) {
+
+			bool inside = true;
+
+			// Same order of operations as the SIMD versions
+			for (int e = 0; e < 3; ++e) {
+
+				float distance = (edgeA[e] * (x + (float)column) + (edgeC[e] + edgeB[e] * y)) + edgeB[e] * (float)row;
+				inside = inside && (inclusive[e] ? distance >= 0.0f : distance > 0.0f);
+			}
+
+			if (inside)
+				coverage |= 1u << (row * 8 + column);
+		}
+	}
+
+#endif
+
+	return coverage;
+}
+
+
+OcclusionRasterizer::OcclusionRasterizer(int width, int height, ThreadPool* threadPool) {
+
+	tilesX = std::max((width + tileWidth - 1) / tileWidth, 1);
+	tilesY = std::max((height + tileHeight - 1) / tileHeight, 1);
+
+	this->width = tilesX * tileWidth;
+	this->height = tilesY * tileHeight;
+	this->threadPool = threadPool;
+
+	tileDepth0.resize(tilesX * tilesY, 0.0f);
+	tileDepth1.resize(tilesX * tilesY, 0.0f);
+	tileMask.resize(tilesX * tilesY, 0);
+
+	viewProjection = mat4(1.0f);
+}
+
+
+void OcclusionRasterizer::beginFrame(const mat4& viewProjection) {
+
+	this->viewProjection = viewProjection;
+
+	triangles.clear();
+
+	setupTime = 0.0;
+	numTriangles = 0;
+}
+
+
+void OcclusionRasterizer::addOccluder(const OccluderMesh& occluder, const mat4& modelTransform) {
+
+	auto setupStart = chrono::high_resolution_clock::now();
+
+	mat4 modelViewProjection = viewProjection * modelTransform;
+
+	clipPositions.resize(occluder.positions.size());
+
+	for (size_t i = 0; i < occluder.positions.size(); ++i)
+		clipPositions[i] = modelViewProjection * vec4(occluder.positions[i], 1.0f);
+
+	vec4 polygon[2][maxClippedVertices];
+
+	for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+
+		const vec4& v0 = clipPositions[occluder.indices[i]];
+		const vec4& v1 = clipPositions[occluder.indices[i + 1]];
+		const vec4& v2 = clipPositions[occluder.indices[i + 2]];
+
+		// Skip triangles entirely outside one side of the frustum
+		if ((v0.x > v0.w && v1.x > v1.w && v2.x > v2.w) || (v0.x < -v0.w && v1.x < -v1.w && v2.x < -v2.w) ||
+			(v0.y > v0.w && v1.y > v1.w && v2.y > v2.w) || (v0.y < -v0.w && v1.y < -v1.w && v2.y < -v2.w) ||
+			(v0.z > v0.w && v1.z > v1.w && v2.z > v2.w) || (v0.z < -v0.w && v1.z < -v1.w && v2.z < -v2.w))
+			continue;
+
+		// Sutherland-Hodgman clip against each plane the triangle crosses
+		int numVertices = 3;
+		int current = 0;
+
+		polygon[0][0] = v0;
+		polygon[0][1] = v1;
+		polygon[0][2] = v2;
+
+		for (int p = 0; p < numClipPlanes && numVertices >= 3; ++p) {
+
+			const vec4* in = polygon[current];
+			vec4* out = polygon[current ^ 1];
+			int numOut = 0;
+
+			float previousDistance = dot(clipPlanes[p], in[numVertices - 1]);
+			bool allInside = true;
+
+			for (int v = 0; v < numVertices; ++v) {
+
+				float distance = dot(clipPlanes[p], in[v]);
+
+				if (distance < 0.0f)
+					allInside = false;
+
+				// Edge from the previous vertex crosses the plane
+				if ((distance < 0.0f) != (previousDistance < 0.0f)) {
+
+					int previous = (v + numVertices - 1) % numVertices;
+					out[numOut++] = mix(in[previous], in[v], previousDistance / (previousDistance - distance));
+				}
+
+				if (distance >= 0.0f)
+					out[numOut++] = in[v];
+
+				previousDistance = distance;
+			}
+
+			if (allInside)
+				continue;
+
+			numVertices = numOut;
+			current ^= 1;
+		}
+
+		if (numVertices >= 3)
+			addPolygon(polygon[current], numVertices);
+	}
+
+	setupTime += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - setupStart).count();
+}
+
+
+void OcclusionRasterizer::addPolygon(const vec4* clip, int numVertices) {
+
+	// Window coordinates (y up, pixel centres at + 0.5) and depth
+	vec3 screen[maxClippedVertices];
+
+	for (int i = 0; i < numVertices; ++i) {
+
+		float invW = 1.0f / clip[i].w;
+
+		screen[i] = vec3((clip[i].x * invW * 0.5f + 0.5f) * (float)width, (clip[i].y * invW * 0.5f + 0.5f) * (float)height, invW);
+	}
+
+	// Clipped polygons are convex so can be drawn as a fan
+	for (int i = 1; i + 1 < numVertices; ++i) {
+
+		const vec3& s0 = screen[0];
+		const vec3& s1 = screen[i];
+		const vec3& s2 = screen[i + 1];
+
+		float area = (s1.x - s0.x) * (s2.y - s0.y) - (s2.x - s0.x) * (s1.y - s0.y);
+
+		// Back facing (clockwise) or degenerate
+		if (area <= 0.0f)
+			continue;
+
+		Triangle triangle;
+
+		// Tiles holding the pixel centres the triangle could cover
+		float minX = std::min(std::min(s0.x, s1.x), s2.x);
+		float maxX = std::max(std::max(s0.x, s1.x), s2.x);
+		float minY = std::min(std::min(s0.y, s1.y), s2.y);
+		float maxY = std::max(std::max(s0.y, s1.y), s2.y);
+
+		if (maxX < 0.5f || maxY < 0.5f || minX > (float)width - 0.5f || minY > (float)height - 0.5f)
+			continue;
+
+		triangle.tileMinX = (int)ceil(std::max(minX - 0.5f, 0.0f)) / tileWidth;
+		triangle.tileMinY = (int)ceil(std::max(minY - 0.5f, 0.0f)) / tileHeight;
+		triangle.tileMaxX = (int)floor(std::min(maxX - 0.5f, (float)width - 1.0f)) / tileWidth;
+		triangle.tileMaxY = (int)floor(std::min(maxY - 0.5f, (float)height - 1.0f)) / tileHeight;
+
+		const vec3* vertices[3] = { &s0, &s1, &s2 };
+
+		for (int e = 0; e < 3; ++e) {
+
+			const vec3& a = *vertices[e];
+			const vec3& b = *vertices[(e + 1) % 3];
+
+			// Triangles sharing an edge go through it in opposite directions.  Placing the edge through the same end of it in both makes their edge functions exact negatives of each other, so every pixel centre on the edge is covered by exactly one of them
+			const vec3& origin = (a.y < b.y || (a.y == b.y && a.x < b.x)) ? a : b;
+
+			triangle.edgeA[e] = a.y - b.y;
+			triangle.edgeB[e] = b.x - a.x;
+			triangle.edgeC[e] = -(triangle.edgeA[e] * origin.x + triangle.edgeB[e] * origin.y);
+
+			// Top-left fill rule - with y up and counter clockwise triangles, left edges run down and top edges run right to left
+			triangle.edgeInclusive[e] = (triangle.edgeA[e] > 0.0f || (triangle.edgeA[e] == 0.0f && triangle.edgeB[e] < 0.0f));
+		}
+
+		// 1 / w is linear in screen space
+		float depth1 = s1.z - s0.z;
+		float depth2 = s2.z - s0.z;
+
+		triangle.depthA = (depth1 * (s2.y - s0.y) - depth2 * (s1.y - s0.y)) / area;
+		triangle.depthB = (depth2 * (s1.x - s0.x) - depth1 * (s2.x - s0.x)) / area;
+		triangle.depthC = s0.z - triangle.depthA * s0.x - triangle.depthB * s0.y;
+		triangle.minDepth = std::min(std::min(s0.z, s1.z), s2.z);
+
+		triangles.push_back(triangle);
+		numTriangles++;
+	}
+}
+
+
+void OcclusionRasterizer::mergeTile(int tile, uint32_t coverage, float depth) {
+
+	float depth0 = tileDepth0[tile];
+	float depth1 = tileDepth1[tile];
+	uint32_t mask = tileMask[tile];
+
+	// Start a new working layer with the triangle if it's further in front of the working layer than the working layer is in front of the reference layer - merging would hold the working layer back at the far depth
+	if (mask == 0 || depth - depth1 > depth1 - depth0) {
+
+		depth1 = depth;
+		mask = coverage;
+	}
+	else {
+
+		depth1 = std::min(depth1, depth);
+		mask |= coverage;
+	}
+
+	// A full working layer is nearer than the reference layer everywhere in the tile
+	if (mask == 0xffffffffu) {
+
+		depth0 = depth1;
+		depth1 = 0.0f;
+		mask = 0;
+	}
+
+	tileDepth0[tile] = depth0;
+	tileDepth1[tile] = depth1;
+	tileMask[tile] = mask;
+}
+
+
+void OcclusionRasterizer::rasterizeTileRows(int firstRow, int endRow) {
+
+	int firstTile = firstRow * tilesX;
+	int endTile = endRow * tilesX;
+
+	fill(tileDepth0.begin() + firstTile, tileDepth0.begin() + endTile, 0.0f);
+	fill(tileDepth1.begin() + firstTile, tileDepth1.begin() + endTile, 0.0f);
+	fill(tileMask.begin() + firstTile, tileMask.begin() + endTile, 0u);
+
+	for (const Triangle& triangle : triangles) {
+
+		int minY = std::max(triangle.tileMinY, firstRow);
+		int maxY = std::min(triangle.tileMaxY, endRow - 1);
+
+		for (int ty = minY; ty <= maxY; ++ty) {
+
+			float y0 = (float)(ty * tileHeight);
+			float y1 = y0 + (float)tileHeight;
+
+			for (int tx = triangle.tileMinX; tx <= triangle.tileMaxX; ++tx) {
+
+				int tile = ty * tilesX + tx;
+
+				float x0 = (float)(tx * tileWidth);
+				float x1 = x0 + (float)tileWidth;
+
+				// Furthest depth of the triangle in the tile - the depth plane at the tile's furthest corner, but never further than the triangle's furthest vertex
+				float depth = triangle.depthC + triangle.depthA * ((triangle.depthA > 0.0f) ? x0 : x1) + triangle.depthB * ((triangle.depthB > 0.0f) ? y0 : y1);
+				depth = std::max(depth, triangle.minDepth);
+
+				// Nothing to add if the tile is already covered in front of the triangle
+				if (depth <= tileDepth0[tile])
+					continue;
+
+				uint32_t coverage = tileCoverage(triangle.edgeA, triangle.edgeB, triangle.edgeC, triangle.edgeInclusive, x0 + 0.5f, y0 + 0.5f);
+
+				if (coverage)
+					mergeTile(tile, coverage, depth);
+			}
+		}
+	}
+}
+
+
+void OcclusionRasterizer::rasterize() {
+
+	auto rasterStart = chrono::high_resolution_clock::now();
+
+	// One band per pool thread plus one for this thread.  Bands are whole tile rows so no tile is written by two threads
+	int numBands = threadPool ? (int)threadPool->numThreads() + 1 : 1;
+	numBands = std::min(numBands, tilesY);
+
+	vector<future<void>> bands;
+
+	for (int b = 1; b < numBands; ++b) {
+
+		int firstRow = tilesY * b / numBands;
+		int endRow = tilesY * (b + 1) / numBands;
+
+		bands.push_back(threadPool->submit([this, firstRow, endRow]() { rasterizeTileRows(firstRow, endRow); }));
+	}
+
+	rasterizeTileRows(0, tilesY / numBands);
+
+	for (future<void>& band : bands)
+		band.get();
+
+	rasterTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - rasterStart).count();
+}
+
+
+bool OcclusionRasterizer::testBox(const vec3& centre, const vec3& extent) const {
+
+	float minX = FLT_MAX, minY = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearestDepth = 0.0f;
+
+	for (int i = 0; i < 8; ++i) {
+
+		vec3 corner = centre + extent * vec3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+		vec4 clip = viewProjection * vec4(corner, 1.0f);
+
+		// Boxes crossing the near plane surround the camera or can't be projected
+		if (clip.z < -clip.w || clip.w <= 0.0f)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * (float)width;
+		float y = (clip.y * invW * 0.5f + 0.5f) * (float)height;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearestDepth = std::max(nearestDepth, invW);
+	}
+
+	// Off screen boxes are left to frustum culling
+	if (maxX < 0.0f || maxY < 0.0f || minX > (float)width || minY > (float)height)
+		return true;
+
+	int tileMinX = (int)std::max(minX, 0.0f) / tileWidth;
+	int tileMinY = (int)std::max(minY, 0.0f) / tileHeight;
+	int tileMaxX = std::min((int)std::min(maxX, (float)width - 1.0f) / tileWidth, tilesX - 1);
+	int tileMaxY = std::min((int)std::min(maxY, (float)height - 1.0f) / tileHeight, tilesY - 1);
+
+	// Visible if the box is nearer than (or level with) the reference layer of any tile it covers
+	for (int ty = tileMinY; ty <= tileMaxY; ++ty) {
+
+		const float* row = tileDepth0.data() + ty * tilesX;
+		int tx = tileMinX;
+
+#if defined(OCCLUSION_AVX2) || defined(OCCLUSION_SSE2)
+
+		__m128 nearest = _mm_set1_ps(nearestDepth);
+
+		for (; tx + 3 <= tileMaxX; tx += 4) {
+
+			if (_mm_movemask_ps(_mm_cmpge_ps(nearest, _mm_loadu_ps(row + tx))))
+				return true;
+		}
+
+#endif
+
+		for (; tx <= tileMaxX; ++tx) {
+
+			if (nearestDepth >= row[tx])
+				return true;
+		}
+	}
+
+	return false;
+}
+
+
+uint32_t OcclusionRasterizer::cullBoxes(uint32_t numBoxes, const float* centreX, const float* centreY, const float* centreZ, const float* extentX, const float* extentY, const float* extentZ, uint8_t* visible) {
+
+	auto cullStart = chrono::high_resolution_clock::now();
+
+	numBoxesTested = 0;
+	numBoxesOccluded = 0;
+
+	for (uint32_t i = 0; i < numBoxes; ++i) {
+
+		if (!visible[i])
+			continue;
+
+		numBoxesTested++;
+
+		if (!testBox(vec3(centreX[i], centreY[i], centreZ[i]), vec3(extentX[i], extentY[i], extentZ[i]))) {
+
+			visible[i] = 0;
+			numBoxesOccluded++;
+		}
+	}
+
+	cullTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - cullStart).count();
+
+	return numBoxesOccluded;
+}
+
+
+void OcclusionRasterizer::reportStats() {
+
+	printf("Occlusion rasterizer: %dx%d (%d tiles), %u triangle(s) set up in %.3fms, rasterized in %.3fms, %u of %u box(es) occluded in %.3fms\n", width, height, tilesX * tilesY, numTriangles, setupTime, rasterTime, numBoxesOccluded, numBoxesTested, cullTime);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// Only the standard library and glm - no OpenGL or Windows headers (so not core.h) - so the rasterizer can be built and benchmarked on its own on machines without a GPU
+#include "ThreadPool.h"
+#include <stdint.h>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+// Low poly stand-in for a mesh that is drawn into the occlusion rasterizer's depth buffer.  It must not extend beyond the mesh it stands in for, or it could hide things the mesh doesn't
+struct OccluderMesh {
+
+	std::vector<glm::vec3>	positions;
+	std::vector<uint32_t>	indices; // triangle list, counter clockwise front faces
+};
+
+// Copy the vertices used by a triangle list into an OccluderMesh (positions are 3 floats per vertex)
+OccluderMesh makeOccluderMesh(const float* positions, const uint32_t* indices, uint32_t numIndices);
+
+
+// CPU occlusion culling in the style of masked software occlusion culling (Hasselgren, Andersson & Akenine-Moller 2016).  Occluders are rasterized into a small depth buffer split into tiles of tileWidth x tileHeight pixels.  Rather than a depth per pixel each tile keeps a coverage mask of one bit per pixel and two depths - the furthest depth of the whole tile (the reference layer) and the furthest depth of the pixels in the mask (the working layer).  Once the working layer covers the tile it replaces the reference layer, so many small occluders can fill a tile between them.
+// Depth is 1 / w (it interpolates linearly in screen space) - larger is nearer and 0 is infinitely far away.  Each tile's coverage is found by evaluating the triangle's edge functions for a row of pixels at once with AVX2 (or two halves with SSE2), falling back to scalar code on other CPUs.
+// A frame is beginFrame, addOccluder for each occluder, rasterize, then cullBoxes (or testBox) for the objects.  rasterize splits the tile rows into bands that are drawn in parallel on a thread pool.  Everything is conservative - an object is only reported as hidden if every tile it could cover has occluders in front of it everywhere.
+
+class OcclusionRasterizer {
+
+public:
+
+	static const int		tileWidth = 8;
+	static const int		tileHeight = 4; // tileWidth * tileHeight bits in a coverage mask
+
+private:
+
+	// Screen space triangle set up for rasterizing.  Edge functions are a * x + b * y + c (in pixels), positive inside the triangle
+	struct Triangle {
+
+		float				edgeA[3], edgeB[3], edgeC[3];
+		bool				edgeInclusive[3]; // pixel centres exactly on the edge are inside
+		float				depthA, depthB, depthC; // depth plane
+		float				minDepth; // furthest vertex - the depth plane is extrapolated past the triangle so is clamped to this
+		int					tileMinX, tileMinY, tileMaxX, tileMaxY; // inclusive
+	};
+
+	int						width;
+	int						height;
+	int						tilesX;
+	int						tilesY;
+
+	glm::mat4				viewProjection;
+
+	// Per tile - reference layer depth, working layer depth and working layer coverage
+	std::vector<float>		tileDepth0;
+	std::vector<float>		tileDepth1;
+	std::vector<uint32_t>	tileMask;
+
+	std::vector<Triangle>	triangles;
+	std::vector<glm::vec4>	clipPositions; // addOccluder scratch space
+
+	ThreadPool*				threadPool;
+
+	// Statistics
+	double					setupTime = 0.0; // ms spent in addOccluder this frame
+	double					rasterTime = 0.0; // ms of the last rasterize
+	double					cullTime = 0.0; // ms of the last cullBoxes
+	uint32_t				numTriangles = 0; // set up this frame
+	uint32_t				numBoxesTested = 0; // by the last cullBoxes
+	uint32_t				numBoxesOccluded = 0;
+
+	void addPolygon(const glm::vec4* clip, int numVertices);
+	void rasterizeTileRows(int firstRow, int endRow);
+	void mergeTile(int tile, uint32_t coverage, float depth);
+
+public:
+
+	// The depth buffer is rounded up to whole tiles.  Bands are drawn on threadPool if it isn't null, otherwise on the calling thread
+	OcclusionRasterizer(int width, int height, ThreadPool* threadPool = nullptr);
+
+	// Start a frame seen through viewProjection (world space to clip space).  Clears the occluders
+	void beginFrame(const glm::mat4& viewProjection);
+
+	// Transform, clip and set up the triangles of an occluder placed by modelTransform.  Back faces are culled
+	void addOccluder(const OccluderMesh& occluder, const glm::mat4& modelTransform);
+
+	// Clear the depth buffer and draw the occluders.  Waits for every band to finish
+	void rasterize();
+
+	// True if any of the world space box (centre and half size) may be in front of the occluders.  Boxes crossing the near plane are always visible
+	bool testBox(const glm::vec3& centre, const glm::vec3& extent) const;
+
+	// Test the boxes i with visible[i] != 0 (boxes are given as separate arrays for each component, like BoxList) and set visible[i] to 0 for the hidden ones.  Returns the number hidden
+	uint32_t cullBoxes(uint32_t numBoxes, const float* centreX, const float* centreY, const float* centreZ, const float* extentX, const float* extentY, const float* extentZ, uint8_t* visible);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+	double getSetupTime() const { return setupTime; }
+	double getRasterTime() const { return rasterTime; }
+	double getCullTime() const { return cullTime; }
+	uint32_t getNumTriangles() const { return numTriangles; }
+	uint32_t getNumBoxesTested() const { return numBoxesTested; }
+	uint32_t getNumBoxesOccluded() const { return numBoxesOccluded; }
+
+	void reportStats();
+};
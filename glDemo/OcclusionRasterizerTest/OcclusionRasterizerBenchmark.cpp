@@ -0,0 +1,130 @@
+// Times OcclusionRasterizer on a generated city - a grid of box buildings standing on a floor, seen from street level - and reports the average setup, raster and cull time per frame.  Usage: OcclusionRasterizerBenchmark [frames] [threads] (threads = 0 draws on the calling thread)
+#include "OcclusionRasterizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+
+static const int	bufferWidth = 320;
+static const int	bufferHeight = 192;
+static const int	gridSize = 32; // buildings per side
+static const float	gridSpacing = 20.0f;
+static const int	boxesPerBuilding = 16; // test boxes scattered around each building
+
+
+// Unit cube (-1 to 1) with counter clockwise outward faces
+static OccluderMesh makeCube() {
+
+	OccluderMesh cube;
+
+	cube.positions = {
+		vec3(-1.0f, -1.0f, -1.0f), vec3(1.0f, -1.0f, -1.0f), vec3(1.0f, 1.0f, -1.0f), vec3(-1.0f, 1.0f, -1.0f),
+		vec3(-1.0f, -1.0f, 1.0f), vec3(1.0f, -1.0f, 1.0f), vec3(1.0f, 1.0f, 1.0f), vec3(-1.0f, 1.0f, 1.0f)
+	};
+
+	cube.indices = {
+		4, 5, 6, 4, 6, 7,	// +z
+		1, 0, 3, 1, 3, 2,	// -z
+		5, 1, 2, 5, 2, 6,	// +x
+		0, 4, 7, 0, 7, 3,	// -x
+		7, 6, 2, 7, 2, 3,	// +y
+		0, 1, 5, 0, 5, 4	// -y
+	};
+
+	return cube;
+}
+
+
+int main(int argc, char** argv) {
+
+	int numFrames = (argc > 1) ? atoi(argv[1]) : 200;
+	int numThreads = (argc > 2) ? atoi(argv[2]) : 4;
+
+	ThreadPool* threadPool = (numThreads > 0) ? new ThreadPool(numThreads) : nullptr;
+	OcclusionRasterizer rasterizer(bufferWidth, bufferHeight, threadPool);
+
+	OccluderMesh cube = makeCube();
+	OccluderMesh floor;
+
+	float cityHalfSize = gridSize * gridSpacing * 0.5f;
+
+	floor.positions = { vec3(-cityHalfSize, 0.0f, cityHalfSize), vec3(cityHalfSize, 0.0f, cityHalfSize), vec3(cityHalfSize, 0.0f, -cityHalfSize), vec3(-cityHalfSize, 0.0f, -cityHalfSize) };
+	floor.indices = { 0, 1, 2, 0, 2, 3 };
+
+	mt19937 random(5013);
+	uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	vector<mat4> buildings;
+	vector<float> centreX, centreY, centreZ, extentX, extentY, extentZ;
+
+	for (int z = 0; z < gridSize; ++z) {
+
+		for (int x = 0; x < gridSize; ++x) {
+
+			vec3 position = vec3(((float)x + 0.5f) * gridSpacing - cityHalfSize, 0.0f, ((float)z + 0.5f) * gridSpacing - cityHalfSize);
+			vec3 size = vec3(4.0f + unit(random) * 4.0f, 5.0f + unit(random) * 25.0f, 4.0f + unit(random) * 4.0f);
+
+			buildings.push_back(scale(translate(mat4(1.0f), position + vec3(0.0f, size.y, 0.0f)), size));
+
+			for (int i = 0; i < boxesPerBuilding; ++i) {
+
+				centreX.push_back(position.x + (unit(random) - 0.5f) * gridSpacing);
+				centreY.push_back(unit(random) * 10.0f);
+				centreZ.push_back(position.z + (unit(random) - 0.5f) * gridSpacing);
+				extentX.push_back(0.5f + unit(random));
+				extentY.push_back(0.5f + unit(random));
+				extentZ.push_back(0.5f + unit(random));
+			}
+		}
+	}
+
+	uint32_t numBoxes = (uint32_t)centreX.size();
+	vector<uint8_t> visible(numBoxes);
+
+	mat4 projection = perspective(radians(60.0f), (float)bufferWidth / (float)bufferHeight, 0.1f, 1000.0f);
+
+	double setupTime = 0.0, rasterTime = 0.0, cullTime = 0.0;
+	uint64_t numTriangles = 0, numOccluded = 0;
+
+	for (int frame = 0; frame < numFrames; ++frame) {
+
+		// Walk down the middle of a street, turning slowly
+		float t = (float)frame / (float)std::max(numFrames, 1);
+		vec3 eye = vec3(gridSpacing * 0.5f, 2.0f, cityHalfSize * (0.9f - 1.8f * t));
+		float heading = radians(180.0f + 30.0f * sinf(t * 6.2831853f));
+
+		mat4 view = lookAt(eye, eye + vec3(sinf(heading), 0.0f, cosf(heading)), vec3(0.0f, 1.0f, 0.0f));
+
+		rasterizer.beginFrame(projection * view);
+
+		rasterizer.addOccluder(floor, mat4(1.0f));
+
+		for (const mat4& building : buildings)
+			rasterizer.addOccluder(cube, building);
+
+		rasterizer.rasterize();
+
+		fill(visible.begin(), visible.end(), (uint8_t)1);
+		rasterizer.cullBoxes(numBoxes, centreX.data(), centreY.data(), centreZ.data(), extentX.data(), extentY.data(), extentZ.data(), visible.data());
+
+		setupTime += rasterizer.getSetupTime();
+		rasterTime += rasterizer.getRasterTime();
+		cullTime += rasterizer.getCullTime();
+		numTriangles += rasterizer.getNumTriangles();
+		numOccluded += rasterizer.getNumBoxesOccluded();
+	}
+
+	double frames = (double)std::max(numFrames, 1);
+
+	printf("%d frame(s), %dx%d buffer, %d thread(s), %u occluders, %u boxes\n", numFrames, rasterizer.getWidth(), rasterizer.getHeight(), numThreads, (unsigned)buildings.size() + 1, numBoxes);
+	printf("Average per frame: %.3f ms setup, %.3f ms raster, %.3f ms cull, %.0f triangles, %.0f boxes occluded\n", setupTime / frames, rasterTime / frames, cullTime / frames, (double)numTriangles / frames, (double)numOccluded / frames);
+
+	delete threadPool;
+
+	return 0;
+}
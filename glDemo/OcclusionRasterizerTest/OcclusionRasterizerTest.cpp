@@ -0,0 +1,123 @@
+// Checks OcclusionRasterizer against occluder / occludee layouts whose answer is known.  Everything is in view space (the camera is at the origin looking down -z) so the expected results can be worked out by hand
+#include "OcclusionRasterizer.h"
+#include <stdio.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+
+static const int	bufferWidth = 320;
+static const int	bufferHeight = 192;
+
+static int			numFailed = 0;
+
+static void check(bool passed, const char* name) {
+
+	printf("%s: %s\n", passed ? "pass" : "FAIL", name);
+
+	if (!passed)
+		numFailed++;
+}
+
+
+// Quad with corners a, b, c, d in counter clockwise order as seen from its front
+static OccluderMesh makeQuad(const vec3& a, const vec3& b, const vec3& c, const vec3& d) {
+
+	OccluderMesh quad;
+
+	quad.positions = { a, b, c, d };
+	quad.indices = { 0, 1, 2, 0, 2, 3 };
+
+	return quad;
+}
+
+// Wall facing the camera at distance, reaching halfSize either side of the view axis
+static OccluderMesh makeWall(float distance, float halfSize) {
+
+	return makeQuad(vec3(-halfSize, -halfSize, -distance), vec3(halfSize, -halfSize, -distance), vec3(halfSize, halfSize, -distance), vec3(-halfSize, halfSize, -distance));
+}
+
+
+static void rasterize(OcclusionRasterizer& rasterizer, const vector<OccluderMesh>& occluders) {
+
+	mat4 projection = perspective(radians(60.0f), (float)bufferWidth / (float)bufferHeight, 0.1f, 100.0f);
+
+	rasterizer.beginFrame(projection);
+
+	for (const OccluderMesh& occluder : occluders)
+		rasterizer.addOccluder(occluder, mat4(1.0f));
+
+	rasterizer.rasterize();
+}
+
+
+static void runTests(ThreadPool* threadPool) {
+
+	OcclusionRasterizer rasterizer(bufferWidth, bufferHeight, threadPool);
+
+	// Nothing drawn - nothing is hidden
+	rasterize(rasterizer, {});
+	check(rasterizer.testBox(vec3(0.0f, 0.0f, -20.0f), vec3(1.0f)), "empty buffer hides nothing");
+
+	// A wall 10 units away, reaching 5 units either side
+	rasterize(rasterizer, { makeWall(10.0f, 5.0f) });
+
+	check(!rasterizer.testBox(vec3(0.0f, 0.0f, -20.0f), vec3(1.0f)), "box behind the wall is hidden");
+	check(rasterizer.testBox(vec3(0.0f, 0.0f, -5.0f), vec3(1.0f)), "box in front of the wall is visible");
+	check(rasterizer.testBox(vec3(0.0f, 0.0f, -10.0f), vec3(1.0f)), "box through the wall is visible");
+
+	// At 20 units the wall covers up to 10 units from the view axis - this box reaches 11
+	check(rasterizer.testBox(vec3(9.0f, 0.0f, -20.0f), vec3(2.0f)), "box partly beside the wall is visible");
+
+	// Boxes crossing the near plane are always visible, even straight behind an occluder
+	check(rasterizer.testBox(vec3(0.0f, 0.0f, -0.5f), vec3(1.0f)), "box crossing the near plane is visible");
+
+	uint8_t visible[] = { 1, 1, 0 };
+	float centreX[] = { 0.0f, 0.0f, 0.0f }, centreY[] = { 0.0f, 0.0f, 0.0f }, centreZ[] = { -20.0f, -5.0f, -20.0f };
+	float extentX[] = { 1.0f, 1.0f, 1.0f }, extentY[] = { 1.0f, 1.0f, 1.0f }, extentZ[] = { 1.0f, 1.0f, 1.0f };
+
+	uint32_t numHidden = rasterizer.cullBoxes(3, centreX, centreY, centreZ, extentX, extentY, extentZ, visible);
+	check(numHidden == 1 && visible[0] == 0 && visible[1] == 1 && visible[2] == 0, "cullBoxes only clears hidden boxes that were visible");
+
+	// Seen from behind the wall is culled
+	rasterize(rasterizer, { makeQuad(vec3(-5.0f, 5.0f, -10.0f), vec3(5.0f, 5.0f, -10.0f), vec3(5.0f, -5.0f, -10.0f), vec3(-5.0f, -5.0f, -10.0f)) });
+	check(rasterizer.testBox(vec3(0.0f, 0.0f, -20.0f), vec3(1.0f)), "back facing wall hides nothing");
+
+	// Two halves of the wall meeting at x = 0.  Neither covers the tiles along the seam by itself, so the tiles must merge the coverage of both
+	rasterize(rasterizer, {
+		makeQuad(vec3(-5.0f, -5.0f, -10.0f), vec3(0.0f, -5.0f, -10.0f), vec3(0.0f, 5.0f, -10.0f), vec3(-5.0f, 5.0f, -10.0f)),
+		makeQuad(vec3(0.0f, -5.0f, -10.0f), vec3(5.0f, -5.0f, -10.0f), vec3(5.0f, 5.0f, -10.0f), vec3(0.0f, 5.0f, -10.0f)) });
+	check(!rasterizer.testBox(vec3(0.0f, 0.0f, -20.0f), vec3(1.0f)), "box behind the seam of two walls is hidden");
+
+	// A floor one unit below the camera running from behind it to 100 units away - its triangles cross the near plane and reach far beyond the guard band to the sides
+	rasterize(rasterizer, { makeQuad(vec3(-1000.0f, -1.0f, 10.0f), vec3(1000.0f, -1.0f, 10.0f), vec3(1000.0f, -1.0f, -100.0f), vec3(-1000.0f, -1.0f, -100.0f)) });
+	check(!rasterizer.testBox(vec3(0.0f, -5.0f, -20.0f), vec3(1.0f)), "box under a floor crossing the near plane is hidden");
+	check(rasterizer.testBox(vec3(0.0f, 1.0f, -20.0f), vec3(1.0f)), "box above a floor crossing the near plane is visible");
+
+	// A wall far larger than the guard band, so each triangle is clipped to it
+	rasterize(rasterizer, { makeWall(10.0f, 10000.0f) });
+	check(!rasterizer.testBox(vec3(0.0f, 0.0f, -30.0f), vec3(1.0f)), "box behind a guard band clipped wall is hidden");
+	check(!rasterizer.testBox(vec3(15.0f, 8.0f, -30.0f), vec3(1.0f)), "box in the corner of the screen behind a guard band clipped wall is hidden");
+	check(rasterizer.testBox(vec3(0.0f, 0.0f, -5.0f), vec3(1.0f)), "box in front of a guard band clipped wall is visible");
+}
+
+
+int main() {
+
+	printf("Calling thread:\n");
+	runTests(nullptr);
+
+	ThreadPool threadPool(4);
+
+	printf("Thread pool:\n");
+	runTests(&threadPool);
+
+	if (numFailed > 0) {
+
+		printf("%d check(s) failed\n", numFailed);
+		return 1;
+	}
+
+	return 0;
+}
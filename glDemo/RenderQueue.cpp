@@ -0,0 +1,209 @@
+#include "RenderQueue.h"
+#include "GLStateCache.h"
+
+using namespace std;
+using namespace glm;
+
+
+// Key layout (bit ranges)
+//   Opaque:      pass 60-63 | program 52-59 | texture 40-51 | normal map 28-39 | VAO 20-27 | depth 0-19 (front to back)
+//   Transparent: pass 60-63 | depth 40-59 (back to front) | program 32-39 | texture 20-31 | normal map 8-19 | VAO 0-7
+uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program, GLuint texture, GLuint normalMap, GLuint vao, float viewDepth) {
+
+	// The bits of a positive float increase with its value - keep the exponent and top 12 mantissa bits
+	uint32_t depthBits = 0;
+
+	if (viewDepth > 0.0f)
+		memcpy(&depthBits, &viewDepth, sizeof(float));
+
+	uint64_t depth = depthBits >> 11;
+
+	uint64_t state = ((uint64_t)(program & 0xFF) << 32) | ((uint64_t)(texture & 0xFFF) << 20) | ((uint64_t)(normalMap & 0xFFF) << 8) | (uint64_t)(vao & 0xFF);
+	uint64_t key = (uint64_t)pass << 60;
+
+	if (pass == RenderPass::Transparent)
+		key |= ((~depth & 0xFFFFF) << 40) | state;
+	else
+		key |= (state << 20) | depth;
+
+	return key;
+}
+
+
+void RenderQueue::clear() {
+
+	items.clear();
+}
+
+
+void RenderQueue::submitInstanced(RenderPass pass, GLuint program, AIMesh* mesh, GLuint firstInstance, GLuint numInstances, float viewDepth) {
+
+	DrawItem item;
+
+	item.mesh = mesh;
+	item.program = program;
+	item.firstInstance = firstInstance;
+	item.numInstances = numInstances;
+	item.indirectBuffer = nullptr;
+	item.firstCommand = 0;
+	item.numCommands = 0;
+	mesh->getDrawRange(item.firstIndex, item.numIndices, item.baseVertex);
+	item.texture = mesh->getTextureID();
+	item.normalMap = mesh->getNormalMapID();
+	item.vao = mesh->getVAO();
+	item.key = makeKey(pass, program, item.texture, item.normalMap, item.vao, viewDepth);
+
+	items.push_back(item);
+}
+
+
+void RenderQueue::submitMultiDraw(RenderPass pass, GLuint program, GLuint vao, GLuint texture, GLuint normalMap, IndirectDrawBuffer* indirectBuffer, GLuint firstCommand, GLuint numCommands, GLuint numInstances, float viewDepth) {
+
+	DrawItem item;
+
+	item.mesh = nullptr;
+	item.program = program;
+	item.firstInstance = 0;
+	item.numInstances = numInstances;
+	item.indirectBuffer = indirectBuffer;
+	item.firstCommand = firstCommand;
+	item.numCommands = numCommands;
+	item.firstIndex = 0;
+	item.numIndices = 0;
+	item.baseVertex = 0;
+	item.texture = texture;
+	item.normalMap = normalMap;
+	item.vao = vao;
+	item.key = makeKey(pass, program, texture, normalMap, vao, viewDepth);
+
+	items.push_back(item);
+}
+
+
+void RenderQueue::setProgram(GLuint program) {
+
+	const uint64_t programBits = program & 0xFF;
+
+	for (DrawItem& item : items) {
+
+		// The program field sits at bit 32 of the transparent key and bit 52 of the opaque keys (see makeKey)
+		int shift = ((RenderPass)(item.key >> 60) == RenderPass::Transparent) ? 32 : 52;
+
+		item.program = program;
+		item.key = (item.key & ~((uint64_t)0xFF << shift)) | (programBits << shift);
+	}
+}
+
+
+void RenderQueue::sort() {
+
+	const size_t numItems = items.size();
+
+	if (numItems < 2)
+		return;
+
+	// Histogram all 8 key bytes in one pass over the items
+	size_t counts[8][256] = {};
+
+	for (const DrawItem& item : items) {
+
+		for (int b = 0; b < 8; ++b)
+			counts[b][(item.key >> (b * 8)) & 0xFF]++;
+	}
+
+	sortBuffer.resize(numItems);
+
+	DrawItem* src = items.data();
+	DrawItem* dst = sortBuffer.data();
+
+	for (int b = 0; b < 8; ++b) {
+
+		const int shift = b * 8;
+
+		// Skip bytes that are the same in every key (most of them for a small scene)
+		if (counts[b][(src[0].key >> shift) & 0xFF] == numItems)
+			continue;
+
+		size_t offsets[256];
+		size_t total = 0;
+
+		for (int i = 0; i < 256; ++i) {
+
+			offsets[i] = total;
+			total += counts[b][i];
+		}
+
+		// Stable scatter so earlier (less significant) passes are preserved
+		for (size_t i = 0; i < numItems; ++i)
+			dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+		std::swap(src, dst);
+	}
+
+	if (src != items.data())
+		items.swap(sortBuffer);
+}
+
+
+void RenderQueue::execute(const PassCallback& beginPass) {
+
+	draw(beginPass, 0);
+}
+
+
+void RenderQueue::executeDepthOnly(GLuint depthOnlyProgram, const PassCallback& beginPass) {
+
+	draw(beginPass, depthOnlyProgram);
+}
+
+
+void RenderQueue::draw(const PassCallback& beginPass, GLuint depthOnlyProgram) {
+
+	numDraws = 0;
+	numInstances = 0;
+
+	int currentPass = -1;
+
+	// Draws sorted next to each other mostly share state - the state cache skips the binds that would not change anything
+	for (const DrawItem& item : items) {
+
+		int pass = (int)(item.key >> 60);
+
+		// Transparent draws are last and don't write depth
+		if (depthOnlyProgram && pass == (int)RenderPass::Transparent)
+			break;
+
+		if (pass != currentPass) {
+
+			currentPass = pass;
+
+			if (beginPass)
+				beginPass((RenderPass)pass);
+		}
+
+		GLStateCache::useProgram(depthOnlyProgram ? depthOnlyProgram : item.program);
+
+		// Depth only programs don't sample the textures
+		if (item.texture != 0 && !depthOnlyProgram)
+			GLStateCache::bindTexture(0, item.texture);
+
+		if (item.normalMap != 0 && !depthOnlyProgram)
+			GLStateCache::bindTexture(1, item.normalMap);
+
+		GLStateCache::bindVertexArray(item.vao);
+
+		if (item.indirectBuffer)
+			item.indirectBuffer->draw(item.firstCommand, item.numCommands);
+		else
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, item.numIndices, GL_UNSIGNED_INT, (const GLvoid*)((GLintptr)item.firstIndex * sizeof(GLuint)), item.numInstances, item.baseVertex, item.firstInstance);
+
+		numDraws++;
+		numInstances += item.numInstances;
+	}
+}
+
+
+void RenderQueue::reportStats() {
+
+	printf("RenderQueue: %u draw(s) of %u instance(s)\n", numDraws, numInstances);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "core.h"
+#include "AIMesh.h"
+#include "IndirectDrawBuffer.h"
+#include <functional>
+
+// Sorted list of draws for a frame.  Each submitted mesh gets a 64 bit sort key packing (from the most significant bits) the pass, shader program, texture set, VAO and view depth.  sort orders the draws with an LSD radix sort over the key bytes, which groups draws that share state so most of the program, texture and VAO changes between consecutive draws are skipped.  Every draw is instanced - model transforms are read from the instance buffer through the draw's base instance (see InstanceBuffer.h), so no per-object uniforms are set.
+// Within opaque passes draws are sorted by state then front to back (so early depth testing rejects hidden fragments).  OpaqueLate holds opaque draws that can only be made once the Opaque pass is in the depth buffer (see OcclusionCuller.h) - the caller prepares them in its pass callback.  In the transparent pass depth is sorted back to front before state so blending is correct.
+// GL names are truncated to fit their key fields - this only affects how well draws are grouped, not which state is bound.
+
+enum class RenderPass : uint8_t {
+
+	Opaque = 0,
+	OpaqueLate = 1,
+	Transparent = 2
+};
+
+class RenderQueue {
+
+	struct DrawItem {
+
+		uint64_t				key;
+		AIMesh*					mesh;
+		GLuint					program;
+		GLuint					firstInstance;
+		GLuint					numInstances;
+
+		// Index range of the LOD selected when the draw was submitted (the mesh's current LOD can change before the queue is executed)
+		GLuint					firstIndex;
+		GLuint					numIndices;
+		GLint					baseVertex;
+
+		// Multi-draw indirect items draw a range of commands instead of a mesh (mesh = nullptr)
+		IndirectDrawBuffer*		indirectBuffer;
+		GLuint					firstCommand;
+		GLuint					numCommands;
+		GLuint					texture;
+		GLuint					normalMap;
+		GLuint					vao;
+	};
+
+	std::vector<DrawItem>		items;
+	std::vector<DrawItem>		sortBuffer; // radix sort scratch space
+
+	// Statistics for the last call to execute
+	GLuint						numDraws = 0;
+	GLuint						numInstances = 0; // mesh instances drawn
+
+	static uint64_t makeKey(RenderPass pass, GLuint program, GLuint texture, GLuint normalMap, GLuint vao, float viewDepth);
+
+public:
+
+	// Called with each pass's index before its first draw so the caller can set pass state such as blending (through GLStateCache)
+	typedef std::function<void(RenderPass pass)> PassCallback;
+
+private:
+
+	// depthOnlyProgram = 0 draws with each item's own program
+	void draw(const PassCallback& beginPass, GLuint depthOnlyProgram);
+
+public:
+
+	// Remove all draws
+	void clear();
+
+	// Queue an instanced draw of mesh at its current LOD (the LOD's index range is kept, so the mesh can select another LOD for its next submit).  program reads each instance's model and normal matrices from the instance buffer range starting at firstInstance.  viewDepth is the distance in front of the camera used to order draws within a pass
+	void submitInstanced(RenderPass pass, GLuint program, AIMesh* mesh, GLuint firstInstance, GLuint numInstances, float viewDepth);
+
+	// Queue a multi-draw of numCommands commands from indirectBuffer.  The commands' meshes must all use vao and the same textures.  numInstances is the total number of mesh instances drawn (for statistics)
+	void submitMultiDraw(RenderPass pass, GLuint program, GLuint vao, GLuint texture, GLuint normalMap, IndirectDrawBuffer* indirectBuffer, GLuint firstCommand, GLuint numCommands, GLuint numInstances, float viewDepth);
+
+	// Sort the queued draws by key.  Only needs to be called once if the queue is executed more than once
+	void sort();
+
+	// Draw every queued item with program instead of the program it was submitted with, rebuilding the program bits of each key.  Every draw then shares one program so a sorted queue stays sorted - multi-pass lighting culls, submits and sorts the scene once, then swaps the program for each pass
+	void setProgram(GLuint program);
+
+	// Draw the queue in order.  Program, texture and VAO binds go through GLStateCache so binds shared by consecutive draws are only made once.  The caller sets each program's per-frame uniforms before calling execute
+	void execute(const PassCallback& beginPass = nullptr);
+
+	// Draw the opaque passes with depthOnlyProgram (an instanced program) instead of each draw's own and without binding textures - for a depth pre-pass.  Transparent draws are skipped
+	void executeDepthOnly(GLuint depthOnlyProgram, const PassCallback& beginPass = nullptr);
+
+	GLuint getNumItems() const { return (GLuint)items.size(); }
+
+	// Mesh instances drawn by the last execute
+	GLuint getNumInstances() const { return numInstances; }
+
+	void reportStats();
+};
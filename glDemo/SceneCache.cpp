@@ -0,0 +1,92 @@
+#include "SceneCache.h"
+
+using namespace std;
+
+
+map<string, SceneCache::Entry>	SceneCache::entries;
+mutex							SceneCache::entryMutex;
+
+unsigned int					SceneCache::numLoads = 0;
+unsigned int					SceneCache::numShared = 0;
+
+
+MeshCache* SceneCache::acquire(const string& sourceFile, unsigned int optimizeFlags) {
+
+	string key = canonicalAssetPath(sourceFile) + "|" + to_string(optimizeFlags);
+
+	promise<MeshCache*> loadPromise;
+
+	unique_lock<mutex> lock(entryMutex);
+
+	auto i = entries.find(key);
+
+	if (i != entries.end()) {
+
+		// Already loaded (or being loaded by another thread) - share it
+		i->second.refCount++;
+		numShared++;
+
+		shared_future<MeshCache*> cache = i->second.cache;
+
+		// Wait for any load in progress outside the lock
+		lock.unlock();
+
+		return cache.get();
+	}
+
+	Entry& entry = entries[key];
+
+	entry.cache = loadPromise.get_future().share();
+	entry.refCount = 1;
+
+	numLoads++;
+
+	lock.unlock();
+
+	MeshCache* cache = loadMeshCache(sourceFile, optimizeFlags);
+
+	loadPromise.set_value(cache);
+
+	if (!cache) {
+
+		// Don't keep failed loads - any threads waiting on this load also receive nullptr and do not release
+		lock.lock();
+		entries.erase(key);
+	}
+
+	return cache;
+}
+
+
+void SceneCache::release(MeshCache* cache) {
+
+	if (!cache)
+		return;
+
+	lock_guard<mutex> lock(entryMutex);
+
+	for (auto i = entries.begin(); i != entries.end(); ++i) {
+
+		// Only entries that have finished loading can be released
+		if (i->second.cache.wait_for(chrono::seconds(0)) != future_status::ready || i->second.cache.get() != cache)
+			continue;
+
+		if (--i->second.refCount == 0) {
+
+			delete cache;
+			entries.erase(i);
+		}
+
+		return;
+	}
+
+	cout << "SceneCache: release called on a mesh cache that was not acquired\n";
+}
+
+
+void SceneCache::reportStats() {
+
+	lock_guard<mutex> lock(entryMutex);
+
+	printf("SceneCache: %u file(s) loaded, %u shared acquire(s), %u file(s) still in use\n", numLoads, numShared, (unsigned int)entries.size());
+}
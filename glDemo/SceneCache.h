@@ -0,0 +1,35 @@
+#pragma once
+
+#include "core.h"
+#include "MeshCache.h"
+#include <mutex>
+#include <future>
+
+// Reference counted registry of loaded model files keyed by canonical path (and optimisation flags).  Each source file is loaded (imported with assimp or mapped from its mesh cache) exactly once while it has users - every AIMesh created from the file shares the same MeshCache.  The MeshCache is deleted as soon as the last user releases it, which should be done once its meshes have been uploaded to the GPU.
+// acquire / release can be called from any thread.  If several threads request the same file at once only the first loads it and the others wait for the result.
+
+class SceneCache {
+
+	struct Entry {
+
+		std::shared_future<MeshCache*>	cache;
+		unsigned int					refCount = 0;
+	};
+
+	static std::map<std::string, Entry>	entries;
+	static std::mutex					entryMutex;
+
+	// Statistics
+	static unsigned int					numLoads;
+	static unsigned int					numShared;
+
+public:
+
+	// Return the meshes for sourceFile, loading them if they are not already in use.  Returns nullptr if the file could not be loaded.  Each successful acquire must be matched by a call to release
+	static MeshCache* acquire(const std::string& sourceFile, unsigned int optimizeFlags = MeshOptimize_All);
+
+	// Release a cache returned by acquire.  The cache is deleted when its last user releases it
+	static void release(MeshCache* cache);
+
+	static void reportStats();
+};
@@ -0,0 +1,721 @@
+#include "TextureCooker.h"
+#include "GLStateCache.h"
+#include <emmintrin.h>
+#include <sys/stat.h>
+#include <float.h>
+
+using namespace std;
+using namespace glm;
+
+
+static bool cookingEnabled = true;
+
+void enableTextureCooking(bool enable) {
+
+	cookingEnabled = enable;
+}
+
+bool textureCookingEnabled() {
+
+	return cookingEnabled;
+}
+
+
+#pragma region Cooked texture file (DDS)
+
+static const uint32_t ddsMagic = 0x20534444; // "DDS "
+static const uint32_t cookedTag = 0x4B4F4F43; // "COOK" - stored in the header's reserved words
+static const uint32_t cookedVersion = 1;
+
+static const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+
+struct DDSPixelFormat {
+
+	uint32_t				size;
+	uint32_t				flags;
+	uint32_t				fourCC;
+	uint32_t				rgbBitCount;
+	uint32_t				rBitMask;
+	uint32_t				gBitMask;
+	uint32_t				bBitMask;
+	uint32_t				aBitMask;
+};
+
+struct DDSHeader {
+
+	uint32_t				size;
+	uint32_t				flags;
+	uint32_t				height;
+	uint32_t				width;
+	uint32_t				pitchOrLinearSize;
+	uint32_t				depth;
+	uint32_t				mipMapCount;
+	uint32_t				reserved1[11]; // [0] = cookedTag, [1] = cookedVersion, [2] = source size, [3] = source timestamp
+	DDSPixelFormat			pixelFormat;
+	uint32_t				caps;
+	uint32_t				caps2;
+	uint32_t				caps3;
+	uint32_t				caps4;
+	uint32_t				reserved2;
+};
+
+static uint32_t makeFourCC(char a, char b, char c, char d) {
+
+	return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+}
+
+static uint32_t fourCCFor(TextureEncoding encoding) {
+
+	switch (encoding) {
+
+		case TextureEncoding::BC3: return makeFourCC('D', 'X', 'T', '5');
+		case TextureEncoding::BC5: return makeFourCC('A', 'T', 'I', '2');
+		default: return makeFourCC('D', 'X', 'T', '1');
+	}
+}
+
+static GLenum internalFormatFor(TextureEncoding encoding) {
+
+	switch (encoding) {
+
+		case TextureEncoding::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case TextureEncoding::BC5: return GL_COMPRESSED_RG_RGTC2;
+		default: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+}
+
+static size_t blockSizeFor(TextureEncoding encoding) {
+
+	return (encoding == TextureEncoding::BC1) ? 8 : 16;
+}
+
+
+// Source file size and timestamp used to detect stale cooked textures
+static bool sourceFileInfo(const string& sourceFile, uint32_t& size, uint32_t& timestamp) {
+
+	struct stat fileStatus;
+
+	if (stat(sourceFile.c_str(), &fileStatus) != 0)
+		return false;
+
+	size = (uint32_t)fileStatus.st_size;
+	timestamp = (uint32_t)fileStatus.st_mtime;
+
+	return true;
+}
+
+
+static bool writeCookedTexture(const string& cookedFile, const CompressedTexture& texture, uint32_t sourceSize, uint32_t sourceTimestamp) {
+
+	ofstream file(cookedFile, ios::binary);
+
+	if (!file.is_open())
+		return false;
+
+	DDSHeader header;
+	memset(&header, 0, sizeof(DDSHeader));
+
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.width = (uint32_t)texture.levels[0].width;
+	header.height = (uint32_t)texture.levels[0].height;
+	header.pitchOrLinearSize = (uint32_t)texture.levels[0].size;
+	header.mipMapCount = (uint32_t)texture.levels.size();
+
+	header.reserved1[0] = cookedTag;
+	header.reserved1[1] = cookedVersion;
+	header.reserved1[2] = sourceSize;
+	header.reserved1[3] = sourceTimestamp;
+
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = fourCCFor(texture.encoding);
+
+	header.caps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+
+	file.write((const char*)&ddsMagic, sizeof(uint32_t));
+	file.write((const char*)&header, sizeof(DDSHeader));
+	file.write((const char*)texture.data.data(), texture.data.size());
+
+	return file.good();
+}
+
+
+// Read a cooked texture.  Returns false if the file is missing, not a cooked texture or was cooked from a different version of the source
+static bool readCookedTexture(const string& cookedFile, uint32_t sourceSize, uint32_t sourceTimestamp, CompressedTexture& texture) {
+
+	ifstream file(cookedFile, ios::binary);
+
+	if (!file.is_open())
+		return false;
+
+	uint32_t magic = 0;
+	DDSHeader header;
+
+	file.read((char*)&magic, sizeof(uint32_t));
+	file.read((char*)&header, sizeof(DDSHeader));
+
+	if (!file.good() || magic != ddsMagic || header.size != sizeof(DDSHeader) || header.reserved1[0] != cookedTag || header.reserved1[1] != cookedVersion)
+		return false;
+
+	if (header.reserved1[2] != sourceSize || header.reserved1[3] != sourceTimestamp)
+		return false;
+
+	if (header.pixelFormat.fourCC == fourCCFor(TextureEncoding::BC1))
+		texture.encoding = TextureEncoding::BC1;
+	else if (header.pixelFormat.fourCC == fourCCFor(TextureEncoding::BC3))
+		texture.encoding = TextureEncoding::BC3;
+	else if (header.pixelFormat.fourCC == fourCCFor(TextureEncoding::BC5))
+		texture.encoding = TextureEncoding::BC5;
+	else
+		return false;
+
+	texture.internalFormat = internalFormatFor(texture.encoding);
+	texture.levels.clear();
+
+	const size_t blockSize = blockSizeFor(texture.encoding);
+	GLsizei width = (GLsizei)header.width;
+	GLsizei height = (GLsizei)header.height;
+	size_t offset = 0;
+
+	for (uint32_t i = 0; i < glm::max(header.mipMapCount, 1u); ++i) {
+
+		CompressedMipLevel level;
+
+		level.width = width;
+		level.height = height;
+		level.offset = offset;
+		level.size = (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+
+		texture.levels.push_back(level);
+
+		offset += level.size;
+		width = glm::max(width / 2, 1);
+		height = glm::max(height / 2, 1);
+	}
+
+	texture.data.resize(offset);
+	file.read((char*)texture.data.data(), offset);
+
+	return file.good();
+}
+
+#pragma endregion
+
+
+#pragma region Mip generation
+
+// Image stored as 4 floats per pixel (r, g, b, a).  Colour maps are held in linear light, normal maps as unit vectors in [-1, 1]
+struct FloatImage {
+
+	int						width = 0;
+	int						height = 0;
+	vector<float>			pixels;
+};
+
+static float srgbToLinear(float c) {
+
+	return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float c) {
+
+	return (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+
+static FloatImage toFloatImage(FIBITMAP* bitmap32bpp, bool normalMap) {
+
+	FloatImage image;
+
+	image.width = (int)FreeImage_GetWidth(bitmap32bpp);
+	image.height = (int)FreeImage_GetHeight(bitmap32bpp);
+	image.pixels.resize((size_t)image.width * image.height * 4);
+
+	float srgbTable[256];
+
+	for (int i = 0; i < 256; ++i)
+		srgbTable[i] = srgbToLinear((float)i / 255.0f);
+
+	for (int y = 0; y < image.height; ++y) {
+
+		const BYTE* src = FreeImage_GetScanLine(bitmap32bpp, y);
+		float* dst = &image.pixels[(size_t)y * image.width * 4];
+
+		for (int x = 0; x < image.width; ++x, src += 4, dst += 4) {
+
+			if (normalMap) {
+
+				vec3 n = vec3(src[FI_RGBA_RED], src[FI_RGBA_GREEN], src[FI_RGBA_BLUE]) / 127.5f - 1.0f;
+				float l = length(n);
+
+				n = (l > 0.0f) ? n / l : vec3(0.0f, 0.0f, 1.0f);
+
+				dst[0] = n.x;
+				dst[1] = n.y;
+				dst[2] = n.z;
+			}
+			else {
+
+				dst[0] = srgbTable[src[FI_RGBA_RED]];
+				dst[1] = srgbTable[src[FI_RGBA_GREEN]];
+				dst[2] = srgbTable[src[FI_RGBA_BLUE]];
+			}
+
+			dst[3] = (float)src[FI_RGBA_ALPHA] / 255.0f;
+		}
+	}
+
+	return image;
+}
+
+
+// 2x2 box filter (SSE).  Odd edges reuse the last row / column
+static FloatImage downsample(const FloatImage& src, bool normalMap) {
+
+	FloatImage dst;
+
+	dst.width = glm::max(src.width / 2, 1);
+	dst.height = glm::max(src.height / 2, 1);
+	dst.pixels.resize((size_t)dst.width * dst.height * 4);
+
+	const __m128 quarter = _mm_set1_ps(0.25f);
+
+	for (int y = 0; y < dst.height; ++y) {
+
+		const float* row0 = &src.pixels[(size_t)glm::min(y * 2, src.height - 1) * src.width * 4];
+		const float* row1 = &src.pixels[(size_t)glm::min(y * 2 + 1, src.height - 1) * src.width * 4];
+
+		float* out = &dst.pixels[(size_t)y * dst.width * 4];
+
+		for (int x = 0; x < dst.width; ++x, out += 4) {
+
+			const int x0 = glm::min(x * 2, src.width - 1) * 4;
+			const int x1 = glm::min(x * 2 + 1, src.width - 1) * 4;
+
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)), _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+
+			_mm_storeu_ps(out, _mm_mul_ps(sum, quarter));
+
+			if (normalMap) {
+
+				// Averaged normals are shorter than unit length
+				float l = sqrtf(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+
+				if (l > 0.0f) {
+
+					out[0] /= l;
+					out[1] /= l;
+					out[2] /= l;
+				}
+				else {
+
+					out[0] = 0.0f;
+					out[1] = 0.0f;
+					out[2] = 1.0f;
+				}
+			}
+		}
+	}
+
+	return dst;
+}
+
+#pragma endregion
+
+
+#pragma region Block compression
+
+static uint8_t toByte(float v) {
+
+	return (uint8_t)glm::clamp((int)(v * 255.0f + 0.5f), 0, 255);
+}
+
+
+// Read a 4x4 block as 8-bit rgba (edge pixels are repeated for blocks that overhang the image)
+static void readBlock(const FloatImage& image, int bx, int by, bool normalMap, uint8_t block[16][4]) {
+
+	for (int j = 0; j < 4; ++j) {
+
+		const int y = glm::min(by * 4 + j, image.height - 1);
+
+		for (int i = 0; i < 4; ++i) {
+
+			const int x = glm::min(bx * 4 + i, image.width - 1);
+			const float* p = &image.pixels[((size_t)y * image.width + x) * 4];
+
+			uint8_t* b = block[j * 4 + i];
+
+			if (normalMap) {
+
+				b[0] = toByte(p[0] * 0.5f + 0.5f);
+				b[1] = toByte(p[1] * 0.5f + 0.5f);
+				b[2] = toByte(p[2] * 0.5f + 0.5f);
+			}
+			else {
+
+				b[0] = toByte(linearToSrgb(p[0]));
+				b[1] = toByte(linearToSrgb(p[1]));
+				b[2] = toByte(linearToSrgb(p[2]));
+			}
+
+			b[3] = toByte(p[3]);
+		}
+	}
+}
+
+
+static uint16_t packRGB565(const vec3& c) {
+
+	int r = glm::clamp((int)(c.r * 31.0f / 255.0f + 0.5f), 0, 31);
+	int g = glm::clamp((int)(c.g * 63.0f / 255.0f + 0.5f), 0, 63);
+	int b = glm::clamp((int)(c.b * 31.0f / 255.0f + 0.5f), 0, 31);
+
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static vec3 unpackRGB565(uint16_t c) {
+
+	int r = (c >> 11) & 31;
+	int g = (c >> 5) & 63;
+	int b = c & 31;
+
+	return vec3((float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)));
+}
+
+
+// BC1 colour block.  Endpoints are the extremes of the block's colours along their principal axis.  The block is always encoded in 4 colour mode (as BC3 requires)
+static void encodeBC1Block(const uint8_t block[16][4], uint8_t* out) {
+
+	vec3 colours[16];
+	vec3 mean = vec3(0.0f);
+
+	for (int i = 0; i < 16; ++i) {
+
+		colours[i] = vec3(block[i][0], block[i][1], block[i][2]);
+		mean += colours[i];
+	}
+
+	mean /= 16.0f;
+
+	// Covariance and principal axis (power iteration)
+	float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+	for (int i = 0; i < 16; ++i) {
+
+		vec3 d = colours[i] - mean;
+
+		cov[0] += d.r * d.r;
+		cov[1] += d.r * d.g;
+		cov[2] += d.r * d.b;
+		cov[3] += d.g * d.g;
+		cov[4] += d.g * d.b;
+		cov[5] += d.b * d.b;
+	}
+
+	vec3 axis = vec3(1.0f, 1.0f, 1.0f);
+
+	for (int iteration = 0; iteration < 4; ++iteration) {
+
+		vec3 v = vec3(
+			cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+			cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+			cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b);
+
+		float l = length(v);
+
+		if (l < 1e-6f)
+			break;
+
+		axis = v / l;
+	}
+
+	float minT = 0.0f, maxT = 0.0f;
+
+	for (int i = 0; i < 16; ++i) {
+
+		float t = dot(colours[i] - mean, axis);
+
+		minT = glm::min(minT, t);
+		maxT = glm::max(maxT, t);
+	}
+
+	uint16_t c0 = packRGB565(clamp(mean + axis * maxT, vec3(0.0f), vec3(255.0f)));
+	uint16_t c1 = packRGB565(clamp(mean + axis * minT, vec3(0.0f), vec3(255.0f)));
+
+	// c0 > c1 selects 4 colour mode
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	uint32_t indices = 0;
+
+	if (c0 != c1) {
+
+		vec3 palette[4];
+
+		palette[0] = unpackRGB565(c0);
+		palette[1] = unpackRGB565(c1);
+		palette[2] = (palette[0] * 2.0f + palette[1]) / 3.0f;
+		palette[3] = (palette[0] + palette[1] * 2.0f) / 3.0f;
+
+		for (int i = 0; i < 16; ++i) {
+
+			int best = 0;
+			float bestDistance = FLT_MAX;
+
+			for (int p = 0; p < 4; ++p) {
+
+				vec3 d = colours[i] - palette[p];
+				float distance = dot(d, d);
+
+				if (distance < bestDistance) {
+
+					bestDistance = distance;
+					best = p;
+				}
+			}
+
+			indices |= (uint32_t)best << (i * 2);
+		}
+	}
+
+	out[0] = (uint8_t)(c0 & 0xFF);
+	out[1] = (uint8_t)(c0 >> 8);
+	out[2] = (uint8_t)(c1 & 0xFF);
+	out[3] = (uint8_t)(c1 >> 8);
+	memcpy(out + 4, &indices, 4);
+}
+
+
+// BC4 single channel block (used for BC3 alpha and each channel of BC5).  8 value mode between the block's min and max
+static void encodeBC4Block(const uint8_t block[16][4], int channel, uint8_t* out) {
+
+	int minValue = 255, maxValue = 0;
+
+	for (int i = 0; i < 16; ++i) {
+
+		minValue = glm::min(minValue, (int)block[i][channel]);
+		maxValue = glm::max(maxValue, (int)block[i][channel]);
+	}
+
+	out[0] = (uint8_t)maxValue;
+	out[1] = (uint8_t)minValue;
+
+	uint64_t indices = 0;
+
+	if (maxValue > minValue) {
+
+		// Palette index order is max, min, then 6 interpolated values from max to min
+		static const int paletteIndex[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+
+		for (int i = 0; i < 16; ++i) {
+
+			// Nearest of the 8 evenly spaced values (0 = min, 7 = max)
+			int step = ((block[i][channel] - minValue) * 14 + (maxValue - minValue)) / ((maxValue - minValue) * 2);
+
+			indices |= (uint64_t)paletteIndex[glm::clamp(step, 0, 7)] << (i * 3);
+		}
+	}
+
+	for (int i = 0; i < 6; ++i)
+		out[2 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+
+static void compressLevel(const FloatImage& image, TextureEncoding encoding, uint8_t* out) {
+
+	const bool normalMap = (encoding == TextureEncoding::BC5);
+	const int blocksX = (image.width + 3) / 4;
+	const int blocksY = (image.height + 3) / 4;
+
+	uint8_t block[16][4];
+
+	for (int by = 0; by < blocksY; ++by) {
+
+		for (int bx = 0; bx < blocksX; ++bx) {
+
+			readBlock(image, bx, by, normalMap, block);
+
+			switch (encoding) {
+
+				case TextureEncoding::BC1:
+					encodeBC1Block(block, out);
+					out += 8;
+					break;
+
+				case TextureEncoding::BC3:
+					encodeBC4Block(block, 3, out);
+					encodeBC1Block(block, out + 8);
+					out += 16;
+					break;
+
+				case TextureEncoding::BC5:
+					encodeBC4Block(block, 0, out);
+					encodeBC4Block(block, 1, out + 8);
+					out += 16;
+					break;
+			}
+		}
+	}
+}
+
+#pragma endregion
+
+
+string cookedTexturePath(const string& sourceFile) {
+
+	return sourceFile + ".dds";
+}
+
+
+TextureEncoding textureEncodingFor(const string& sourceFile, FIBITMAP* bitmap32bpp) {
+
+	// Strip the directory and extension then check for an _n suffix (allowing trailing digits)
+	size_t nameStart = sourceFile.find_last_of("\\/");
+	string name = sourceFile.substr((nameStart == string::npos) ? 0 : nameStart + 1);
+
+	size_t extension = name.find_last_of('.');
+
+	if (extension != string::npos)
+		name = name.substr(0, extension);
+
+	size_t end = name.size();
+
+	while (end > 0 && isdigit((unsigned char)name[end - 1]))
+		end--;
+
+	if (end >= 2 && name[end - 2] == '_' && tolower((unsigned char)name[end - 1]) == 'n')
+		return TextureEncoding::BC5;
+
+	// Use BC3 if any pixel is not fully opaque
+	const unsigned int width = FreeImage_GetWidth(bitmap32bpp);
+	const unsigned int height = FreeImage_GetHeight(bitmap32bpp);
+
+	for (unsigned int y = 0; y < height; ++y) {
+
+		const BYTE* src = FreeImage_GetScanLine(bitmap32bpp, (int)y);
+
+		for (unsigned int x = 0; x < width; ++x) {
+
+			if (src[x * 4 + FI_RGBA_ALPHA] != 255)
+				return TextureEncoding::BC3;
+		}
+	}
+
+	return TextureEncoding::BC1;
+}
+
+
+void cookTexture(FIBITMAP* bitmap32bpp, TextureEncoding encoding, CompressedTexture& texture) {
+
+	const bool normalMap = (encoding == TextureEncoding::BC5);
+	const size_t blockSize = blockSizeFor(encoding);
+
+	texture.encoding = encoding;
+	texture.internalFormat = internalFormatFor(encoding);
+	texture.levels.clear();
+	texture.data.clear();
+
+	FloatImage image = toFloatImage(bitmap32bpp, normalMap);
+
+	while (true) {
+
+		CompressedMipLevel level;
+
+		level.width = image.width;
+		level.height = image.height;
+		level.offset = texture.data.size();
+		level.size = (size_t)((image.width + 3) / 4) * ((image.height + 3) / 4) * blockSize;
+
+		texture.data.resize(level.offset + level.size);
+		compressLevel(image, encoding, &texture.data[level.offset]);
+
+		texture.levels.push_back(level);
+
+		if (image.width == 1 && image.height == 1)
+			break;
+
+		image = downsample(image, normalMap);
+	}
+}
+
+
+bool loadCookedTexture(const string& sourceFile, FREE_IMAGE_FORMAT srcImageType, CompressedTexture& texture) {
+
+	const string cookedFile = cookedTexturePath(sourceFile);
+
+	uint32_t sourceSize = 0, sourceTimestamp = 0;
+	bool haveSource = sourceFileInfo(sourceFile, sourceSize, sourceTimestamp);
+
+	if (haveSource && readCookedTexture(cookedFile, sourceSize, sourceTimestamp, texture))
+		return true;
+
+	if (!haveSource)
+		return false;
+
+	// Missing or stale - cook from the source image
+	FIBITMAP* loadedBitmap = FreeImage_Load(srcImageType, sourceFile.c_str(), BMP_DEFAULT);
+
+	if (!loadedBitmap) {
+
+		printf("FreeImage: Could not load image %s\n", sourceFile.c_str());
+		return false;
+	}
+
+	FIBITMAP* bitmap32bpp = FreeImage_ConvertTo32Bits(loadedBitmap);
+	FreeImage_Unload(loadedBitmap);
+
+	if (!bitmap32bpp) {
+
+		printf("FreeImage: Conversion to 32 bits unsuccessful for image %s\n", sourceFile.c_str());
+		return false;
+	}
+
+	TextureEncoding encoding = textureEncodingFor(sourceFile, bitmap32bpp);
+
+	cookTexture(bitmap32bpp, encoding, texture);
+	FreeImage_Unload(bitmap32bpp);
+
+	static const char* encodingNames[] = { "BC1", "BC3", "BC5" };
+
+	printf("Texture cooker: %s -> %s, %d mip level(s), %.2f KB\n", sourceFile.c_str(), encodingNames[(int)encoding], (int)texture.levels.size(), (double)texture.data.size() / 1024.0);
+
+	if (!writeCookedTexture(cookedFile, texture, sourceSize, sourceTimestamp))
+		printf("Texture cooker: could not write %s\n", cookedFile.c_str());
+
+	return true;
+}
+
+
+GLuint uploadCompressedTexture(const CompressedTexture& texture) {
+
+	if (texture.levels.empty())
+		return 0;
+
+	GLuint newTexture = 0;
+
+	glGenTextures(1, &newTexture);
+
+	if (newTexture) {
+
+		GLStateCache::bindTextureForUpdate(newTexture);
+
+		for (size_t i = 0; i < texture.levels.size(); ++i) {
+
+			const CompressedMipLevel& level = texture.levels[i];
+
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, texture.internalFormat, level.width, level.height, 0, (GLsizei)level.size, &texture.data[level.offset]);
+		}
+
+		// Trilinear filtering over the cooked mip chain
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+	}
+
+	return newTexture;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "core.h"
+
+// Offline texture cooking.  A source image is converted into a full mip chain (filtered with an SSE 2x2 box filter - in linear light for colour maps and with renormalisation for normal maps) and block compressed:
+//   BC1 (DXT1) - opaque colour maps
+//   BC3 (DXT5) - colour maps with alpha
+//   BC5 (RGTC2) - tangent-space normal maps.  Only x and y are stored - shaders reconstruct z = sqrt(1 - x^2 - y^2)
+// Cooked textures are written next to the source image as <source>.dds.  The file is a standard DDS (FourCC DXT1 / DXT5 / ATI2) except that rows are stored in OpenGL order (bottom row first) so the blocks can be uploaded directly with glCompressedTexImage2D.  The source file's size and timestamp are recorded in the header's reserved words so a stale cooked texture is re-cooked.
+// Normal maps are identified by the asset naming convention - the file name ends in _n (optionally followed by digits), eg. sand_n.bmp, house_n3.bmp.
+
+enum class TextureEncoding : uint8_t {
+
+	BC1,
+	BC3,
+	BC5
+};
+
+struct CompressedMipLevel {
+
+	GLsizei					width = 0;
+	GLsizei					height = 0;
+	size_t					offset = 0; // into CompressedTexture::data
+	size_t					size = 0;
+};
+
+struct CompressedTexture {
+
+	TextureEncoding			encoding = TextureEncoding::BC1;
+	GLenum					internalFormat = 0;
+
+	std::vector<CompressedMipLevel> levels;
+	std::vector<uint8_t>	data;
+};
+
+
+// Enable / disable the cooked texture path in the texture loaders (enabled by default).  Should only be enabled if the GL context supports S3TC
+void enableTextureCooking(bool enable);
+bool textureCookingEnabled();
+
+// Path of the cooked texture for a source image
+std::string cookedTexturePath(const std::string& sourceFile);
+
+// Choose the encoding for a source image (see naming convention above)
+TextureEncoding textureEncodingFor(const std::string& sourceFile, FIBITMAP* bitmap32bpp);
+
+// Generate mips and compress a 32bpp (BGRA) FreeImage bitmap
+void cookTexture(FIBITMAP* bitmap32bpp, TextureEncoding encoding, CompressedTexture& texture);
+
+// Load the cooked version of sourceFile, cooking (and saving) it first if it is missing or out of date.  Returns false if the source image could not be loaded.  No OpenGL calls are made so this can run on a worker thread
+bool loadCookedTexture(const std::string& sourceFile, FREE_IMAGE_FORMAT srcImageType, CompressedTexture& texture);
+
+// Create a mipmapped texture object from a compressed texture
+GLuint uploadCompressedTexture(const CompressedTexture& texture);
@@ -1,5 +1,6 @@
 
 #include "TextureLoader.h"
+#include "GLStateCache.h"
 
 using namespace std;
 
@@ -7,25 +8,58 @@ using namespace std;
 // Utility function to load an image using FreeImage, convert to 32 bits-per-pixel (bpp) and setup and return a new texture object based on this.
 GLuint loadTexture(string filename, FREE_IMAGE_FORMAT srcImageType) {
 
+	DecodedImage image = decodeImage(filename, srcImageType);
+
+	return uploadTexture(image);
+}
+
+
+DecodedImage decodeImage(string filename, FREE_IMAGE_FORMAT srcImageType) {
+
+	DecodedImage image;
+
+	image.filename = filename;
+
+	// Fast path - load the cooked (block compressed, mipmapped) texture
+	if (textureCookingEnabled() && loadCookedTexture(filename, srcImageType, image.compressed))
+		return image;
+
 	// Load and validate bitmap
 	FIBITMAP* loadedBitmap = FreeImage_Load(srcImageType, filename.c_str(), BMP_DEFAULT);
 
 	if (!loadedBitmap) {
 
 		cout << "FreeImage: Could not load image " << filename << endl;
-		return 0;
+		return image;
 	}
 
 	// Comvert to RGBA format
-	FIBITMAP* bitmap32bpp = FreeImage_ConvertTo32Bits(loadedBitmap);
+	image.bitmap = FreeImage_ConvertTo32Bits(loadedBitmap);
 	FreeImage_Unload(loadedBitmap);
 
-	if (!bitmap32bpp) {
-
+	if (!image.bitmap)
 		cout << "FreeImage: Conversion to 32 bits unsuccessful for image " << filename << endl;
-		return 0;
+
+	return image;
+}
+
+
+GLuint uploadTexture(DecodedImage& image) {
+
+	if (image.isCompressed()) {
+
+		GLuint newTexture = uploadCompressedTexture(image.compressed);
+
+		image.compressed = CompressedTexture();
+
+		return newTexture;
 	}
 
+	FIBITMAP* bitmap32bpp = image.bitmap;
+
+	if (!bitmap32bpp)
+		return 0;
+
 	// Image loaded and converted - setup new texture object
 	GLuint newTexture = 0;
 
@@ -34,7 +68,7 @@ GLuint loadTexture(string filename, FREE_IMAGE_FORMAT srcImageType) {
 
 	if (newTexture) {
 
-		glBindTexture(GL_TEXTURE_2D, newTexture);
+		GLStateCache::bindTextureForUpdate(newTexture);
 
 		// Setup texture image properties
 		glTexImage2D(
@@ -48,8 +82,11 @@ GLuint loadTexture(string filename, FREE_IMAGE_FORMAT srcImageType) {
 			GL_UNSIGNED_BYTE,
 			FreeImage_GetBits(bitmap32bpp));
 
+		// Uncompressed fallback (the image has no cooked DDS file, or cooking is disabled) - build the mip chain on the GPU so distant surfaces still sample a mipmap
+		glGenerateMipmap(GL_TEXTURE_2D);
+
 		// Setup texture filter and wrap properties
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
@@ -57,6 +94,18 @@ GLuint loadTexture(string filename, FREE_IMAGE_FORMAT srcImageType) {
 
 	// Once the texture has been setup, the image data is copied into OpenGL.  We no longer need the originally loaded image
 	FreeImage_Unload(bitmap32bpp);
+	image.bitmap = nullptr;
 
 	return newTexture;
-}
\ No newline at end of file
+}
+
+
+size_t DecodedImage::sizeInBytes() const {
+
+	if (isCompressed())
+		return compressed.data.size();
+	else if (bitmap)
+		return (size_t)FreeImage_GetWidth(bitmap) * FreeImage_GetHeight(bitmap) * 4;
+	else
+		return 0;
+}
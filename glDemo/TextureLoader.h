@@ -1,6 +1,30 @@
 #pragma once
 
 #include "core.h"
+#include "TextureCooker.h"
 
 // Helper function for loading texture images from disk and setup a texture with defaut properties
 GLuint loadTexture(std::string filename, FREE_IMAGE_FORMAT srcImageType);
+
+
+// Image loading is split into a CPU-only decode step (safe to run on a worker thread) and a GL upload step that must run on the main thread
+struct DecodedImage {
+
+	std::string			filename;
+	FIBITMAP*			bitmap = nullptr; // 32 bits-per-pixel BGRA, nullptr if the image could not be loaded
+
+	// Block compressed mip chain - used instead of bitmap if texture cooking is enabled (see TextureCooker.h)
+	CompressedTexture	compressed;
+
+	bool isCompressed() const { return !compressed.levels.empty(); }
+	bool valid() const { return bitmap != nullptr || isCompressed(); }
+
+	// Size of the image data that is uploaded
+	size_t sizeInBytes() const;
+};
+
+// Load and convert an image to 32 bits-per-pixel, or load its cooked (compressed) version if texture cooking is enabled.  No OpenGL calls are made
+DecodedImage decodeImage(std::string filename, FREE_IMAGE_FORMAT srcImageType);
+
+// Create a texture object from a decoded image and release the image.  Compressed images are uploaded with their mip chain using glCompressedTexImage2D.  Returns 0 if the image was not decoded
+GLuint uploadTexture(DecodedImage& image);
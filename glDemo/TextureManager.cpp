@@ -0,0 +1,215 @@
+#include "TextureManager.h"
+#include "GLStateCache.h"
+
+using namespace std;
+
+
+map<string, TextureManager::Entry>	TextureManager::entries;
+map<GLuint, string>					TextureManager::textureKeys;
+mutex								TextureManager::entryMutex;
+
+TextureStreamer*					TextureManager::streamer = nullptr;
+
+unsigned int						TextureManager::numHits = 0;
+unsigned int						TextureManager::numMisses = 0;
+size_t								TextureManager::bytesSaved = 0;
+
+
+string TextureManager::keyFor(const string& filename, FREE_IMAGE_FORMAT format) {
+
+	return canonicalAssetPath(filename) + "|" + to_string((int)format);
+}
+
+
+void TextureManager::setStreamer(TextureStreamer* streamer) {
+
+	TextureManager::streamer = streamer;
+}
+
+
+size_t TextureManager::textureSize(Entry& entry) {
+
+	if (entry.sizeInBytes == 0 && entry.texture != 0) {
+
+		GLint width = 0, height = 0, compressed = GL_FALSE, compressedSize = 0;
+
+		GLStateCache::bindTextureForUpdate(entry.texture);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+
+		if (compressed)
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressedSize);
+
+		GLStateCache::bindTexture(0, 0);
+
+		// Don't record the size while the placeholder is still in the texture.  Compressed sizes are for the top mip level only
+		if (width > 1 || height > 1)
+			entry.sizeInBytes = compressed ? (size_t)compressedSize : (size_t)width * height * 4;
+		else
+			return 0;
+	}
+
+	return entry.sizeInBytes;
+}
+
+
+void TextureManager::prefetch(ThreadPool& pool, const string& filename, FREE_IMAGE_FORMAT format) {
+
+	if (streamer)
+		return;
+
+	string key = keyFor(filename, format);
+
+	lock_guard<mutex> lock(entryMutex);
+
+	Entry& entry = entries[key];
+
+	if (entry.texture != 0 || entry.pendingImage.valid())
+		return;
+
+	entry.pendingImage = pool.submit([filename, format]() { return decodeImage(filename, format); }).share();
+}
+
+
+GLuint TextureManager::acquire(const string& filename, FREE_IMAGE_FORMAT format, uint32_t placeholderColour) {
+
+	string key = keyFor(filename, format);
+
+	shared_future<DecodedImage> pendingImage;
+
+	{
+		lock_guard<mutex> lock(entryMutex);
+
+		Entry& entry = entries[key];
+
+		if (entry.texture != 0) {
+
+			entry.refCount++;
+			entry.numHits++;
+
+			numHits++;
+
+			return entry.texture;
+		}
+
+		pendingImage = entry.pendingImage;
+		entry.pendingImage = shared_future<DecodedImage>();
+	}
+
+	numMisses++;
+
+	GLuint texture = 0;
+	size_t sizeInBytes = 0;
+
+	if (!pendingImage.valid() && streamer) {
+
+		texture = streamer->request(filename, format, placeholderColour);
+	}
+	else {
+
+		// Use the prefetched image if there is one, otherwise decode here
+		DecodedImage image = pendingImage.valid() ? pendingImage.get() : decodeImage(filename, format);
+
+		sizeInBytes = image.sizeInBytes();
+
+		texture = uploadTexture(image);
+	}
+
+	lock_guard<mutex> lock(entryMutex);
+
+	if (texture == 0) {
+
+		entries.erase(key);
+		return 0;
+	}
+
+	Entry& entry = entries[key];
+
+	entry.texture = texture;
+	entry.refCount = 1;
+	entry.sizeInBytes = sizeInBytes;
+
+	textureKeys[texture] = key;
+
+	return texture;
+}
+
+
+void TextureManager::addRef(GLuint texture) {
+
+	lock_guard<mutex> lock(entryMutex);
+
+	auto i = textureKeys.find(texture);
+
+	if (i != textureKeys.end())
+		entries[i->second].refCount++;
+}
+
+
+void TextureManager::release(GLuint texture) {
+
+	lock_guard<mutex> lock(entryMutex);
+
+	auto i = textureKeys.find(texture);
+
+	if (i == textureKeys.end())
+		return;
+
+	auto entry = entries.find(i->second);
+
+	if (entry != entries.end() && --entry->second.refCount == 0) {
+
+		bytesSaved += entry->second.numHits * textureSize(entry->second);
+
+		// Don't let a streamed image be uploaded into the deleted (or a reused) texture name
+		if (streamer)
+			streamer->cancel(texture);
+
+		glDeleteTextures(1, &texture);
+		GLStateCache::textureDeleted(texture);
+
+		entries.erase(entry);
+		textureKeys.erase(i);
+	}
+}
+
+
+void TextureManager::discardPrefetched() {
+
+	lock_guard<mutex> lock(entryMutex);
+
+	for (auto i = entries.begin(); i != entries.end();) {
+
+		Entry& entry = i->second;
+
+		if (entry.pendingImage.valid()) {
+
+			// The image is never uploaded so uploadTexture won't free it
+			FIBITMAP* bitmap = entry.pendingImage.get().bitmap;
+
+			if (bitmap)
+				FreeImage_Unload(bitmap);
+
+			entry.pendingImage = shared_future<DecodedImage>();
+		}
+
+		if (entry.texture == 0)
+			i = entries.erase(i);
+		else
+			++i;
+	}
+}
+
+
+void TextureManager::reportStats() {
+
+	lock_guard<mutex> lock(entryMutex);
+
+	size_t totalSaved = bytesSaved;
+
+	for (auto i = entries.begin(); i != entries.end(); ++i)
+		totalSaved += i->second.numHits * textureSize(i->second);
+
+	printf("TextureManager: %u hit(s), %u miss(es), %.2f MB of decoding / texture memory saved, %u texture(s) loaded\n", numHits, numMisses, (double)totalSaved / (1024.0 * 1024.0), (unsigned int)textureKeys.size());
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "core.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+
+// Shared texture objects keyed by canonical image path and load parameters.  Loading the same image more than once returns the existing texture (with its reference count incremented) instead of decoding and uploading it again.  Textures are deleted when their reference count drops to zero.
+// acquire / release must be called on the main (GL) thread.  prefetch can be used to decode images on a thread pool ahead of acquire - an image that is already loaded or being decoded is not decoded again.  If a texture streamer is set, images that were not prefetched are streamed instead - acquire returns a placeholder texture immediately and the image is uploaded into it when it has been decoded.
+
+class TextureManager {
+
+	struct Entry {
+
+		GLuint								texture = 0;
+		unsigned int						refCount = 0;
+		unsigned int						numHits = 0;
+		size_t								sizeInBytes = 0; // 0 = not known yet (streamed texture)
+
+		// Decode queued by prefetch and not yet uploaded
+		std::shared_future<DecodedImage>	pendingImage;
+	};
+
+	static std::map<std::string, Entry>		entries;
+
+	// Reverse lookup of managed textures
+	static std::map<GLuint, std::string>	textureKeys;
+
+	static std::mutex						entryMutex;
+
+	static TextureStreamer*					streamer;
+
+	// Statistics
+	static unsigned int						numHits;
+	static unsigned int						numMisses;
+	static size_t							bytesSaved; // for textures that have been deleted
+
+	static std::string keyFor(const std::string& filename, FREE_IMAGE_FORMAT format);
+
+	// Size of a texture's image - queried from OpenGL for streamed textures
+	static size_t textureSize(Entry& entry);
+
+public:
+
+	// Stream textures that have not been prefetched through streamer (nullptr = load synchronously)
+	static void setStreamer(TextureStreamer* streamer);
+
+	// Queue a decode of the image on pool if it is not already loaded or queued.  Does nothing if textures are being streamed
+	static void prefetch(ThreadPool& pool, const std::string& filename, FREE_IMAGE_FORMAT format);
+
+	// Return a texture for the image, loading it if needed.  Returns 0 if the image could not be loaded.  A streamed texture holds placeholderColour until the image is resident.  Each successful acquire must be matched by a call to release
+	static GLuint acquire(const std::string& filename, FREE_IMAGE_FORMAT format, uint32_t placeholderColour = TexturePlaceholder_Grey);
+
+	// Add a reference to a texture returned by acquire.  Textures not created by the manager are ignored
+	static void addRef(GLuint texture);
+
+	// Release a reference to a texture.  The texture is deleted when no references remain.  Textures not created by the manager are ignored
+	static void release(GLuint texture);
+
+	// Free the images of prefetches that were never acquired, waiting for any that are still being decoded.  Call once loading is done (or at shutdown) - the decoded bitmaps are otherwise never freed
+	static void discardPrefetched();
+
+	static void reportStats();
+};
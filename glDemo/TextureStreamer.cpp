@@ -0,0 +1,417 @@
+#include "TextureStreamer.h"
+#include "TextureCooker.h"
+#include "GLStateCache.h"
+
+using namespace std;
+
+
+bool TextureStreamer::isSupported() {
+
+	return (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) && (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+}
+
+
+TextureStreamer::TextureStreamer(GLuint numSlots, GLsizeiptr slotSize, unsigned int numDecodeThreads) : numPending(0) {
+
+	this->slotSize = slotSize;
+
+	decodeThreads = new ThreadPool(numDecodeThreads);
+
+	const GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	// One buffer divided into numSlots slots, mapped for the lifetime of the streamer
+	glGenBuffers(1, &pixelBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, slotSize * numSlots, nullptr, mapFlags);
+
+	mappedPixels = (GLubyte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slotSize * numSlots, mapFlags);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (!mappedPixels) {
+
+		cout << "TextureStreamer: could not map pixel buffer - textures will be uploaded directly\n";
+		numSlots = 0;
+	}
+
+	slots.resize(numSlots);
+
+	for (GLuint i = 0; i < numSlots; ++i) {
+
+		slots[i].offset = slotSize * i;
+		freeSlots.push_back((int)i);
+	}
+}
+
+
+TextureStreamer::~TextureStreamer() {
+
+	// Wake any workers waiting for a slot so the decode threads can finish
+	{
+		lock_guard<mutex> lock(streamMutex);
+		stopping = true;
+	}
+
+	slotAvailable.notify_all();
+
+	delete decodeThreads;
+
+	for (ReadyUpload& upload : readyUploads) {
+
+		if (upload.bitmap)
+			FreeImage_Unload(upload.bitmap);
+	}
+
+	for (UploadSlot& slot : slots) {
+
+		if (slot.fence)
+			glDeleteSync(slot.fence);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+
+	if (mappedPixels)
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &pixelBuffer);
+}
+
+
+GLuint TextureStreamer::request(const string& filename, FREE_IMAGE_FORMAT format, uint32_t placeholderColour) {
+
+	GLuint texture = 0;
+
+	glGenTextures(1, &texture);
+
+	if (!texture)
+		return 0;
+
+	// 0xAARRGGBB is stored as bytes B, G, R, A
+	GLStateCache::bindTextureForUpdate(texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_BGRA, GL_UNSIGNED_BYTE, &placeholderColour);
+
+	// Same wrap properties as loadTexture.  The min filter switches to mipmapped once the image and its mip chain are uploaded
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+
+	numPending++;
+
+	const unsigned int requestID = nextRequestID++;
+	activeRequests[texture] = requestID;
+
+	decodeThreads->submit([this, texture, requestID, filename, format]() { decode(texture, requestID, filename, format); });
+
+	return texture;
+}
+
+
+bool TextureStreamer::copyTo32Bits(FIBITMAP* bitmap, GLubyte* dest) {
+
+	if (FreeImage_GetImageType(bitmap) != FIT_BITMAP)
+		return false;
+
+	const unsigned int width = FreeImage_GetWidth(bitmap);
+	const unsigned int height = FreeImage_GetHeight(bitmap);
+	const unsigned int bpp = FreeImage_GetBPP(bitmap);
+
+	if (bpp != 8 && bpp != 24 && bpp != 32)
+		return false;
+
+	RGBQUAD* palette = FreeImage_GetPalette(bitmap);
+
+	if (bpp == 8 && !palette)
+		return false;
+
+	// Scanlines are stored bottom-up in FreeImage and in the texture so rows can be copied in order
+	for (unsigned int y = 0; y < height; ++y) {
+
+		BYTE* src = FreeImage_GetScanLine(bitmap, (int)y);
+		BYTE* dst = dest + (size_t)y * width * 4;
+
+		if (bpp == 32)
+			memcpy(dst, src, (size_t)width * 4);
+		else if (bpp == 24)
+			FreeImage_ConvertLine24To32(dst, src, (int)width);
+		else
+			FreeImage_ConvertLine8To32(dst, src, (int)width, palette);
+	}
+
+	return true;
+}
+
+
+int TextureStreamer::acquireSlot() {
+
+	unique_lock<mutex> lock(streamMutex);
+
+	if (freeSlots.empty() && !stopping)
+		numSlotStalls++;
+
+	slotAvailable.wait(lock, [this]() { return stopping || !freeSlots.empty(); });
+
+	if (stopping)
+		return -1;
+
+	int slot = freeSlots.back();
+	freeSlots.pop_back();
+
+	return slot;
+}
+
+
+void TextureStreamer::releaseSlot(int slot) {
+
+	{
+		lock_guard<mutex> lock(streamMutex);
+		freeSlots.push_back(slot);
+	}
+
+	slotAvailable.notify_one();
+}
+
+
+void TextureStreamer::decode(GLuint texture, unsigned int requestID, string filename, FREE_IMAGE_FORMAT format) {
+
+	ReadyUpload upload;
+
+	upload.texture = texture;
+	upload.requestID = requestID;
+
+	// Cooked textures - copy the compressed mip chain into a slot
+	if (textureCookingEnabled() && loadCookedTexture(filename, format, upload.compressed)) {
+
+		const CompressedMipLevel& level0 = upload.compressed.levels[0];
+
+		upload.width = level0.width;
+		upload.height = level0.height;
+
+		if ((GLsizeiptr)upload.compressed.data.size() <= slotSize && !slots.empty()) {
+
+			upload.slot = acquireSlot();
+
+			if (upload.slot < 0) {
+
+				numPending--;
+				return;
+			}
+
+			memcpy(mappedPixels + slots[upload.slot].offset, upload.compressed.data.data(), upload.compressed.data.size());
+
+			// Only the level layout is needed now
+			upload.compressed.data = vector<uint8_t>();
+		}
+
+		lock_guard<mutex> lock(streamMutex);
+		readyUploads.push_back(std::move(upload));
+
+		return;
+	}
+
+	FIBITMAP* loadedBitmap = FreeImage_Load(format, filename.c_str(), BMP_DEFAULT);
+
+	if (!loadedBitmap) {
+
+		// The texture keeps its placeholder
+		printf("FreeImage: Could not load image %s\n", filename.c_str());
+		numPending--;
+		return;
+	}
+
+	upload.width = (GLsizei)FreeImage_GetWidth(loadedBitmap);
+	upload.height = (GLsizei)FreeImage_GetHeight(loadedBitmap);
+
+	const GLsizeiptr imageSize = (GLsizeiptr)upload.width * upload.height * 4;
+
+	bool streamed = false;
+
+	if (imageSize <= slotSize && !slots.empty()) {
+
+		upload.slot = acquireSlot();
+
+		if (upload.slot < 0) {
+
+			FreeImage_Unload(loadedBitmap);
+			numPending--;
+			return;
+		}
+
+		streamed = copyTo32Bits(loadedBitmap, mappedPixels + slots[upload.slot].offset);
+
+		if (!streamed) {
+
+			// Unsupported format - give the slot back
+			releaseSlot(upload.slot);
+			upload.slot = -1;
+		}
+	}
+
+	if (streamed) {
+
+		FreeImage_Unload(loadedBitmap);
+	}
+	else {
+
+		upload.bitmap = FreeImage_ConvertTo32Bits(loadedBitmap);
+		FreeImage_Unload(loadedBitmap);
+
+		if (!upload.bitmap) {
+
+			printf("FreeImage: Conversion to 32 bits unsuccessful for image %s\n", filename.c_str());
+			numPending--;
+			return;
+		}
+	}
+
+	lock_guard<mutex> lock(streamMutex);
+	readyUploads.push_back(std::move(upload));
+}
+
+
+void TextureStreamer::recycleSlots() {
+
+	for (size_t i = 0; i < inFlightSlots.size();) {
+
+		UploadSlot& slot = slots[inFlightSlots[i]];
+
+		// Poll without waiting
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+
+			releaseSlot(inFlightSlots[i]);
+
+			inFlightSlots[i] = inFlightSlots.back();
+			inFlightSlots.pop_back();
+		}
+		else {
+
+			++i;
+		}
+	}
+}
+
+
+void TextureStreamer::cancel(GLuint texture) {
+
+	activeRequests.erase(texture);
+}
+
+
+void TextureStreamer::update() {
+
+	recycleSlots();
+
+	vector<ReadyUpload> uploads;
+
+	{
+		lock_guard<mutex> lock(streamMutex);
+		uploads.swap(readyUploads);
+	}
+
+	if (uploads.empty())
+		return;
+
+	for (ReadyUpload& upload : uploads) {
+
+		auto request = activeRequests.find(upload.texture);
+
+		// Cancelled - nothing has been issued from the slot so it can be reused straight away
+		if (request == activeRequests.end() || request->second != upload.requestID) {
+
+			if (upload.slot >= 0)
+				releaseSlot(upload.slot);
+
+			if (upload.bitmap)
+				FreeImage_Unload(upload.bitmap);
+
+			numPending--;
+			continue;
+		}
+
+		activeRequests.erase(request);
+
+		GLStateCache::bindTextureForUpdate(upload.texture);
+
+		if (upload.slot >= 0)
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+
+		if (!upload.compressed.levels.empty()) {
+
+			const CompressedTexture& compressed = upload.compressed;
+
+			// Level data is either in the slot (pointer = offset into the PBO) or in the upload
+			for (size_t i = 0; i < compressed.levels.size(); ++i) {
+
+				const CompressedMipLevel& level = compressed.levels[i];
+				const GLvoid* levelData = (upload.slot >= 0) ? (const GLvoid*)(slots[upload.slot].offset + level.offset) : (const GLvoid*)&compressed.data[level.offset];
+
+				glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, compressed.internalFormat, level.width, level.height, 0, (GLsizei)level.size, levelData);
+
+				bytesStreamed += level.size;
+			}
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)compressed.levels.size() - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		}
+		else if (upload.slot >= 0) {
+
+			// Allocate the full size image then copy from the slot - the copy is queued on the GPU and does not block
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, upload.width, upload.height, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, upload.width, upload.height, GL_BGRA, GL_UNSIGNED_BYTE, (const GLvoid*)slots[upload.slot].offset);
+
+			// Uncompressed fallback - there is no cooked mip chain so build one on the GPU
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+			bytesStreamed += (size_t)upload.width * upload.height * 4;
+		}
+		else {
+
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, upload.width, upload.height, 0, GL_BGRA, GL_UNSIGNED_BYTE, FreeImage_GetBits(upload.bitmap));
+			FreeImage_Unload(upload.bitmap);
+
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+			bytesStreamed += (size_t)upload.width * upload.height * 4;
+		}
+
+		if (upload.slot >= 0) {
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			UploadSlot& slot = slots[upload.slot];
+
+			slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			inFlightSlots.push_back(upload.slot);
+
+			numStreamed++;
+		}
+		else {
+
+			numDirect++;
+		}
+
+		numPending--;
+	}
+
+	GLStateCache::bindTexture(0, 0);
+}
+
+
+bool TextureStreamer::idle() const {
+
+	return numPending == 0;
+}
+
+
+void TextureStreamer::reportStats() {
+
+	printf("TextureStreamer: %u texture(s) streamed through %u PBO slot(s), %u uploaded directly, %.2f MB total, %u decode(s) waited for a free slot\n", numStreamed, (unsigned int)slots.size(), numDirect, (double)bytesStreamed / (1024.0 * 1024.0), numSlotStalls);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "core.h"
+#include "ThreadPool.h"
+#include "TextureCooker.h"
+#include <atomic>
+
+// Asynchronous texture loading through a ring of pixel buffer object (PBO) slots.  request returns a texture immediately that holds a 1x1 placeholder colour.  The image is decoded on the streamer's own worker threads straight into a free slot of a persistently mapped PBO (converting each scanline to 32bpp as it is copied, so there is no second full-image copy), and update (called once per frame on the main thread) issues the glTexSubImage2D from the PBO and fences the slot.  A slot is only reused once its fence has signalled, so neither the main thread nor the GPU wait on each other.
+// If texture cooking is enabled the cooked (block compressed) mip chain is streamed instead of the source image.  Images too large for a slot, or in formats that cannot be converted per scanline, are converted on the worker and uploaded directly by update instead.  Requires GL 4.4 / ARB_buffer_storage - check isSupported before creating a streamer.
+
+// Placeholder colours (0xAARRGGBB)
+const uint32_t TexturePlaceholder_Grey = 0xFF808080;
+const uint32_t TexturePlaceholder_FlatNormal = 0xFF8080FF;
+
+class TextureStreamer {
+
+	struct UploadSlot {
+
+		GLintptr					offset = 0;
+		GLsync						fence = 0;
+	};
+
+	// A decoded image waiting for update to copy it into its texture
+	struct ReadyUpload {
+
+		GLuint						texture = 0;
+		unsigned int				requestID = 0;
+		int							slot = -1; // -1 = not in the PBO, upload from bitmap
+		GLsizei						width = 0;
+		GLsizei						height = 0;
+		FIBITMAP*					bitmap = nullptr;
+
+		// Cooked textures - the mip level layout (and the data if it is not in a slot)
+		CompressedTexture			compressed;
+	};
+
+	GLuint							pixelBuffer = 0;
+	GLubyte*						mappedPixels = nullptr;
+	GLsizeiptr						slotSize = 0;
+
+	std::vector<UploadSlot>			slots;
+
+	// Slots available to the workers and slots waiting for their fence (main thread only)
+	std::vector<int>				freeSlots;
+	std::vector<int>				inFlightSlots;
+
+	std::vector<ReadyUpload>		readyUploads;
+
+	// Texture -> ID of the request that will upload into it (main thread only).  Uploads whose request is no longer listed were cancelled - their texture may have been deleted and its name reused
+	std::map<GLuint, unsigned int>	activeRequests;
+	unsigned int					nextRequestID = 1;
+
+	std::mutex						streamMutex;
+	std::condition_variable			slotAvailable;
+	bool							stopping = false;
+
+	std::atomic<unsigned int>		numPending;
+
+	// Statistics
+	unsigned int					numStreamed = 0;
+	unsigned int					numDirect = 0;
+	unsigned int					numSlotStalls = 0;
+	size_t							bytesStreamed = 0;
+
+	ThreadPool*						decodeThreads = nullptr;
+
+	// Worker job - decode filename into a slot (or bitmap) and queue it for upload
+	void decode(GLuint texture, unsigned int requestID, std::string filename, FREE_IMAGE_FORMAT format);
+
+	// Copy a bitmap into 32bpp BGRA rows at dest.  Returns false if the bitmap's format is not supported
+	static bool copyTo32Bits(FIBITMAP* bitmap, GLubyte* dest);
+
+	// Wait for a free slot.  Returns -1 if the streamer is being destroyed
+	int acquireSlot();
+	void releaseSlot(int slot);
+
+	void recycleSlots();
+
+public:
+
+	static bool isSupported();
+
+	TextureStreamer(GLuint numSlots = 4, GLsizeiptr slotSize = 16 * 1024 * 1024, unsigned int numDecodeThreads = 2);
+	~TextureStreamer();
+
+	// Create a texture holding placeholderColour and queue filename to be streamed into it
+	GLuint request(const std::string& filename, FREE_IMAGE_FORMAT format, uint32_t placeholderColour = TexturePlaceholder_Grey);
+
+	// Cancel a texture's pending upload.  Call before deleting a texture returned by request - the decode still runs but update discards its result
+	void cancel(GLuint texture);
+
+	// Upload decoded images and recycle slots whose uploads have completed.  Call once per frame on the main thread
+	void update();
+
+	// True if there are no textures waiting to be decoded or uploaded
+	bool idle() const;
+
+	void reportStats();
+};
@@ -0,0 +1,57 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+
+ThreadPool::ThreadPool(unsigned int numThreads) {
+
+	if (numThreads == 0) {
+
+		unsigned int numCores = thread::hardware_concurrency();
+
+		numThreads = (numCores > 1) ? numCores - 1 : 1;
+	}
+
+	workers.reserve(numThreads);
+
+	for (unsigned int i = 0; i < numThreads; ++i)
+		workers.push_back(thread(&ThreadPool::workerLoop, this));
+}
+
+
+ThreadPool::~ThreadPool() {
+
+	{
+		lock_guard<mutex> lock(jobMutex);
+		stopping = true;
+	}
+
+	jobAvailable.notify_all();
+
+	for (thread& worker : workers)
+		worker.join();
+}
+
+
+void ThreadPool::workerLoop() {
+
+	while (true) {
+
+		function<void()> job;
+
+		{
+			unique_lock<mutex> lock(jobMutex);
+
+			jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+			// Drain the queue before stopping
+			if (jobs.empty())
+				return;
+
+			job = move(jobs.front());
+			jobs.pop_front();
+		}
+
+		job();
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Standard library only (not core.h) so the pool can be used by code that is built without OpenGL, such as OcclusionRasterizer
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <deque>
+
+// Fixed size pool of worker threads for CPU-side jobs (asset parsing, image decoding etc).  Jobs must not make any OpenGL calls - the GL context is only current on the main thread, so any results that need uploading are returned to the main thread through the job's future.
+
+class ThreadPool {
+
+	std::vector<std::thread>			workers;
+	std::deque<std::function<void()>>	jobs;
+
+	std::mutex							jobMutex;
+	std::condition_variable				jobAvailable;
+	bool								stopping = false;
+
+	void workerLoop();
+
+public:
+
+	// numThreads = 0 uses one thread per hardware core (less one for the main thread)
+	ThreadPool(unsigned int numThreads = 0);
+
+	// Waits for queued jobs to finish before joining the workers
+	~ThreadPool();
+
+	unsigned int numThreads() const { return (unsigned int)workers.size(); }
+
+	// Queue a job and return a future for its result
+	template <typename F>
+	std::future<typename std::result_of<F()>::type> submit(F job) {
+
+		typedef typename std::result_of<F()>::type ResultType;
+
+		// std::function needs a copyable callable so share the packaged_task
+		auto task = std::make_shared<std::packaged_task<ResultType()>>(job);
+		std::future<ResultType> result = task->get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			jobs.push_back([task]() { (*task)(); });
+		}
+
+		jobAvailable.notify_one();
+
+		return result;
+	}
+};
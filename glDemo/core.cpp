@@ -1 +1,21 @@
-#include "core.h"
\ No newline at end of file
+#include "core.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+string canonicalAssetPath(const string& path) {
+
+	char fullPath[MAX_PATH];
+
+	DWORD length = GetFullPathNameA(path.c_str(), MAX_PATH, fullPath, nullptr);
+
+	// Fall back to the path as given if it cannot be resolved
+	string result = (length > 0 && length < MAX_PATH) ? string(fullPath, length) : path;
+
+	// Windows paths are case insensitive
+	transform(result.begin(), result.end(), result.begin(), [](char c) { return (c == '/') ? '\\' : (char)tolower((unsigned char)c); });
+
+	return result;
+}
@@ -10,6 +10,9 @@
 #pragma comment(lib,"lib\\assimp-vc143-mt.lib")
 
 #define GLEW_STATIC
+
+// Stop Windows.h defining min / max macros (these break std::min / std::max / glm::min / glm::max)
+#define NOMINMAX
 #include "GL/glew.h" 
 #include "GLFW/glfw3.h"
 
@@ -34,4 +37,8 @@
 #include <FreeImage\FreeImage.h>
 #include <assimp\cimport.h>			// Main C import interface
 #include <assimp\scene.h>			// Output data structure
-#include <assimp\postprocess.h>		// Post processing flags
\ No newline at end of file
+#include <assimp\postprocess.h>		// Post processing flags
+
+
+// Return a canonical form of an asset path (absolute, lower case, '\\' separators) so the same file referenced by different relative paths maps to one key
+std::string canonicalAssetPath(const std::string& path);
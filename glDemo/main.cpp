@@ -4,52 +4,66 @@
 #include "ArcballCamera.h"
 #include "GUClock.h"
 #include "AIMesh.h"
+#include "SceneCache.h"
+#include "GeometryArena.h"
+#include "ThreadPool.h"
+#include "TextureManager.h"
+#include "TextureStreamer.h"
+#include "TextureCooker.h"
+#include "RenderQueue.h"
+#include "GLStateCache.h"
+#include "InstanceBuffer.h"
+#include "IndirectDrawBuffer.h"
+#include "Lights.h"
+#include "LightBuffer.h"
+#include "GPUTimer.h"
+#include "ClusteredLights.h"
+#include "DeferredRenderer.h"
+#include "CameraBuffer.h"
+#include "DynamicRingBuffer.h"
+#include "BVH.h"
+#include "OcclusionCuller.h"
+#include "OcclusionRasterizer.h"
+#include <chrono>
 
 
 using namespace std;
 using namespace glm;
 
 
-struct DirectionalLight {
+// A model and the transforms it is drawn with
+struct SceneModel {
 
-	vec3 direction;
-	vec3 colour;
-	
-	DirectionalLight() {
-
-		direction = vec3(0.0f, 1.0f, 0.0f); // default to point upwards
-		colour = vec3(1.0f, 1.0f, 1.0f);
-	}
-
-	DirectionalLight(vec3 direction, vec3 colour = vec3(1.0f, 1.0f, 1.0f)) {
-
-		this->direction = direction;
-		this->colour = colour;
-	}
-};
+	vector<AIMesh*>		meshes;
+	RenderPass			pass;
+	vector<mat4>		placements;
+	GLuint				firstInstance; // of the placements in the instance buffer
 
-struct PointLight {
+	// Models whose sub-meshes share a VAO and textures are drawn with one multi-draw indirect call
+	bool				multiDraw;
+	GLuint				firstCommand; // of the model's commands in the indirect draw buffer (one per placement per sub-mesh are reserved)
 
-	vec3 pos;
-	vec3 colour;
-	vec3 attenuation; // x=constant, y=linear, z=quadratic
+	GLuint				firstBox; // of the model's mesh boxes in sceneBoxes (placement * meshes + mesh)
 
-	PointLight() {
+	// Opaque models in the geometry arena are drawn one object (mesh and placement) per command by the occlusion culler
+	bool				occlusionCulled;
+	GLuint				firstObject; // of the model's objects in the occlusion culler (mesh * placements + placement)
 
-		pos = vec3(0.0f, 0.0f, 0.0f);
-		colour = vec3(1.0f, 1.0f, 1.0f);
-		attenuation = vec3(1.0f, 1.0f, 1.0f);
-	}
+	// Copies of the meshes (at full detail, see meshOccluder) drawn into the software occlusion buffer at each placement (empty if the model doesn't hide anything)
+	vector<OccluderMesh> occluders;
+};
 
-	PointLight(vec3 pos, vec3 colour = vec3(1.0f, 1.0f, 1.0f), vec3 attenuation = vec3(1.0f, 1.0f, 1.0f)) {
+// Consecutive visible placements of a sub-mesh that select the same level of detail - drawn as one range of instances
+struct LODRun {
 
-		this->pos = pos;
-		this->colour = colour;
-		this->attenuation = attenuation;
-	}
+	GLuint				firstPlacement;
+	GLuint				numPlacements;
+	GLuint				lod;
+	float				viewDepth; // of the nearest placement in the run
 };
 
 
+
 #pragma region Global variables
 
 // Window size
@@ -73,6 +87,37 @@ bool				leftPressed;
 bool				rightPressed;
 
 
+// Vertex buffer layout used for all scene meshes (VertexFormat::Separate uses the original full float buffers)
+VertexFormat		meshVertexFormat = VertexFormat::Packed;
+
+// Shared vertex / index buffers for all packed meshes (drawn from a single VAO).  Set useGeometryArena to false to give each mesh its own VAO and buffers
+bool				useGeometryArena = true;
+GeometryArena*		geometryArena = nullptr;
+
+// Stream textures through a PBO ring (meshes show a placeholder until their textures are resident).  Only used if the GL context supports persistent mapped buffers
+bool				useTextureStreaming = true;
+TextureStreamer*	textureStreamer = nullptr;
+
+// Load textures from cooked (mipmapped, block compressed) DDS files, cooking them on first use.  Only used if the GL context supports S3TC
+bool				useTextureCooking = true;
+
+// Number of worker threads used to load assets at startup (0 = one per core, less one for the main thread)
+unsigned int		numAssetLoadThreads = 0;
+
+// Draws for the current frame, sorted to minimise state changes
+RenderQueue*		renderQueue = nullptr;
+
+// Model transforms of every placement, read by the shaders through each draw's base instance.  Needs GL 4.2 / ARB_base_instance
+InstanceBuffer*		instanceBuffer = nullptr;
+
+// Draw all the sub-meshes of a model with one multi-draw indirect call.  Needs the geometry arena and instancing (per-draw transforms come from the instance buffer), and GL 4.3 / ARB_multi_draw_indirect
+bool				useMultiDrawIndirect = true;
+IndirectDrawBuffer*	indirectDrawBuffer = nullptr;
+
+// The buildings and robot are repeated on a townSize x townSize grid, townSpacing apart (1 = the original scene)
+unsigned int		townSize = 1;
+float				townSpacing = 8.0f;
+
 // Scene objects
 AIMesh*				terrainMesh = nullptr;
 AIMesh*				waterMesh = nullptr;
@@ -83,7 +128,36 @@ vector<AIMesh*> tier2Model = vector<AIMesh*>();
 vector<AIMesh*> tier3Model = vector<AIMesh*>();
 vector<AIMesh*> robot = vector<AIMesh*>();
 
-// Shaders
+// Everything drawn in the scene
+vector<SceneModel> sceneModels;
+
+// Frustum culling - the world space box of every mesh of every placement is tested against the camera frustum before the scene is queued.  Toggled with F
+bool				useFrustumCulling = true;
+BoxList				sceneBoxes;
+vector<uint8_t>		cullVisible; // 1 per box in sceneBoxes
+Frustum				sceneFrustum; // planes extracted from sceneFrustumViewProj - only rebuilt when the camera's view or projection changes
+mat4				sceneFrustumViewProj = mat4(0.0f);
+vector<LODRun>		lodRuns; // of the sub-mesh being submitted
+
+// Bounding volume hierarchy over sceneBoxes so culling can reject or accept groups of meshes with one test.  Toggled with V (off = test every box)
+bool				useSceneBVH = true;
+BVH*				sceneBVH = nullptr;
+GLuint				numMeshesVisible = 0; // mesh instances queued by the last submitScene
+GLuint				numMeshesCulled = 0; // mesh instances skipped by the last submitScene
+
+// Two phase GPU occlusion culling of the opaque models - draws last frame's visible objects, then tests the rest against a Hi-Z pyramid of that depth.  Needs the geometry arena, instancing and GL 4.3.  Toggled with O
+bool				useOcclusionCulling = true;
+OcclusionCuller*	occlusionCuller = nullptr;
+
+// CPU occlusion culling for when reading back from the GPU isn't an option - position-only copies of the terrain and buildings are rasterized into a small depth buffer on occlusionThreads and every box that passed frustum culling is tested against it.  Toggled with C
+bool				useSoftwareOcclusion = true;
+const int			occlusionBufferWidth = 320;
+const int			occlusionBufferHeight = 192;
+ThreadPool*			occlusionThreads = nullptr;
+OcclusionRasterizer* occlusionRasterizer = nullptr;
+GLuint				numMeshesOccluded = 0; // by the software occlusion test in the last submitScene
+
+// Shaders.  The scene is only drawn instanced - every program reads its model and normal matrices from the instance buffer
 
 // Basic colour shader
 GLuint				basicShader;
@@ -92,14 +166,34 @@ GLint				basicShader_mvpMatrix;
 //  *** normal mapping *** Normal mapped texture with Directional light
 // This is the same as the texture direct light shader above, but with the addtional uniform variable
 // to set the normal map sampler2D variable in the fragment shader.
-GLuint				nMapDirLightShader;
-GLint				nMapDirLightShader_modelMatrix;
-GLint				nMapDirLightShader_viewMatrix;
-GLint				nMapDirLightShader_projMatrix;
-GLint				nMapDirLightShader_diffuseTexture;
-GLint				nMapDirLightShader_normalMapTexture;
-GLint				nMapDirLightShader_lightDirection;
-GLint				nMapDirLightShader_lightColour;
+GLuint				nMapDirLightInstancedShader;
+GLint				nMapDirLightInstancedShader_diffuseTexture;
+GLint				nMapDirLightInstancedShader_normalMapTexture;
+GLint				nMapDirLightInstancedShader_lightDirection;
+GLint				nMapDirLightInstancedShader_lightColour;
+
+// Reference version of the normal mapped directional light shader that inverts the model matrix for every vertex instead of reading the normal matrix calculated on the CPU - only drawn by the vertex benchmark
+GLuint				nMapDirLightReferenceInstancedShader;
+GLint				nMapDirLightReferenceInstancedShader_lightDirection;
+GLint				nMapDirLightReferenceInstancedShader_lightColour;
+
+// Normal mapped shader that shades every light in the light buffer in a single pass
+GLuint				nMapMultiLightInstancedShader;
+GLint				nMapMultiLightInstancedShader_diffuseTexture;
+GLint				nMapMultiLightInstancedShader_normalMapTexture;
+
+// Normal mapped clustered forward shader - point lights are read from the light lists of the fragment's cluster
+GLuint				nMapClusteredInstancedShader;
+GLint				nMapClusteredInstancedShader_diffuseTexture;
+GLint				nMapClusteredInstancedShader_normalMapTexture;
+
+// Normal mapped G-buffer shader for deferred shading - writes albedo and an octahedral encoded normal
+GLuint				nMapGBufferInstancedShader;
+GLint				nMapGBufferInstancedShader_diffuseTexture;
+GLint				nMapGBufferInstancedShader_normalMapTexture;
+
+// Position only shader for the depth pre-pass
+GLuint				depthOnlyInstancedShader;
 
 // camera
 vec3 cameraPos = vec3(2.0f, 0.0f, 0.0f);
@@ -119,6 +213,64 @@ PointLight lights[1] = {
 
 bool rotateDirectionalLight = false;
 
+// How renderWithMultipleLights shades the lights.  Cycled with L
+enum class LightingMethod {
+
+	MultiPass = 0,	// one additive pass per light
+	SinglePass,		// all lights in one pass from the light buffer (up to LightBuffer::maxPointLights point lights)
+	Clustered,		// directional lights from the light buffer, point lights from the clusters they were binned into
+	Deferred,		// one geometry pass into a G-buffer, then directional lights in a full screen pass and point lights as light volumes
+
+	NumMethods
+};
+
+// Renderer used at startup - set to LightingMethod::Deferred to start with deferred shading
+LightingMethod		lightingMethod = LightingMethod::Clustered;
+CameraBuffer*		cameraBuffer = nullptr;
+LightBuffer*		lightBuffer = nullptr;
+ClusteredLights*	clusteredLights = nullptr;
+DeferredRenderer*	deferredRenderer = nullptr;
+
+// Persistently mapped ring the per-frame camera, light and cluster data is written into (if GL 4.4 / ARB_buffer_storage is available).  Stalls waiting for the GPU are shown in the window title
+bool				useDynamicRing = true;
+const GLsizeiptr	dynamicRingRegionSize = 4 * 1024 * 1024;
+DynamicRingBuffer*	dynamicRing = nullptr;
+
+// Street lights spread over the town for the multiple light scene.  Toggled with K
+unsigned int		numStreetLights = 256;
+vector<PointLight>	streetLights;
+bool				showStreetLights = true;
+
+// Render the multiple light scene instead of the single light and transparency scene.  Toggled with M
+bool				showMultipleLights = false;
+
+// GPU time of renderScene
+GPUTimer*			sceneTimer = nullptr;
+
+// Depth pre-pass for the forward renderers (not multi-pass or deferred) - the opaque draws are drawn depth only first, then shaded with depth writes off and GL_EQUAL so hidden fragments aren't shaded.  Toggled with P.  The GPU time of each pass is shown in the title
+bool				useDepthPrepass = false;
+bool				forwardSceneDrawn = false; // by executeForwardScene this frame (so the pass timers are current)
+GPUTimer*			prepassTimer = nullptr;
+GPUTimer*			shadingTimer = nullptr;
+
+// Lighting benchmark (started with B) - renders the multiple light scene lit by each number of street lights using each lighting method in turn, timing lightBenchmarkFrames frames of each (after lightBenchmarkWarmup frames).  Single pass lighting is skipped for counts above LightBuffer::maxPointLights, as it can't shade them all
+const unsigned int	lightBenchmarkCounts[] = { 1, 8, 64, 256, 1024 };
+const char* const	lightBenchmarkMethodNames[] = { "multi-pass ", "single pass", "clustered  ", "deferred   " };
+const unsigned int	lightBenchmarkFrames = 120;
+const unsigned int	lightBenchmarkWarmup = 10;
+int					lightBenchmarkStage = -1; // -1 = not running.  Light count index * LightingMethod::NumMethods + method
+unsigned int		lightBenchmarkFrame = 0;
+double				lightBenchmarkCPUTime = 0.0;
+
+// Vertex benchmark (started with N) - renders the single light scene at full detail with the normal matrix calculated per vertex by the reference shaders, then with the normal matrices calculated on the CPU when the instance buffer is uploaded, timing lightBenchmarkFrames frames of each (after lightBenchmarkWarmup frames)
+int					vertexBenchmarkStage = -1; // -1 = not running, 0 = reference shaders, 1 = CPU normal matrices
+unsigned int		vertexBenchmarkFrame = 0;
+double				vertexBenchmarkCPUTime = 0.0;
+float				vertexBenchmarkLODError = 1.0f; // lodErrorThreshold to restore when the benchmark finishes
+
+// Level of detail selection - the largest screen-space error (in pixels) allowed when picking a simplified mesh.  Adjusted with the +/- keys
+float lodErrorThreshold = 1.0f;
+
 #pragma endregion
 
 
@@ -126,6 +278,14 @@ bool rotateDirectionalLight = false;
 void renderScene();
 void renderWithMultipleLights();
 void renderWithTransparency();
+void addSceneModel(const vector<AIMesh*>& meshes, RenderPass pass, const vector<mat4>& placements, const vector<OccluderMesh>& occluders = vector<OccluderMesh>());
+vector<mat4> townPlacements(const mat4& modelTransform);
+vector<PointLight> streetLightPlacements(unsigned int numLights);
+void updateSceneBounds();
+void submitScene(const mat4& cameraView, float lodProjectionScale, bool includeTransparent, GLuint program);
+void nextLightBenchmarkStage();
+void updateLightBenchmark(double cpuTime);
+void updateVertexBenchmark(double cpuTime);
 void updateScene();
 void resizeWindow(GLFWwindow* window, int width, int height);
 void keyboardHandler(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -134,35 +294,87 @@ void mouseButtonHandler(GLFWwindow* window, int button, int action, int mods);
 void mouseScrollHandler(GLFWwindow* window, double xoffset, double yoffset);
 void mouseEnterHandler(GLFWwindow* window, int entered);
 
-vector<AIMesh*> multiMesh(string objectFile, string diffuseMapFile, string normalMapFile)
+// CPU-side loading of a model and its textures, queued on the asset thread pool
+struct ModelLoadJob {
+
+	string					objectFile;
+	future<MeshCache*>		meshes;
+	string					diffuseMapFile;
+	string					normalMapFile;
+};
+
+ModelLoadJob queueModelLoad(ThreadPool& pool, string objectFile, string diffuseMapFile, string normalMapFile)
+{
+	ModelLoadJob job;
+
+	job.objectFile = objectFile;
+
+	// Load the model's sub-meshes through the scene cache (this only imports the model with assimp if the cache is missing or out of date)
+	job.meshes = pool.submit([objectFile]() { return SceneCache::acquire(objectFile); });
+
+	// Decode the textures - images shared with other models are only decoded once
+	job.diffuseMapFile = diffuseMapFile;
+	job.normalMapFile = normalMapFile;
+
+	TextureManager::prefetch(pool, diffuseMapFile, FIF_BMP);
+	TextureManager::prefetch(pool, normalMapFile, FIF_BMP);
+
+	return job;
+}
+
+// Occluder for the software occlusion buffer - the full detail level of mesh.  Simplified levels can't be used however small their error: they reuse the mesh's vertices but can still bulge outside the silhouette of a concave mesh, and an occluder that reaches beyond its mesh hides things that are visible
+OccluderMesh meshOccluder(const MeshStreams& mesh)
+{
+	GLuint firstIndex = 0;
+	GLuint numIndices = mesh.numIndices;
+
+	if (mesh.numLODs > 0) {
+
+		firstIndex = mesh.lods[0].firstIndex;
+		numIndices = mesh.lods[0].numIndices;
+	}
+
+	return makeOccluderMesh(&mesh.positions[0].x, mesh.indices + firstIndex, numIndices);
+}
+
+// Wait for a model's load job and upload its meshes and textures (on the main thread).  At most maxMeshes sub-meshes are created.  If occluders is not null an occluder is added to it for each sub-mesh
+vector<AIMesh*> multiMesh(ModelLoadJob& job, GLuint maxMeshes = UINT_MAX, vector<OccluderMesh>* occluders = nullptr)
 {
 	vector<AIMesh*> model;
-	const struct aiScene* modelScene = aiImportFile(objectFile.c_str(),
-		aiProcess_GenSmoothNormals |
-		aiProcess_CalcTangentSpace |
-		aiProcess_Triangulate |
-		aiProcess_JoinIdenticalVertices |
-		aiProcess_SortByPType);
 
-	if (modelScene) {
+	MeshCache* modelCache = job.meshes.get();
 
-		cout << "Model: " << objectFile << " has " << modelScene->mNumMeshes << " meshe(s)\n";
+	// Each mesh holds its own reference to the textures
+	GLuint texture = TextureManager::acquire(job.diffuseMapFile, FIF_BMP);
+	GLuint normapMap = TextureManager::acquire(job.normalMapFile, FIF_BMP, TexturePlaceholder_FlatNormal);
 
-		if (modelScene->mNumMeshes > 0) {
-			GLuint texture = loadTexture(diffuseMapFile.c_str(), FIF_BMP);
-			GLuint normapMap = loadTexture(normalMapFile.c_str(), FIF_BMP);
+	if (modelCache) {
+
+		cout << "Model: " << job.objectFile << " has " << modelCache->numMeshes() << " meshe(s)\n";
+
+		if (modelCache->numMeshes() > 0) {
 			// For each sub-mesh, setup a new AIMesh instance in the houseModel array
-			for (int i = 0; i < modelScene->mNumMeshes; i++) {
+			for (GLuint i = 0; i < modelCache->numMeshes() && i < maxMeshes; i++) {
 
 				cout << "Loading model sub-mesh " << i << endl;
-				model.push_back(new AIMesh(modelScene, i));
+				model.push_back(new AIMesh(modelCache->mesh(i), meshVertexFormat, geometryArena));
 				model[i]->addTexture(texture);
 				model[i]->addNormalMap(normapMap);
+
+				if (occluders)
+					occluders->push_back(meshOccluder(modelCache->mesh(i)));
 			}
-			return model;
 		}
+
+		// Mesh data has been uploaded to the GPU - release the model (this unmaps the cache once no other model is using it)
+		SceneCache::release(modelCache);
 	}
-	else cout << objectFile;
+	else cout << job.objectFile;
+
+	TextureManager::release(texture);
+	TextureManager::release(normapMap);
+
+	return model;
 }
 
 int main() {
@@ -203,6 +415,14 @@ int main() {
 
 	// Initialise glew
 	glewInit();
+
+	// Every draw fetches its model transform from the instance buffer through the draw's base instance
+	if (!InstanceBuffer::isSupported()) {
+
+		std::cout << "GL 4.2 or ARB_base_instance is required!\n";
+		glfwTerminate();
+		return -1;
+	}
 	
 	// Setup window's initial size
 	resizeWindow(window, windowWidth, windowHeight);
@@ -217,64 +437,274 @@ int main() {
 	glPolygonMode(GL_BACK, GL_LINE);
 	
 	glFrontFace(GL_CCW);
-	glEnable(GL_CULL_FACE);
+	GLStateCache::setCullFace(true);
 	
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
+	GLStateCache::setDepthTest(true);
+	GLStateCache::depthFunc(GL_LEQUAL);
 
 
 	// Setup Textures, VBOs and other scene objects
 
 	mainCamera = new ArcballCamera(-33.0f, 45.0f, 40.0f, 55.0f, (float)windowWidth/(float)windowHeight, 0.1f, 5000.0f);
-	
-	terrainMesh = new AIMesh(string("Assets\\terrain\\terrain.obj"));
-	if (terrainMesh) {
-		terrainMesh->addTexture(string("Assets\\terrain\\sand_c.bmp"), FIF_BMP);
-		terrainMesh->addNormalMap(string("Assets\\terrain\\sand_n.bmp"), FIF_BMP);
-	}
 
-	waterMesh = new AIMesh(string("Assets\\terrain\\water.obj"));
-	if (waterMesh) {
-		waterMesh->addTexture(string("Assets\\terrain\\water.bmp"), FIF_BMP);
-		waterMesh->addNormalMap(string("Assets\\terrain\\water_n.bmp"), FIF_BMP);
+	renderQueue = new RenderQueue();
+
+	enableTextureCooking(useTextureCooking && GLEW_EXT_texture_compression_s3tc && (GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc));
+
+	if (useTextureStreaming && TextureStreamer::isSupported()) {
+
+		textureStreamer = new TextureStreamer();
+		TextureManager::setStreamer(textureStreamer);
 	}
 
+	// Initial arena size - the buffers grow if the scene needs more
+	if (useGeometryArena && meshVertexFormat == VertexFormat::Packed)
+		geometryArena = new GeometryArena(64 * 1024, 256 * 1024);
+	
+	// Queue all model and texture loading on the asset thread pool.  Parsing, optimisation and image decoding run concurrently while the main thread sets up the shaders, then the results are uploaded to OpenGL here in order
+	auto loadStart = chrono::high_resolution_clock::now();
+
+	ThreadPool* assetLoader = new ThreadPool(numAssetLoadThreads);
+
+	ModelLoadJob terrainJob = queueModelLoad(*assetLoader, string("Assets\\terrain\\terrain.obj"), string("Assets\\terrain\\sand_c.bmp"), string("Assets\\terrain\\sand_n.bmp"));
+	ModelLoadJob waterJob = queueModelLoad(*assetLoader, string("Assets\\terrain\\water.obj"), string("Assets\\terrain\\water.bmp"), string("Assets\\terrain\\water_n.bmp"));
+
+	ModelLoadJob tier1Job = queueModelLoad(*assetLoader, string("Assets\\buildings\\tier1.v2.obj"), string("Assets\\buildings\\house_c3.bmp"), string("Assets\\buildings\\house_n3.bmp"));
+	ModelLoadJob tier2Job = queueModelLoad(*assetLoader, string("Assets\\buildings\\tier2.v2.obj"), string("Assets\\buildings\\house_c3.bmp"), string("Assets\\buildings\\house_n3.bmp"));
+	ModelLoadJob tier3Job = queueModelLoad(*assetLoader, string("Assets\\buildings\\tier3.obj"), string("Assets\\buildings\\house_c3.bmp"), string("Assets\\buildings\\house_n3.bmp"));
+
+	ModelLoadJob robotJob = queueModelLoad(*assetLoader, string("Assets\\robot\\robototo1.obj"), string("Assets\\robot\\robot_c.bmp"), string("Assets\\robot\\robot_n.bmp"));
+
 	// Load shaders
 	basicShader = setupShaders(string("Assets\\Shaders\\basic_shader.vert"), string("Assets\\Shaders\\basic_shader.frag"));
-	nMapDirLightShader = setupShaders(string("Assets\\Shaders\\nmap-directional.vert"), string("Assets\\Shaders\\nmap-directional.frag"));
+	nMapDirLightInstancedShader = setupShaders(string("Assets\\Shaders\\nmap-directional-instanced.vert"), string("Assets\\Shaders\\nmap-directional.frag"));
+	nMapDirLightReferenceInstancedShader = setupShaders(string("Assets\\Shaders\\nmap-directional-reference-instanced.vert"), string("Assets\\Shaders\\nmap-directional.frag"));
+	nMapMultiLightInstancedShader = setupShaders(string("Assets\\Shaders\\nmap-multilight-instanced.vert"), string("Assets\\Shaders\\nmap-multilight.frag"));
+	nMapClusteredInstancedShader = setupShaders(string("Assets\\Shaders\\nmap-multilight-instanced.vert"), string("Assets\\Shaders\\nmap-clustered.frag"));
+	nMapGBufferInstancedShader = setupShaders(string("Assets\\Shaders\\nmap-multilight-instanced.vert"), string("Assets\\Shaders\\nmap-gbuffer.frag"));
+	depthOnlyInstancedShader = setupShaders(string("Assets\\Shaders\\depth-only-instanced.vert"), string("Assets\\Shaders\\depth-only.frag"));
 
 	// Get uniform variable locations for setting values later during rendering
 	basicShader_mvpMatrix = glGetUniformLocation(basicShader, "mvpMatrix");
 
-	nMapDirLightShader_modelMatrix = glGetUniformLocation(nMapDirLightShader, "modelMatrix");
-	nMapDirLightShader_viewMatrix = glGetUniformLocation(nMapDirLightShader, "viewMatrix");
-	nMapDirLightShader_projMatrix = glGetUniformLocation(nMapDirLightShader, "projMatrix");
-	nMapDirLightShader_diffuseTexture = glGetUniformLocation(nMapDirLightShader, "diffuseTexture");
-	nMapDirLightShader_normalMapTexture = glGetUniformLocation(nMapDirLightShader, "normalMapTexture");
-	nMapDirLightShader_lightDirection = glGetUniformLocation(nMapDirLightShader, "lightDirection");
-	nMapDirLightShader_lightColour = glGetUniformLocation(nMapDirLightShader, "lightColour");
-
-	// calling multimesh function to import the models
-	tier1Model = multiMesh(string("Assets\\buildings\\tier1.v2.obj"), string("Assets\\buildings\\house_c3.bmp"), string("Assets\\buildings\\house_n3.bmp"));
-	tier2Model = multiMesh(string("Assets\\buildings\\tier2.v2.obj"), string("Assets\\buildings\\house_c3.bmp"), string("Assets\\buildings\\house_n3.bmp"));
-	tier3Model = multiMesh(string("Assets\\buildings\\tier3.obj"), string("Assets\\buildings\\house_c3.bmp"), string("Assets\\buildings\\house_n3.bmp"));
+	nMapDirLightInstancedShader_diffuseTexture = glGetUniformLocation(nMapDirLightInstancedShader, "diffuseTexture");
+	nMapDirLightInstancedShader_normalMapTexture = glGetUniformLocation(nMapDirLightInstancedShader, "normalMapTexture");
+	nMapDirLightInstancedShader_lightDirection = glGetUniformLocation(nMapDirLightInstancedShader, "lightDirection");
+	nMapDirLightInstancedShader_lightColour = glGetUniformLocation(nMapDirLightInstancedShader, "lightColour");
+
+	nMapDirLightReferenceInstancedShader_lightDirection = glGetUniformLocation(nMapDirLightReferenceInstancedShader, "lightDirection");
+	nMapDirLightReferenceInstancedShader_lightColour = glGetUniformLocation(nMapDirLightReferenceInstancedShader, "lightColour");
+
+	nMapMultiLightInstancedShader_diffuseTexture = glGetUniformLocation(nMapMultiLightInstancedShader, "diffuseTexture");
+	nMapMultiLightInstancedShader_normalMapTexture = glGetUniformLocation(nMapMultiLightInstancedShader, "normalMapTexture");
+
+	nMapClusteredInstancedShader_diffuseTexture = glGetUniformLocation(nMapClusteredInstancedShader, "diffuseTexture");
+	nMapClusteredInstancedShader_normalMapTexture = glGetUniformLocation(nMapClusteredInstancedShader, "normalMapTexture");
+
+	nMapGBufferInstancedShader_diffuseTexture = glGetUniformLocation(nMapGBufferInstancedShader, "diffuseTexture");
+	nMapGBufferInstancedShader_normalMapTexture = glGetUniformLocation(nMapGBufferInstancedShader, "normalMapTexture");
+
+	// Sampler units don't change so only need setting once
+
+	GLStateCache::useProgram(nMapDirLightInstancedShader);
+	glUniform1i(nMapDirLightInstancedShader_diffuseTexture, 0);
+	glUniform1i(nMapDirLightInstancedShader_normalMapTexture, 1);
+
+	GLStateCache::useProgram(nMapDirLightReferenceInstancedShader);
+	glUniform1i(glGetUniformLocation(nMapDirLightReferenceInstancedShader, "diffuseTexture"), 0);
+	glUniform1i(glGetUniformLocation(nMapDirLightReferenceInstancedShader, "normalMapTexture"), 1);
+
+	GLStateCache::useProgram(nMapMultiLightInstancedShader);
+	glUniform1i(nMapMultiLightInstancedShader_diffuseTexture, 0);
+	glUniform1i(nMapMultiLightInstancedShader_normalMapTexture, 1);
+
+	GLStateCache::useProgram(nMapClusteredInstancedShader);
+	glUniform1i(nMapClusteredInstancedShader_diffuseTexture, 0);
+	glUniform1i(nMapClusteredInstancedShader_normalMapTexture, 1);
+
+	GLStateCache::useProgram(nMapGBufferInstancedShader);
+	glUniform1i(nMapGBufferInstancedShader_diffuseTexture, 0);
+	glUniform1i(nMapGBufferInstancedShader_normalMapTexture, 1);
+
+	// Camera matrices are shared by every program through the camera buffer
+	if (useDynamicRing && DynamicRingBuffer::isSupported())
+		dynamicRing = new DynamicRingBuffer(dynamicRingRegionSize);
+
+	cameraBuffer = new CameraBuffer(dynamicRing);
+
+	GLuint cameraPrograms[] = { nMapDirLightInstancedShader, nMapDirLightReferenceInstancedShader, nMapMultiLightInstancedShader, nMapClusteredInstancedShader, nMapGBufferInstancedShader, depthOnlyInstancedShader };
+
+	for (GLuint program : cameraPrograms)
+		CameraBuffer::bindBlock(program);
+
+	lightBuffer = new LightBuffer(dynamicRing);
+	LightBuffer::bindBlock(nMapMultiLightInstancedShader);
+	LightBuffer::bindBlock(nMapClusteredInstancedShader);
+
+	clusteredLights = new ClusteredLights(dynamicRing);
+	ClusteredLights::setupProgram(nMapClusteredInstancedShader);
+
+	deferredRenderer = new DeferredRenderer(windowWidth, windowHeight, dynamicRing);
+
+	sceneTimer = new GPUTimer();
+	prepassTimer = new GPUTimer();
+	shadingTimer = new GPUTimer();
+
+	instanceBuffer = new InstanceBuffer();
+
+	if (useMultiDrawIndirect && instanceBuffer && geometryArena && IndirectDrawBuffer::isSupported())
+		indirectDrawBuffer = new IndirectDrawBuffer();
+
+	if (useOcclusionCulling && instanceBuffer && geometryArena && OcclusionCuller::isSupported())
+		occlusionCuller = new OcclusionCuller(windowWidth, windowHeight);
+
+	// calling multimesh function to upload the models as their load jobs complete.  The terrain and buildings hide things behind them so also get occluders
+	vector<OccluderMesh> terrainOccluders, tier1Occluders, tier2Occluders, tier3Occluders;
+
+	vector<AIMesh*> terrainModel = multiMesh(terrainJob, 1, &terrainOccluders);
+	terrainMesh = terrainModel.empty() ? nullptr : terrainModel[0];
+
+	vector<AIMesh*> waterModel = multiMesh(waterJob, 1);
+	waterMesh = waterModel.empty() ? nullptr : waterModel[0];
+
+	tier1Model = multiMesh(tier1Job, UINT_MAX, &tier1Occluders);
+	tier2Model = multiMesh(tier2Job, UINT_MAX, &tier2Occluders);
+	tier3Model = multiMesh(tier3Job, UINT_MAX, &tier3Occluders);
 	
-	robot = multiMesh(string("Assets\\robot\\robototo1.obj"), string("Assets\\robot\\robot_c.bmp"), string("Assets\\robot\\robot_n.bmp"));
+	robot = multiMesh(robotJob);
+
+	// Place the models in the scene
+	addSceneModel(terrainModel, RenderPass::Opaque, vector<mat4>(1, glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f))), terrainOccluders);
+	addSceneModel(tier1Model, RenderPass::Opaque, townPlacements(glm::translate(identity<mat4>(), vec3(-0.5f, 0.6f, 1.5f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f))), tier1Occluders);
+	addSceneModel(tier2Model, RenderPass::Opaque, townPlacements(glm::translate(identity<mat4>(), vec3(0.0f, 0.3f, -1.0f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f))), tier2Occluders);
+	addSceneModel(tier3Model, RenderPass::Opaque, townPlacements(glm::translate(identity<mat4>(), vec3(3.5f, 0.0f, 1.5f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f))), tier3Occluders);
+	addSceneModel(robot, RenderPass::Opaque, townPlacements(glm::translate(identity<mat4>(), vec3(3.5f, 0.4f, 3.5f)) * glm::scale(identity<mat4>(), vec3(0.03f, 0.03f, 0.03f)) * eulerAngleY<float>(glm::radians(270.0f))));
+	addSceneModel(waterModel, RenderPass::Transparent, vector<mat4>(1, glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f))));
+
+	instanceBuffer->upload();
+
+	streetLights = streetLightPlacements(numStreetLights);
+
+	sceneBVH = new BVH();
+	updateSceneBounds();
+	sceneBVH->reportStats();
+
+	occlusionThreads = new ThreadPool();
+	occlusionRasterizer = new OcclusionRasterizer(occlusionBufferWidth, occlusionBufferHeight, occlusionThreads);
+
+	// All jobs have completed - join the worker threads
+	unsigned int numLoaderThreads = assetLoader->numThreads();
+	delete assetLoader;
+
+	// Free any textures that were decoded but never used
+	TextureManager::discardPrefetched();
+
+	double loadTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - loadStart).count();
+	printf("Assets loaded in %.1f ms using %u loader thread(s)\n", loadTime, numLoaderThreads);
+	SceneCache::reportStats();
+
+	// Streamed textures are reported once they are all resident
+	if (!textureStreamer)
+		TextureManager::reportStats();
+
+	bool texturesResident = (textureStreamer == nullptr);
+
+	if (geometryArena)
+		geometryArena->reportUsage();
 	
 
 	// 2. Main loop
 
 	while (!glfwWindowShouldClose(window)) {
 
+		GLStateCache::beginFrame();
+
+		if (dynamicRing)
+			dynamicRing->beginFrame();
+
+		// Upload any textures that have finished decoding
+		if (textureStreamer) {
+
+			textureStreamer->update();
+
+			if (!texturesResident && textureStreamer->idle()) {
+
+				texturesResident = true;
+
+				textureStreamer->reportStats();
+				TextureManager::reportStats();
+			}
+		}
+
 		updateScene();
+		updateSceneBounds();
+
+		auto renderStart = chrono::high_resolution_clock::now();
+
+		forwardSceneDrawn = false;
+
+		sceneTimer->begin();
 		renderScene();					// Render into the current buffer
+		sceneTimer->end();
+
+		if (dynamicRing)
+			dynamicRing->endFrame();
+
+		double renderTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - renderStart).count();
+
+		updateLightBenchmark(renderTime);
+		updateVertexBenchmark(renderTime);
+
 		glfwSwapBuffers(window);		// Displays what was just rendered (using double buffering).
 
 		glfwPollEvents();				// Use this version when animating as fast as possible
 	
 		// update window title
-		char timingString[256];
-		sprintf_s(timingString, 256, "CIS5013: Average fps: %.0f; Average spf: %f", gameClock->averageFPS(), gameClock->averageSPF() / 1000.0f);
+		// snprintf truncates the title once it is full (sprintf_s would abort) so every section is given only the space left
+		char timingString[512];
+		snprintf(timingString, sizeof(timingString), "CIS5013: Average fps: %.0f; Average spf: %f; GPU: %.2fms; LOD error: %gpx; draws: %u (%u instances); meshes: %u visible, %u culled; GL state calls: %u issued, %u elided", gameClock->averageFPS(), gameClock->averageSPF() / 1000.0f, sceneTimer->getLastTime(), lodErrorThreshold, renderQueue->getNumItems(), renderQueue->getNumInstances(), numMeshesVisible, numMeshesCulled, GLStateCache::getNumIssued(), GLStateCache::getNumElided());
+
+		if (useFrustumCulling && useSceneBVH) {
+
+			size_t length = strlen(timingString);
+			snprintf(timingString + length, sizeof(timingString) - length, "; BVH: %u nodes visited, refit %.3fms, cull %.3fms", sceneBVH->getNumNodesVisited(), sceneBVH->getRefitTime(), sceneBVH->getCullTime());
+		}
+
+		if (forwardSceneDrawn) {
+
+			size_t length = strlen(timingString);
+
+			if (useDepthPrepass)
+				snprintf(timingString + length, sizeof(timingString) - length, "; depth pre-pass: %.2fms, shading: %.2fms", prepassTimer->getLastTime(), shadingTimer->getLastTime());
+			else
+				snprintf(timingString + length, sizeof(timingString) - length, "; shading: %.2fms", shadingTimer->getLastTime());
+		}
+
+		if (useSoftwareOcclusion) {
+
+			size_t length = strlen(timingString);
+			snprintf(timingString + length, sizeof(timingString) - length, "; SW occlusion: %u occluded, raster %.3fms, test %.3fms", numMeshesOccluded, occlusionRasterizer->getRasterTime(), occlusionRasterizer->getCullTime());
+		}
+
+		if (occlusionCuller && useOcclusionCulling) {
+
+			size_t length = strlen(timingString);
+			snprintf(timingString + length, sizeof(timingString) - length, "; occlusion: %u early, %u late, %u occluded", occlusionCuller->getNumDrawnEarly(), occlusionCuller->getNumDrawnLate(), occlusionCuller->getNumOccluded());
+		}
+
+		if (dynamicRing) {
+
+			size_t length = strlen(timingString);
+			snprintf(timingString + length, sizeof(timingString) - length, "; ring: %lldKB, %u stall(s)", (long long)(dynamicRing->getLastFrameBytes() / 1024), dynamicRing->getNumStalls());
+		}
+
+		// Light binning statistics when the clusters are in use
+		if (showMultipleLights && lightingMethod == LightingMethod::Clustered && lightBenchmarkStage < 0 && vertexBenchmarkStage < 0) {
+
+			size_t length = strlen(timingString);
+			snprintf(timingString + length, sizeof(timingString) - length, "; clustered lights: %u binned, %u max per cluster, %.2fms binning", clusteredLights->getNumLightsBinned(), clusteredLights->getMaxLightsPerCluster(), clusteredLights->getBinTime());
+		}
+
 		glfwSetWindowTitle(window, timingString);
 	}
 
@@ -286,6 +716,12 @@ int main() {
 		gameClock->reportTimingData();
 	}
 
+	if (dynamicRing)
+		dynamicRing->reportStats();
+
+	sceneBVH->reportStats();
+	occlusionRasterizer->reportStats();
+
 	return 0;
 }
 
@@ -293,121 +729,492 @@ int main() {
 // renderScene - function to render the current scene
 void renderScene()
 {
-	//renderWithMultipleLights();
-	renderWithTransparency();
+	if ((showMultipleLights || lightBenchmarkStage >= 0) && vertexBenchmarkStage < 0)
+		renderWithMultipleLights();
+	else
+		renderWithTransparency();
 }
 
-// Demonstrate the use of a single directional light source
-//  *** normal mapping ***  - since we're demonstrating the use of normal mapping with a directional light,
-// the normal mapped objects are rendered here also!
-void renderWithTransparency() {
+// Add a model to the scene, drawn once at each placement
+void addSceneModel(const vector<AIMesh*>& meshes, RenderPass pass, const vector<mat4>& placements, const vector<OccluderMesh>& occluders) {
 
-	// Clear the rendering window
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (meshes.empty() || placements.empty())
+		return;
 
-	// Get camera matrices
-	mat4 cameraProjection = mainCamera->projectionTransform();
-	mat4 cameraView = mainCamera->viewTransform() * translate(identity<mat4>(), -cameraPos);
+	SceneModel model;
 
-#pragma region Render opaque objects with directional light
+	model.meshes = meshes;
+	model.pass = pass;
+	model.placements = placements;
+	model.firstInstance = 0;
+	model.multiDraw = false;
+	model.firstCommand = 0;
+	model.firstBox = 0;
+	model.occlusionCulled = false;
+	model.firstObject = 0;
+	model.occluders = occluders;
 
-	//  *** normal mapping ***
-	// Plug in the normal map directional light shader
-	glUseProgram(nMapDirLightShader);
+	model.firstInstance = instanceBuffer->add(placements.data(), (GLuint)placements.size());
+
+	for (AIMesh* mesh : meshes)
+		instanceBuffer->attach(mesh->getVAO());
+
+	if (indirectDrawBuffer) {
+
+		// Sub-meshes can only be drawn together if they are in the arena and use the same textures
+		model.multiDraw = true;
+
+		DrawElementsIndirectCommand command;
+
+		for (AIMesh* mesh : meshes) {
+
+			if (!mesh->getIndirectCommand(1, 0, command) || mesh->getVAO() != meshes[0]->getVAO() || mesh->getTextureID() != meshes[0]->getTextureID() || mesh->getNormalMapID() != meshes[0]->getNormalMapID())
+				model.multiDraw = false;
+		}
+
+		if (model.multiDraw)
+			model.firstCommand = indirectDrawBuffer->addCommands((GLuint)(meshes.size() * placements.size()));
+	}
+
+	if (occlusionCuller && pass == RenderPass::Opaque) {
+
+		// Each object's command draws from the arena
+		model.occlusionCulled = true;
+
+		DrawElementsIndirectCommand command;
+
+		for (AIMesh* mesh : meshes) {
+
+			if (!mesh->getIndirectCommand(1, 0, command))
+				model.occlusionCulled = false;
+		}
+
+		if (model.occlusionCulled)
+			model.firstObject = occlusionCuller->addObjects((GLuint)(meshes.size() * placements.size()));
+	}
+
+	sceneModels.push_back(model);
+}
+
+// Repeat a model transform over the town grid.  The first placement is modelTransform itself
+vector<mat4> townPlacements(const mat4& modelTransform) {
+
+	vector<mat4> placements;
+
+	for (unsigned int z = 0; z < townSize; ++z) {
+
+		for (unsigned int x = 0; x < townSize; ++x)
+			placements.push_back(glm::translate(identity<mat4>(), vec3((float)x * townSpacing, 0.0f, (float)z * townSpacing)) * modelTransform);
+	}
+
+	return placements;
+}
+
+// Street lights on a grid over every copy of the town - warm, dim lights with a short range so each only reaches a few buildings
+vector<PointLight> streetLightPlacements(unsigned int numLights) {
+
+	vector<PointLight> placedLights;
+
+	if (numLights == 0)
+		return placedLights;
+
+	unsigned int lightsPerRow = (unsigned int)ceilf(sqrtf((float)numLights));
+
+	vec3 townMin = vec3(-3.0f, 0.8f, -3.0f);
+	vec3 townMax = vec3(6.0f, 0.8f, 6.0f) + vec3((float)(townSize - 1) * townSpacing, 0.0f, (float)(townSize - 1) * townSpacing);
+
+	for (unsigned int i = 0; i < numLights; ++i) {
+
+		float u = ((float)(i % lightsPerRow) + 0.5f) / (float)lightsPerRow;
+		float v = ((float)(i / lightsPerRow) + 0.5f) / (float)lightsPerRow;
+
+		vec3 pos = mix(townMin, townMax, vec3(u, 0.0f, v));
+
+		// Vary the colour a little so individual lights can be picked out
+		vec3 colour = vec3(1.0f, 0.7f + 0.2f * (float)(i % 3) / 2.0f, 0.4f) * 0.6f;
+
+		placedLights.push_back(PointLight(pos, colour, vec3(1.0f, 1.0f, 50.0f)));
+	}
+
+	return placedLights;
+}
+
+// Queue the meshes of an occlusion culled model.  Each mesh is drawn twice from the occlusion culler's commands - in the Opaque pass for the placements visible last frame and in the OpaqueLate pass for the placements that passed the occlusion test but weren't drawn early.  Placements outside the frustum (visible = 0) are never drawn
+void submitOcclusionCulledModel(const SceneModel& model, const mat4& cameraView, float lodProjectionScale, GLuint program, const uint8_t* visible) {
+
+	GLuint numMeshes = (GLuint)model.meshes.size();
+	GLuint numPlacements = (GLuint)model.placements.size();
+
+	for (GLuint i = 0; i < numMeshes; ++i) {
+
+		AIMesh* mesh = model.meshes[i];
+		GLuint firstObject = model.firstObject + i * numPlacements;
+		GLuint numInFrustum = 0;
+		float nearestDepth = FLT_MAX;
+
+		for (GLuint p = 0; p < numPlacements; ++p) {
+
+			GLuint box = model.firstBox + p * numMeshes + i;
+			mat4 modelView = cameraView * model.placements[p];
+			DrawElementsIndirectCommand command;
+
+			// Each placement has its own command so gets its own level of detail
+			mesh->selectLOD(modelView, lodProjectionScale, lodErrorThreshold);
+			mesh->getIndirectCommand(1, model.firstInstance + p, command);
+
+			vec3 centre = vec3(sceneBoxes.centreX[box], sceneBoxes.centreY[box], sceneBoxes.centreZ[box]);
+			vec3 extent = vec3(sceneBoxes.extentX[box], sceneBoxes.extentY[box], sceneBoxes.extentZ[box]);
+
+			occlusionCuller->setObject(firstObject + p, centre, extent, visible[p * numMeshes + i] != 0, command);
+
+			if (visible[p * numMeshes + i]) {
+
+				numInFrustum++;
+				nearestDepth = glm::min(nearestDepth, -(modelView * vec4(mesh->getBoundingSphereCentre(), 1.0f)).z);
+			}
+		}
+
+		numMeshesVisible += numInFrustum;
+		numMeshesCulled += numPlacements - numInFrustum;
+
+		if (numInFrustum == 0)
+			continue;
+
+		// The number of instances each draws is only known on the GPU
+		renderQueue->submitMultiDraw(RenderPass::Opaque, program, mesh->getVAO(), mesh->getTextureID(), mesh->getNormalMapID(), occlusionCuller->getEarlyDraws(), firstObject, numPlacements, 0, nearestDepth);
+		renderQueue->submitMultiDraw(RenderPass::OpaqueLate, program, mesh->getVAO(), mesh->getTextureID(), mesh->getNormalMapID(), occlusionCuller->getLateDraws(), firstObject, numPlacements, 0, nearestDepth);
+	}
+}
+
+// Split the visible placements of one of a model's sub-meshes into lodRuns.  Placements are grouped while they are consecutive in the instance range and select the same level of detail, so each run can be drawn with one instanced draw or indirect command
+void findLODRuns(const SceneModel& model, GLuint meshIndex, const mat4& cameraView, float lodProjectionScale, const uint8_t* visible) {
+
+	AIMesh* mesh = model.meshes[meshIndex];
+	GLuint numMeshes = (GLuint)model.meshes.size();
+
+	lodRuns.clear();
+
+	for (GLuint p = 0; p < (GLuint)model.placements.size(); ++p) {
+
+		if (!visible[p * numMeshes + meshIndex])
+			continue;
+
+		mat4 modelView = cameraView * model.placements[p];
+
+		mesh->selectLOD(modelView, lodProjectionScale, lodErrorThreshold);
+
+		GLuint lod = mesh->getCurrentLOD();
+		float viewDepth = -(modelView * vec4(mesh->getBoundingSphereCentre(), 1.0f)).z;
+
+		if (!lodRuns.empty() && lodRuns.back().lod == lod && lodRuns.back().firstPlacement + lodRuns.back().numPlacements == p) {
+
+			lodRuns.back().numPlacements++;
+			lodRuns.back().viewDepth = glm::min(lodRuns.back().viewDepth, viewDepth);
+		}
+		else {
 
-	// Setup uniforms
-	glUniformMatrix4fv(nMapDirLightShader_viewMatrix, 1, GL_FALSE, (GLfloat*)&cameraView);
-	glUniformMatrix4fv(nMapDirLightShader_projMatrix, 1, GL_FALSE, (GLfloat*)&cameraProjection);
-	glUniform1i(nMapDirLightShader_diffuseTexture, 0);
-	glUniform1i(nMapDirLightShader_normalMapTexture, 1);
-	glUniform3fv(nMapDirLightShader_lightDirection, 1, (GLfloat*)&(directLight.direction));
-	glUniform3fv(nMapDirLightShader_lightColour, 1, (GLfloat*)&(directLight.colour));
+			LODRun run = { p, 1, lod, viewDepth };
+			lodRuns.push_back(run);
+		}
+	}
+}
 
-	if (terrainMesh) {
+// Queue the meshes of a model to be drawn with a forward lighting shader.  visible has one flag per placement per mesh (placement * meshes + mesh) - meshes that aren't visible aren't drawn
+void submitModel(const SceneModel& model, const mat4& cameraView, float lodProjectionScale, GLuint program, const uint8_t* visible) {
 
-		mat4 modelTransform = glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+	GLuint numMeshes = (GLuint)model.meshes.size();
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+	if (model.occlusionCulled && useOcclusionCulling) {
 
-		terrainMesh->setupTextures();
-		terrainMesh->render();
+		submitOcclusionCulledModel(model, cameraView, lodProjectionScale, program, visible);
+		return;
 	}
-	if (!tier1Model.empty()) {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(-0.5f, 0.6f, 1.5f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+	// Each sub-mesh is drawn with one instance range per run of visible placements at the same level of detail
+	GLuint numInstances = (GLuint)model.placements.size();
+	GLuint numInstancesDrawn = 0;
+
+	if (model.multiDraw) {
+
+		GLuint numCommands = 0;
+		float nearestDepth = FLT_MAX;
+
+		// Write a command per run, packed from the start of the model's commands, and draw them all at once
+		for (GLuint i = 0; i < numMeshes; ++i) {
+
+			AIMesh* mesh = model.meshes[i];
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+			findLODRuns(model, i, cameraView, lodProjectionScale, visible);
 
-		// Loop through array of meshes and render each one
-		for (AIMesh* mesh : tier1Model) {
+			for (const LODRun& run : lodRuns) {
 
-			mesh->setupTextures();
-			mesh->render();
+				DrawElementsIndirectCommand command;
+
+				mesh->setLOD(run.lod);
+				mesh->getIndirectCommand(run.numPlacements, model.firstInstance + run.firstPlacement, command);
+
+				indirectDrawBuffer->setCommand(model.firstCommand + numCommands++, command);
+
+				numInstancesDrawn += run.numPlacements;
+				nearestDepth = glm::min(nearestDepth, run.viewDepth);
+			}
 		}
+
+		numMeshesVisible += numInstancesDrawn;
+		numMeshesCulled += numMeshes * numInstances - numInstancesDrawn;
+
+		if (numCommands == 0)
+			return;
+
+		AIMesh* firstMesh = model.meshes[0];
+
+		renderQueue->submitMultiDraw(model.pass, program, firstMesh->getVAO(), firstMesh->getTextureID(), firstMesh->getNormalMapID(), indirectDrawBuffer, model.firstCommand, numCommands, numInstancesDrawn, nearestDepth);
+
+		return;
 	}
-	if (!tier2Model.empty()) {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(0.0f, 0.3f, -1.0f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+	for (GLuint i = 0; i < numMeshes; ++i) {
+
+		AIMesh* mesh = model.meshes[i];
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+		findLODRuns(model, i, cameraView, lodProjectionScale, visible);
 
-		for (AIMesh* mesh : tier2Model) {
+		// The queue records the draw range of the mesh's current LOD when each run is submitted
+		for (const LODRun& run : lodRuns) {
 
-			mesh->setupTextures();
-			mesh->render();
+			mesh->setLOD(run.lod);
+			renderQueue->submitInstanced(model.pass, program, mesh, model.firstInstance + run.firstPlacement, run.numPlacements, run.viewDepth);
+
+			numInstancesDrawn += run.numPlacements;
 		}
 	}
-	if (!tier3Model.empty()) {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(3.5f, 0.0f, 1.5f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+	numMeshesVisible += numInstancesDrawn;
+	numMeshesCulled += numMeshes * numInstances - numInstancesDrawn;
+}
+
+// Recalculate the world space box of every mesh of every placement and fit the scene BVH to them.  The tree is only rebuilt when the number of boxes changes - moved placements are handled by refitting it
+void updateSceneBounds() {
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+	sceneBoxes.clear();
 
-		for (AIMesh* mesh : tier3Model) {
+	for (SceneModel& model : sceneModels) {
 
-			mesh->setupTextures();
-			mesh->render();
+		model.firstBox = sceneBoxes.size();
+
+		for (const mat4& placement : model.placements) {
+
+			for (AIMesh* mesh : model.meshes)
+				sceneBoxes.add(placement, mesh->getBoundingBoxMin(), mesh->getBoundingBoxMax());
 		}
 	}
-	if (!robot.empty()) {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(3.5f, 0.4f, 3.5f)) * glm::scale(identity<mat4>(), vec3(0.03f, 0.03f, 0.03f)) * eulerAngleY<float>(glm::radians(270.0f));
+	if (sceneBVH->getNumPrimitives() != sceneBoxes.size())
+		sceneBVH->build(sceneBoxes);
+	else
+		sceneBVH->refit(sceneBoxes);
+}
+
+// Build and sort the render queue for the scene.  Transparent objects are only queued if includeTransparent is true
+void submitScene(const mat4& cameraView, float lodProjectionScale, bool includeTransparent, GLuint program) {
+
+	renderQueue->clear();
+
+	cullVisible.resize(sceneBoxes.size());
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+	if (useFrustumCulling && sceneBoxes.size() > 0) {
 
-		for (AIMesh* mesh : robot) {
+		// cameraView is the camera's view transform after moving to cameraPos, so extract the planes from it directly rather than from the camera's own cached frustum
+		mat4 viewProj = mainCamera->projectionTransform() * cameraView;
 
-			mesh->setupTextures();
-			mesh->render();
+		if (viewProj != sceneFrustumViewProj) {
+
+			sceneFrustum = Frustum(viewProj);
+			sceneFrustumViewProj = viewProj;
 		}
+
+		if (useSceneBVH)
+			sceneBVH->cull(sceneFrustum, cullVisible.data());
+		else
+			sceneFrustum.cullBoxes(sceneBoxes, cullVisible.data());
 	}
-#pragma endregion
+	else {
 
-#pragma region Render transparant objects
+		fill(cullVisible.begin(), cullVisible.end(), (uint8_t)1);
+	}
 
-	glEnable(GL_BLEND);
-	//if there were multiple transparent objects, alpha and one minus alpha should be used instead
-	glBlendFunc(GL_ONE, GL_ONE);
+	numMeshesOccluded = 0;
 
-	if (waterMesh) {
+	if (useSoftwareOcclusion && sceneBoxes.size() > 0) {
 
-		mat4 modelTransform = glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+		occlusionRasterizer->beginFrame(mainCamera->projectionTransform() * cameraView);
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+		// Occluders of meshes outside the frustum can't hide anything inside it
+		for (const SceneModel& model : sceneModels) {
 
-		waterMesh->setupTextures();
-		waterMesh->render();
+			for (GLuint p = 0; p < model.placements.size(); ++p) {
+
+				for (GLuint i = 0; i < model.occluders.size(); ++i) {
+
+					if (cullVisible[model.firstBox + p * model.meshes.size() + i])
+						occlusionRasterizer->addOccluder(model.occluders[i], model.placements[p]);
+				}
+			}
+		}
+
+		occlusionRasterizer->rasterize();
+
+		numMeshesOccluded = occlusionRasterizer->cullBoxes(sceneBoxes.size(), sceneBoxes.centreX.data(), sceneBoxes.centreY.data(), sceneBoxes.centreZ.data(), sceneBoxes.extentX.data(), sceneBoxes.extentY.data(), sceneBoxes.extentZ.data(), cullVisible.data());
 	}
 
-	glDisable(GL_BLEND);
+	numMeshesVisible = 0;
+	numMeshesCulled = 0;
 
-#pragma endregion
+	for (const SceneModel& model : sceneModels) {
+
+		if (model.pass != RenderPass::Transparent || includeTransparent)
+			submitModel(model, cameraView, lodProjectionScale, program, cullVisible.data() + model.firstBox);
+	}
+
+	renderQueue->sort();
+
+	// Upload any commands that changed LOD
+	if (indirectDrawBuffer)
+		indirectDrawBuffer->upload();
+
+	// Write the occlusion culled models' early draws
+	if (occlusionCuller && useOcclusionCulling)
+		occlusionCuller->cullEarly();
+}
+
+// Draw the render queue built by submitScene.  The occlusion culler's late draws are written (once a frame) when the OpaqueLate pass starts, from the depth of the Opaque pass.  beginPass is called as for RenderQueue::execute
+void executeScene(const RenderQueue::PassCallback& beginPass = nullptr, bool depthOnly = false) {
+
+	auto passCallback = [&beginPass](RenderPass pass) {
+
+		if (pass == RenderPass::OpaqueLate)
+			occlusionCuller->cullLate();
+
+		if (beginPass)
+			beginPass(pass);
+	};
+
+	if (depthOnly)
+		renderQueue->executeDepthOnly(depthOnlyInstancedShader, passCallback);
+	else
+		renderQueue->execute(passCallback);
+}
+
+// Draw the render queue with a forward shader, timing each pass.  With the depth pre-pass on the opaque draws are first drawn depth only (which also gives the occlusion culler its depth), then shaded with depth writes off and GL_EQUAL so only the nearest fragment of each pixel is shaded.  beginPass is called as for RenderQueue::execute in the shading pass
+void executeForwardScene(const RenderQueue::PassCallback& beginPass = nullptr) {
+
+	if (useDepthPrepass) {
+
+		prepassTimer->begin();
+
+		GLStateCache::colorMask(false);
+		executeScene(nullptr, true);
+		GLStateCache::colorMask(true);
+
+		prepassTimer->end();
+
+		GLStateCache::depthMask(false);
+		GLStateCache::depthFunc(GL_EQUAL);
+	}
+
+	shadingTimer->begin();
+
+	executeScene([&beginPass](RenderPass pass) {
+
+		// Transparent draws aren't in the pre-pass so are depth tested as usual
+		if (pass == RenderPass::Transparent) {
+
+			GLStateCache::depthMask(true);
+			GLStateCache::depthFunc(GL_LEQUAL);
+		}
+
+		if (beginPass)
+			beginPass(pass);
+	});
+
+	shadingTimer->end();
+
+	forwardSceneDrawn = true;
+
+	GLStateCache::depthMask(true);
+	GLStateCache::depthFunc(GL_LEQUAL);
+}
+
+// Upload the frame's camera matrices - every program reads them from the camera buffer
+void setupCamera(const mat4& cameraView, const mat4& cameraProjection) {
+
+	cameraBuffer->update(cameraView, cameraProjection);
+	cameraBuffer->bind();
+
+	// All arena meshes are drawn from the arena's VAO
+	if (geometryArena)
+		geometryArena->bind();
+}
+
+// Set the light used by the normal map directional light shader - this is all that changes between light passes
+void setNMapDirLight(const DirectionalLight& light) {
+
+	GLStateCache::useProgram(nMapDirLightInstancedShader);
+
+	glUniform3fv(nMapDirLightInstancedShader_lightDirection, 1, (GLfloat*)&(light.direction));
+	glUniform3fv(nMapDirLightInstancedShader_lightColour, 1, (GLfloat*)&(light.colour));
+
+	// The vertex benchmark's reference shader is lit the same way
+	if (vertexBenchmarkStage >= 0) {
+
+		GLStateCache::useProgram(nMapDirLightReferenceInstancedShader);
+
+		glUniform3fv(nMapDirLightReferenceInstancedShader_lightDirection, 1, (GLfloat*)&(light.direction));
+		glUniform3fv(nMapDirLightReferenceInstancedShader_lightColour, 1, (GLfloat*)&(light.colour));
+	}
+}
+
+// Demonstrate the use of a single directional light source
+//  *** normal mapping ***  - since we're demonstrating the use of normal mapping with a directional light,
+// the normal mapped objects are rendered here also!
+void renderWithTransparency() {
+
+	// Clear the rendering window
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Get camera matrices
+	mat4 cameraProjection = mainCamera->projectionTransform();
+	mat4 cameraView = mainCamera->viewTransform() * translate(identity<mat4>(), -cameraPos);
+
+	// Scale from view-space size at unit distance to pixels - used to project each mesh's LOD error onto the screen
+	float lodProjectionScale = (float)windowHeight / (2.0f * tanf(glm::radians(mainCamera->getFovY()) * 0.5f));
+
+	// The first stage of the vertex benchmark draws with the shaders that invert the model matrix per vertex
+	submitScene(cameraView, lodProjectionScale, true, (vertexBenchmarkStage == 0) ? nMapDirLightReferenceInstancedShader : nMapDirLightInstancedShader);
+
+	//  *** normal mapping ***
+	// Plug in the normal map directional light shader
+	setupCamera(cameraView, cameraProjection);
+	setNMapDirLight(directLight);
+
+	// Opaque objects are drawn first, then transparent objects with blending
+	executeForwardScene([](RenderPass pass) {
+
+		if (pass == RenderPass::Transparent) {
+
+			GLStateCache::setBlend(true);
+			//if there were multiple transparent objects, alpha and one minus alpha should be used instead
+			GLStateCache::blendFunc(GL_ONE, GL_ONE);
+		}
+	});
+
+	GLStateCache::setBlend(false);
 
 	// render directional light source
 
 	// Restore fixed-function pipeline
-	glUseProgram(0);
-	glBindVertexArray(0);
+	GLStateCache::useProgram(0);
+	GLStateCache::bindVertexArray(0);
 	glDisable(GL_TEXTURE_2D);
 
 	mat4 cameraT = cameraProjection * cameraView;
@@ -434,180 +1241,234 @@ void renderWithMultipleLights() {
 	mat4 cameraProjection = mainCamera->projectionTransform();
 	mat4 cameraView = mainCamera->viewTransform() * translate(identity<mat4>(), -cameraPos);
 
-#pragma region Render opaque objects with directional light
+	// Scale from view-space size at unit distance to pixels - used to project each mesh's LOD error onto the screen
+	float lodProjectionScale = (float)windowHeight / (2.0f * tanf(glm::radians(mainCamera->getFovY()) * 0.5f));
 
-	//  *** normal mapping ***
-	// Plug in the normal map directional light shader
-	glUseProgram(nMapDirLightShader);
+	// The benchmark sets the method and lights the scene with street lights only
+	LightingMethod method = lightingMethod;
+	vector<DirectionalLight> directionalLights = { directLightBlue, directLightPink };
+	vector<PointLight> pointLights(lights, lights + sizeof(lights) / sizeof(PointLight));
+
+	if (showStreetLights)
+		pointLights.insert(pointLights.end(), streetLights.begin(), streetLights.end());
 
-	// Setup uniforms
-	glUniformMatrix4fv(nMapDirLightShader_viewMatrix, 1, GL_FALSE, (GLfloat*)&cameraView);
-	glUniformMatrix4fv(nMapDirLightShader_projMatrix, 1, GL_FALSE, (GLfloat*)&cameraProjection);
-	glUniform1i(nMapDirLightShader_diffuseTexture, 0);
-	glUniform1i(nMapDirLightShader_normalMapTexture, 1);
-	glUniform3fv(nMapDirLightShader_lightDirection, 1, (GLfloat*)&(directLightBlue.direction));
-	glUniform3fv(nMapDirLightShader_lightColour, 1, (GLfloat*)&(directLightBlue.colour));
+	if (lightBenchmarkStage >= 0) {
 
-	if (terrainMesh) {
+		method = (LightingMethod)(lightBenchmarkStage % (int)LightingMethod::NumMethods);
+		directionalLights.clear();
+		pointLights = streetLightPlacements(lightBenchmarkCounts[lightBenchmarkStage / (int)LightingMethod::NumMethods]);
+	}
 
-		mat4 modelTransform = glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+	// Camera uniforms are the same for each light pass
+	setupCamera(cameraView, cameraProjection);
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+	if (method == LightingMethod::SinglePass) {
 
-		terrainMesh->setupTextures();
-		terrainMesh->render();
-	}
+		// Every light is shaded in one pass from the light buffer
+		submitScene(cameraView, lodProjectionScale, false, nMapMultiLightInstancedShader);
 
-	// Render models
-	if (!tier1Model.empty()) {
+		lightBuffer->update(directionalLights, pointLights);
+		lightBuffer->bind();
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(-0.5f, 0.6f, 1.5f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+		executeForwardScene();
+	}
+	else if (method == LightingMethod::Clustered) {
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+		// Directional lights affect every fragment so stay in the light buffer - point lights are binned into clusters
+		submitScene(cameraView, lodProjectionScale, false, nMapClusteredInstancedShader);
 
-		// Loop through array of meshes and render each one
-		for (AIMesh* mesh : tier1Model) {
+		lightBuffer->update(directionalLights, vector<PointLight>());
+		lightBuffer->bind();
 
-			mesh->setupTextures();
-			mesh->render();
-		}
+		clusteredLights->update(pointLights, cameraView, cameraProjection, mainCamera->getNearPlaneDistance(), mainCamera->getFarPlaneDistance(), windowWidth, windowHeight);
+		clusteredLights->bind();
+
+		executeForwardScene();
 	}
-	if (!tier2Model.empty()) {
+	else if (method == LightingMethod::Deferred) {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(0.0f, 0.3f, -1.0f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+		// The scene is drawn once into the G-buffer, then each light only shades the pixels it reaches
+		submitScene(cameraView, lodProjectionScale, false, nMapGBufferInstancedShader);
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+		deferredRenderer->beginGeometryPass();
+		executeScene();
+		deferredRenderer->endGeometryPass();
 
-		for (AIMesh* mesh : tier2Model) {
+		lightBuffer->update(directionalLights, vector<PointLight>());
+		lightBuffer->bind();
 
-			mesh->setupTextures();
-			mesh->render();
-		}
+		deferredRenderer->shade(pointLights);
 	}
-	if (!tier3Model.empty()) {
+	else {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(3.5f, 0.0f, 1.5f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+		// Enable additive blending for ***subsequent*** light sources!!!
+		bool firstPass = true;
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+		auto beginLightPass = [&firstPass]() {
 
-		for (AIMesh* mesh : tier3Model) {
+			if (!firstPass) {
 
-			mesh->setupTextures();
-			mesh->render();
+				GLStateCache::setBlend(true);
+				GLStateCache::blendFunc(GL_ONE, GL_ONE);
+			}
+
+			firstPass = false;
+		};
+
+		// The scene is culled, queued and sorted once - each kind of light pass only swaps the program the queue is drawn with
+		submitScene(cameraView, lodProjectionScale, false, nMapDirLightInstancedShader);
+
+		if (!directionalLights.empty()) {
+
+			for (const DirectionalLight& light : directionalLights) {
+
+				beginLightPass();
+				setNMapDirLight(light);
+				executeScene();
+			}
 		}
-	}
-	if (!robot.empty()) {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(3.5f, 0.4f, 3.5f)) * glm::scale(identity<mat4>(), vec3(0.03f, 0.03f, 0.03f)) * eulerAngleY<float>(glm::radians(270.0f));
+		// Point lights have no single light shader - the multiple light shader is given one light at a time
+		if (!pointLights.empty()) {
+
+			renderQueue->setProgram(nMapMultiLightInstancedShader);
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+			for (const PointLight& light : pointLights) {
 
-		for (AIMesh* mesh : robot) {
+				beginLightPass();
 
-			mesh->setupTextures();
-			mesh->render();
+				lightBuffer->update(vector<DirectionalLight>(), vector<PointLight>(1, light));
+				lightBuffer->bind();
+
+				executeScene();
+			}
 		}
 	}
-#pragma endregion
-	// Enable additive blending for ***subsequent*** light sources!!!
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_ONE, GL_ONE);
 
-#pragma region Render opaque objects with 2nd directional light
+	GLStateCache::setBlend(false);
 
-	//  *** normal mapping ***
-	// Plug in the normal map directional light shader
-	glUseProgram(nMapDirLightShader);
+	// Restore fixed-function pipeline
+	GLStateCache::useProgram(0);
+	GLStateCache::bindVertexArray(0);
+	glDisable(GL_TEXTURE_2D);
 
-	// Setup uniforms
-	glUniformMatrix4fv(nMapDirLightShader_viewMatrix, 1, GL_FALSE, (GLfloat*)&cameraView);
-	glUniformMatrix4fv(nMapDirLightShader_projMatrix, 1, GL_FALSE, (GLfloat*)&cameraProjection);
-	glUniform1i(nMapDirLightShader_diffuseTexture, 0);
-	glUniform1i(nMapDirLightShader_normalMapTexture, 1);
-	glUniform3fv(nMapDirLightShader_lightDirection, 1, (GLfloat*)&(directLightPink.direction));
-	glUniform3fv(nMapDirLightShader_lightColour, 1, (GLfloat*)&(directLightPink.colour));
+	mat4 cameraT = cameraProjection * cameraView;
+	glLoadMatrixf((GLfloat*)&cameraT);
+	glEnable(GL_POINT_SMOOTH);
+	glPointSize(10.0f);
+	glBegin(GL_POINTS);
 
-	if (terrainMesh) {
+	for (const DirectionalLight& light : directionalLights) {
 
-		mat4 modelTransform = glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+		glColor3f(light.colour.r, light.colour.g, light.colour.b);
+		glVertex3f(light.direction.x * 10.0f, light.direction.y * 10.0f, light.direction.z * 10.0f);
+	}
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+	for (const PointLight& light : pointLights) {
 
-		terrainMesh->setupTextures();
-		terrainMesh->render();
+		glColor3f(light.colour.r, light.colour.g, light.colour.b);
+		glVertex3f(light.pos.x, light.pos.y, light.pos.z);
 	}
 
-	// Render models
-	if (!tier1Model.empty()) {
+	glEnd();
+}
+
+// Advance the lighting benchmark by one frame and report each stage's average GPU and CPU time as it completes
+void updateLightBenchmark(double cpuTime) {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(-0.5f, 0.6f, 1.5f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+	if (lightBenchmarkStage < 0)
+		return;
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+	lightBenchmarkFrame++;
 
-		// Loop through array of meshes and render each one
-		for (AIMesh* mesh : tier1Model) {
+	// Start timing once the stage has warmed up
+	if (lightBenchmarkFrame == lightBenchmarkWarmup) {
 
-			mesh->setupTextures();
-			mesh->render();
-		}
+		sceneTimer->reset();
+		lightBenchmarkCPUTime = 0.0;
+		return;
 	}
-	if (!tier2Model.empty()) {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(0.0f, 0.3f, -1.0f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+	if (lightBenchmarkFrame < lightBenchmarkWarmup)
+		return;
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+	lightBenchmarkCPUTime += cpuTime;
 
-		for (AIMesh* mesh : tier2Model) {
+	if (lightBenchmarkFrame < lightBenchmarkWarmup + lightBenchmarkFrames)
+		return;
 
-			mesh->setupTextures();
-			mesh->render();
-		}
-	}
-	if (!tier3Model.empty()) {
+	unsigned int numLights = lightBenchmarkCounts[lightBenchmarkStage / (int)LightingMethod::NumMethods];
+
+	printf("Lighting benchmark: %4u point light(s), %s: %.3f ms GPU, %.3f ms CPU\n",
+		numLights,
+		lightBenchmarkMethodNames[lightBenchmarkStage % (int)LightingMethod::NumMethods],
+		sceneTimer->getAverageTime(),
+		lightBenchmarkCPUTime / (double)lightBenchmarkFrames);
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(3.5f, 0.0f, 1.5f)) * glm::scale(identity<mat4>(), vec3(0.1f, 0.1f, 0.1f));
+	nextLightBenchmarkStage();
+}
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+// Move the lighting benchmark on to the next stage it can run (starting it if it isn't running), reporting the stages it skips.  Stops the benchmark after the last stage
+void nextLightBenchmarkStage() {
 
-		for (AIMesh* mesh : tier3Model) {
+	const int numStages = (int)(sizeof(lightBenchmarkCounts) / sizeof(unsigned int)) * (int)LightingMethod::NumMethods;
 
-			mesh->setupTextures();
-			mesh->render();
-		}
+	lightBenchmarkStage++;
+	lightBenchmarkFrame = 0;
+
+	for (; lightBenchmarkStage < numStages; ++lightBenchmarkStage) {
+
+		LightingMethod method = (LightingMethod)(lightBenchmarkStage % (int)LightingMethod::NumMethods);
+		unsigned int numLights = lightBenchmarkCounts[lightBenchmarkStage / (int)LightingMethod::NumMethods];
+
+		if (method != LightingMethod::SinglePass || numLights <= LightBuffer::maxPointLights)
+			return;
+
+		printf("Lighting benchmark: %4u point light(s), %s: skipped (at most %u point lights)\n", numLights, lightBenchmarkMethodNames[(int)method], LightBuffer::maxPointLights);
 	}
-	if (!robot.empty()) {
 
-		mat4 modelTransform = glm::translate(identity<mat4>(), vec3(3.5f, 0.4f, 3.5f)) * glm::scale(identity<mat4>(), vec3(0.03f, 0.03f, 0.03f)) * eulerAngleY<float>(glm::radians(270.0f));
+	lightBenchmarkStage = -1;
+}
 
-		glUniformMatrix4fv(nMapDirLightShader_modelMatrix, 1, GL_FALSE, (GLfloat*)&modelTransform);
+// Advance the vertex benchmark by one frame and report each stage's average GPU and CPU time as it completes
+void updateVertexBenchmark(double cpuTime) {
 
-		for (AIMesh* mesh : robot) {
+	if (vertexBenchmarkStage < 0)
+		return;
 
-			mesh->setupTextures();
-			mesh->render();
-		}
+	vertexBenchmarkFrame++;
+
+	// Start timing once the stage has warmed up
+	if (vertexBenchmarkFrame == lightBenchmarkWarmup) {
+
+		sceneTimer->reset();
+		vertexBenchmarkCPUTime = 0.0;
+		return;
 	}
-	glDisable(GL_BLEND);
-#pragma endregion
 
-	// Restore fixed-function pipeline
-	glUseProgram(0);
-	glBindVertexArray(0);
-	glDisable(GL_TEXTURE_2D);
+	if (vertexBenchmarkFrame < lightBenchmarkWarmup)
+		return;
 
-	mat4 cameraT = cameraProjection * cameraView;
-	glLoadMatrixf((GLfloat*)&cameraT);
-	glEnable(GL_POINT_SMOOTH);
-	glPointSize(10.0f);
-	glBegin(GL_POINTS);
+	vertexBenchmarkCPUTime += cpuTime;
 
-	glColor3f(directLightPink.colour.r, directLightPink.colour.g, directLightPink.colour.b);
-	glVertex3f(directLightPink.direction.x * 10.0f, directLightPink.direction.y * 10.0f, directLightPink.direction.z * 10.0f);
+	if (vertexBenchmarkFrame < lightBenchmarkWarmup + lightBenchmarkFrames)
+		return;
 
-	glColor3f(directLightBlue.colour.r, directLightBlue.colour.g, directLightBlue.colour.b);
-	glVertex3f(directLightBlue.direction.x * 10.0f, directLightBlue.direction.y * 10.0f, directLightBlue.direction.z * 10.0f);
+	const char* stageNames[] = { "normal matrix per vertex", "normal matrix from CPU  " };
 
-	glEnd();
+	printf("Vertex benchmark: %s: %.3f ms GPU, %.3f ms CPU\n",
+		stageNames[vertexBenchmarkStage],
+		sceneTimer->getAverageTime(),
+		vertexBenchmarkCPUTime / (double)lightBenchmarkFrames);
+
+	vertexBenchmarkStage++;
+	vertexBenchmarkFrame = 0;
+
+	if (vertexBenchmarkStage > 1) {
+
+		vertexBenchmarkStage = -1;
+		lodErrorThreshold = vertexBenchmarkLODError;
+	}
 }
 
 // Function called to animate elements in the scene
@@ -669,6 +1530,12 @@ void resizeWindow(GLFWwindow* window, int width, int height)
 
 	windowWidth = width;
 	windowHeight = height;
+
+	if (deferredRenderer)
+		deferredRenderer->resize(width, height);
+
+	if (occlusionCuller)
+		occlusionCuller->resize(width, height);
 }
 
 // Function to call to handle keyboard input
@@ -703,6 +1570,75 @@ void keyboardHandler(GLFWwindow* window, int key, int scancode, int action, int
 				rotateDirectionalLight = !rotateDirectionalLight;
 				break;
 
+			case GLFW_KEY_EQUAL:
+			case GLFW_KEY_KP_ADD:
+				lodErrorThreshold = glm::min(lodErrorThreshold * 2.0f, 64.0f);
+				break;
+
+			case GLFW_KEY_MINUS:
+			case GLFW_KEY_KP_SUBTRACT:
+				lodErrorThreshold = glm::max(lodErrorThreshold * 0.5f, 0.125f);
+				break;
+
+			case GLFW_KEY_M:
+				showMultipleLights = !showMultipleLights;
+				break;
+
+			case GLFW_KEY_L: {
+
+				const char* methodNames[] = { "Multi-pass", "Single pass", "Clustered", "Deferred" };
+
+				lightingMethod = (LightingMethod)(((int)lightingMethod + 1) % (int)LightingMethod::NumMethods);
+				printf("%s lighting\n", methodNames[(int)lightingMethod]);
+				break;
+			}
+
+			case GLFW_KEY_K:
+				showStreetLights = !showStreetLights;
+				break;
+
+			case GLFW_KEY_F:
+				useFrustumCulling = !useFrustumCulling;
+				printf("Frustum culling %s\n", useFrustumCulling ? "on" : "off");
+				break;
+
+			case GLFW_KEY_C:
+				useSoftwareOcclusion = !useSoftwareOcclusion;
+				printf("Software occlusion culling %s\n", useSoftwareOcclusion ? "on" : "off");
+				break;
+
+			case GLFW_KEY_P:
+				useDepthPrepass = !useDepthPrepass;
+				printf("Depth pre-pass %s\n", useDepthPrepass ? "on" : "off");
+				break;
+
+			case GLFW_KEY_O:
+				useOcclusionCulling = !useOcclusionCulling;
+				printf("Occlusion culling %s\n", (useOcclusionCulling && occlusionCuller) ? "on" : "off");
+				break;
+
+			case GLFW_KEY_V:
+				useSceneBVH = !useSceneBVH;
+				printf("Frustum culling %s\n", useSceneBVH ? "with the scene BVH" : "box by box");
+				break;
+
+			case GLFW_KEY_B:
+				if (lightBenchmarkStage < 0 && vertexBenchmarkStage < 0)
+					nextLightBenchmarkStage();
+				break;
+
+			case GLFW_KEY_N:
+				if (vertexBenchmarkStage < 0 && lightBenchmarkStage < 0) {
+
+					// Draw every mesh at full detail so the vertex stage has the most work
+					vertexBenchmarkLODError = lodErrorThreshold;
+					lodErrorThreshold = 0.125f;
+
+					vertexBenchmarkStage = 0;
+					vertexBenchmarkFrame = 0;
+				}
+				break;
+
 			default:
 			{
 			}
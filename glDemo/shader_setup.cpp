@@ -291,155 +291,92 @@ GLuint setupShaders(const string& vsPath, const string& fsPath, ShaderError* err
 	return program;
 }
 
-#if 0
-GLuint setupComputeShader(const std::string& csPath, GLSL_ERROR* error_result) {
-
-	GLuint					computeShader = 0;
-	GLuint					glslProgram = 0;
-
-	const string* computeShaderSource = NULL;
-
-	// create compute shader object
-	GLSL_ERROR err = createShaderFromFile(GL_COMPUTE_SHADER, csPath, &computeShader, &computeShaderSource);
-
-	if (err != GLSL_OK) {
+GLuint setupComputeShader(const string& csPath, ShaderError* error_result) {
 
-		switch (err) {
-
-		case GLSL_SHADER_SOURCE_NOT_FOUND:
-
-			printf("Compute shader source not found.\n");
-
-			if (error_result)
-				*error_result = GLSL_COMPUTE_SHADER_SOURCE_NOT_FOUND;
+	GLuint computeShader = 0;
 
-			return 0;
-
-
-		case GLSL_SHADER_OBJECT_CREATION_ERROR:
-
-			printf("OpenGL could not create the compute shader program object.  Try using fewer resources before creating the program object.\n");
-
-			if (error_result)
-				*error_result = GLSL_COMPUTE_SHADER_OBJECT_CREATION_ERROR;
-
-			return 0;
-
-
-		case GLSL_SHADER_COMPILE_ERROR:
-
-			printf("The compute shader could not be compiled successfully...\n");
-			printf("Compute shader source code...\n\n");
-
-			printSourceListing(*computeShaderSource);
-
-			// report compilation error log
-
-			printf("\n<compute shader compiler errors--------------------->\n\n");
-			reportShaderInfoLog(computeShader);
-			printf("<-----------------end compute shader compiler errors>\n\n\n");
-
-			// dispose of existing shader objects
-
-			glDeleteShader(computeShader);
-
-			if (computeShaderSource)
-				delete computeShaderSource;
-
-			if (error_result)
-				*error_result = GLSL_COMPUTE_SHADER_COMPILE_ERROR;
-
-			return 0;
+	// Create the compute shader object - createShaderFromFile reports any errors
+	ShaderError err = createShaderFromFile(GL_COMPUTE_SHADER, csPath, &computeShader);
 
+	if (err != ShaderError::GLSL_OK) {
 
-		default:
+		if (error_result) {
 
-			printf("The compute shader object could not be created successfully.\n");
+			switch (err) {
 
-			// dispose of existing shader objects
+			case ShaderError::GLSL_SHADER_SOURCE_NOT_FOUND:
+				*error_result = ShaderError::GLSL_COMPUTE_SHADER_SOURCE_NOT_FOUND;
+				break;
 
-			glDeleteShader(computeShader);
+			case ShaderError::GLSL_SHADER_OBJECT_CREATION_ERROR:
+				*error_result = ShaderError::GLSL_COMPUTE_SHADER_OBJECT_CREATION_ERROR;
+				break;
 
-			if (computeShaderSource)
-				delete computeShaderSource;
+			case ShaderError::GLSL_SHADER_COMPILE_ERROR:
+				*error_result = ShaderError::GLSL_COMPUTE_SHADER_COMPILE_ERROR;
+				break;
 
-			if (error_result)
+			default:
 				*error_result = err;
-
-			return 0;
+			}
 		}
-	}
-
 
+		return 0;
+	}
 
-	// source code objects not longer needed
-	if (computeShaderSource)
-		delete computeShaderSource;
 
-	//
-	// Once the compute shader object has been validated, setup the main
-	// shader program object
-	//
-	glslProgram = glCreateProgram();
+	// Once the compute shader object has been validated, setup the main shader program object
+	GLuint program = glCreateProgram();
 
-	if (!glslProgram) {
+	if (program == 0) {
 
-		printf("The shader program object could not be created.\n");
+		cout << "The shader program object could not be created." << endl;
 
 		glDeleteShader(computeShader);
 
 		if (error_result)
-			*error_result = GLSL_PROGRAM_OBJECT_CREATION_ERROR;
+			*error_result = ShaderError::GLSL_PROGRAM_OBJECT_CREATION_ERROR;
 
 		return 0;
 	}
 
+	glAttachShader(program, computeShader);
 
-	// Attach shader objects
-	glAttachShader(glslProgram, computeShader);
 
-	// link the shader program
-	glLinkProgram(glslProgram);
+	// Link and validate the shader program
+	glLinkProgram(program);
 
+	// The shader object is no longer needed once it is part of the linked program
+	glDeleteShader(computeShader);
 
-	// validate link status
 	GLint linkStatus;
-
-	glGetProgramiv(glslProgram, GL_LINK_STATUS, &linkStatus);
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
 
 	if (linkStatus == 0) {
 
-		// failed to link - report linker error log and dispose of local resources
-
-		printf("The shader program object could not be linked successfully...\n");
-
-		// report linker error log
+		// Failed to link - report linker error log and dispose of local resources
 
-		printf("\n<GLSL shader program object linker errors--------------------->\n\n");
-		reportProgramInfoLog(glslProgram);
-		printf("<-----------------end shader program object linker errors>\n\n");
+		cout << "The shader program object could not be linked successfully..." << endl;
 
-		// delete program and detach shaders
-		glDeleteProgram(glslProgram);
+		cout << "\n<GLSL shader program object linker errors--------------------->\n\n";
+		reportProgramInfoLog(program);
+		cout << "<-----------------end shader program object linker errors>\n\n";
 
-		// delete shaders
-		glDeleteShader(computeShader);
+		glDeleteProgram(program);
 
 		if (error_result)
-			*error_result = GLSL_PROGRAM_OBJECT_LINK_ERROR;
+			*error_result = ShaderError::GLSL_PROGRAM_OBJECT_LINK_ERROR;
 
 		return 0;
 	}
 
-	// cleanup - delete individual shader objects since they're now included as part of the overall shader program object
-	glDeleteShader(computeShader);
+	// Shader program object setup successfully
 
 	if (error_result)
-		*error_result = GLSL_OK;
+		*error_result = ShaderError::GLSL_OK;
 
-	return glslProgram;
+	return program;
 }
-#endif
 
 
 //
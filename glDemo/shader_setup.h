@@ -58,3 +58,7 @@ public:
 GLuint setupShaders(const std::string& vsPath,
 	const std::string& fsPath,
 	ShaderError* error_result = NULL);
+
+// Create a program from a single compute shader.  Compute shaders need GL 4.3 / ARB_compute_shader
+GLuint setupComputeShader(const std::string& csPath,
+	ShaderError* error_result = NULL);